@@ -0,0 +1,61 @@
+//
+// Compares the block scan of TcpClient::explode() with the character by character tokenizer it falls back to,
+// on the lines of a LIST VAR reply and on a line with escapes.
+// Usage: bench_explode [iterations]
+//
+
+#include "../nutclient.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace nut;
+
+/* Reaches the protected tokenizers. */
+struct Tokenizer : public TcpClient {
+    using TcpClient::explode;
+
+    static std::vector<std::string> reference(const std::string & str, size_t begin) {
+        std::vector<std::string> res;
+        explodeEscaped(str, begin, res);
+        return res;
+    }
+};
+
+template<typename Explode>
+static double run(const std::vector<std::string> & lines, int iterations, Explode explode) {
+    size_t tokens = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; ++n) {
+        tokens += explode(lines[n % lines.size()], 0).size();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (tokens == 0) {
+        std::cout << "no tokens" << std::endl;
+    }
+    return ns / iterations;
+}
+
+static void compare(const char * name, const std::vector<std::string> & lines, int iterations) {
+    double scan = run(lines, iterations, Tokenizer::explode);
+    double reference = run(lines, iterations, Tokenizer::reference);
+    std::cout << name << ": explode " << scan << " ns, character by character " << reference << " ns per line"
+              << std::endl;
+}
+
+int main(int argc, char * argv[]) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 2000000;
+
+    std::vector<std::string> lines;
+    lines.push_back("VAR ups battery.charge \"100\"");
+    lines.push_back("VAR ups device.mfr \"American Power Conversion\"");
+    lines.push_back("VAR ups input.transfer.reason \"input voltage out of range\"");
+    lines.push_back("VAR ups ups.status \"OL CHRG\"");
+    lines.push_back("VAR ups driver.version.data \"APC HID 0.98\"");
+    lines.push_back("VAR ups battery.voltage \"27.3\"");
+    lines.push_back("VAR ups ups.test.result \"No test initiated\"");
+    lines.push_back("VAR ups ups.firmware \"865.L7 .D\"");
+    compare("LIST VAR lines", lines, iterations);
+    compare("escaped line", std::vector<std::string>(1, "VAR ups ups.mfr \"APC \\\"Smart\\\" UPS\""), iterations);
+    return 0;
+}
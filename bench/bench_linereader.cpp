@@ -0,0 +1,108 @@
+//
+// Compares the line reader of DefaultSocket (LineBuffer) with the reader it replaced, which received 256
+// bytes at a time and extracted each line with find(), substr() and erase(). Both are fed a LIST VAR reply
+// from memory, so the figures exclude the system calls; the number of receives each needs is printed too.
+// Usage: bench_linereader [rows] [iterations]
+//
+
+#include "../defaultsocket.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace nut;
+
+/* Stands for a socket holding the whole reply: each receive gets as much of it as asked. */
+struct Source {
+    const std::string & data;
+    size_t pos;
+    size_t receives;
+
+    size_t recv(char * buf, size_t sz) {
+        size_t n = std::min(sz, data.size() - pos);
+        std::memcpy(buf, data.data() + pos, n);
+        pos += n;
+        ++receives;
+        return n;
+    }
+};
+
+/* The previous DefaultSocket::read(). */
+struct PreviousReader {
+    std::string buffer;
+
+    std::string read(Source & source) {
+        std::string res;
+        char buff[256];
+        while (true) {
+            if (!buffer.empty()) {
+                size_t idx = buffer.find('\n');
+                if (idx != std::string::npos) {
+                    res += buffer.substr(0, idx);
+                    buffer.erase(0, idx + 1);
+                    return res;
+                }
+                res += buffer;
+            }
+            size_t sz = source.recv(buff, 256);
+            if (sz == 0) {
+                std::cerr << "truncated reply" << std::endl;
+                std::exit(1);
+            }
+            buffer.assign(buff, sz);
+        }
+    }
+};
+
+/* DefaultSocket::readLine() without the socket. */
+struct LineBufferReader {
+    internal::LineBuffer buffer;
+
+    LineView read(Source & source) {
+        const char * data;
+        size_t sz;
+        while (!buffer.nextLine(data, sz)) {
+            size_t room;
+            char * dst = buffer.prepare(room);
+            size_t n = source.recv(dst, room);
+            if (n == 0) {
+                std::cerr << "truncated reply" << std::endl;
+                std::exit(1);
+            }
+            buffer.commit(n);
+        }
+        return LineView(data, sz);
+    }
+};
+
+template<typename Reader>
+static void run(const char * name, const std::string & reply, int rows, int iterations) {
+    Reader reader;
+    size_t bytes = 0, receives = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; ++n) {
+        Source source = {reply, 0, 0};
+        for (int line = 0; line < rows + 2; ++line) {
+            bytes += reader.read(source).size();
+        }
+        receives = source.receives;
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << us / iterations << " us and " << receives << " receives per reply ("
+              << bytes / iterations << " bytes of lines)" << std::endl;
+}
+
+int main(int argc, char * argv[]) {
+    int rows = argc > 1 ? std::atoi(argv[1]) : 200;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5000;
+
+    std::string reply = "BEGIN LIST VAR ups\n";
+    for (int n = 0; n < rows; ++n) {
+        reply += "VAR ups device.variable" + std::to_string(n) + " \"value of variable " + std::to_string(n) + "\"\n";
+    }
+    reply += "END LIST VAR ups\n";
+    run<PreviousReader>("previous reader", reply, rows, iterations);
+    run<LineBufferReader>("LineBuffer", reply, rows, iterations);
+    return 0;
+}
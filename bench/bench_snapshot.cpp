@@ -0,0 +1,87 @@
+//
+// Compares the results of LIST VAR: the map of getDeviceVariableValues(), the DeviceSnapshot and a reused
+// ListTable. Prints the time and the heap allocations of a query, and the allocations held by its result.
+// Usage: bench_snapshot [variables] [queries]
+//
+
+#include "../nutclient.h"
+#include "../tests/testing.h"
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+using namespace nut;
+
+/* Allocations of the calling thread: the stand-in server allocates on its own threads. */
+static thread_local size_t allocations = 0;
+
+void * operator new(size_t size) {
+    ++allocations;
+    void * ptr = std::malloc(size > 0 ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void * ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+static std::string listReply;
+
+static std::string reply(const std::string & line) {
+    if (line == "LIST VAR ups") {
+        return listReply;
+    }
+    return "ERR UNKNOWN-UPS\n";
+}
+
+/* Runs query() queries times, the result of the last one is copied to count the blocks it holds. */
+template<typename Result, typename Query>
+static void run(const char * name, int queries, Query query) {
+    Result result = query();
+    size_t before = allocations;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int n = 0; n < queries; ++n) {
+        result = query();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t perQuery = (allocations - before) / queries;
+    before = allocations;
+    Result copy(result);
+    (void) copy;
+    size_t held = allocations - before;
+    std::cout << name << ": " << seconds / queries * 1e6 << " us, " << perQuery << " allocations per query, "
+              << held << " held by the result" << std::endl;
+}
+
+int main(int argc, char * argv[]) {
+    int variables = argc > 1 ? std::atoi(argv[1]) : 150;
+    int queries = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    listReply = "BEGIN LIST VAR ups\n";
+    for (int n = 0; n < variables; ++n) {
+        listReply += "VAR ups device.variable" + std::to_string(n) + " \"" + std::to_string(n * 7) + ".5\"\n";
+    }
+    listReply += "END LIST VAR ups\n";
+    test::TestServer server(reply);
+    TcpClient client("127.0.0.1", server.port());
+
+    run<std::map<std::string, std::vector<std::string> > >("map", queries, [&client]() {
+        return client.getDeviceVariableValues("ups");
+    });
+    run<DeviceSnapshot>("DeviceSnapshot", queries, [&client]() {
+        return client.getDeviceVariableSnapshot("ups");
+    });
+    ListTable table;
+    run<int>("ListTable (reused)", queries, [&client, &table]() {
+        client.getDeviceVariableTable("ups", table);
+        return 0;
+    });
+    return 0;
+}
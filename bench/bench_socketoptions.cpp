@@ -0,0 +1,76 @@
+//
+// Measures the effect of each SocketOptions setting on the round trips to a local stand-in server: serial
+// GET queries on one connection, then the same queries from several threads sharing a multiplexed
+// connection, where writes overlap.
+// Usage: bench_socketoptions [queries] [threads]
+//
+
+#include "../nutclient.h"
+#include "../tests/testing.h"
+#include <chrono>
+#include <cstdlib>
+
+using namespace nut;
+
+static std::string reply(const std::string &) {
+    return "VAR ups battery.charge \"100\"\n";
+}
+
+static double serial(const test::TestServer & server, const SocketOptions & options, int queries) {
+    TcpClient client("127.0.0.1", server.port(), options);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int n = 0; n < queries; ++n) {
+        client.getDeviceVariableValue("ups", "battery.charge");
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / queries;
+}
+
+static double multiplexed(const test::TestServer & server, const SocketOptions & options, int queries, int threads) {
+    TcpClient client("127.0.0.1", server.port(), options);
+    client.setMultiplexed(true);
+    std::vector<std::thread> workers;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&client, queries, threads]() {
+            for (int n = 0; n < queries / threads; ++n) {
+                client.getDeviceVariableValue("ups", "battery.charge");
+            }
+        });
+    }
+    for (std::thread & worker : workers) {
+        worker.join();
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / queries;
+}
+
+int main(int argc, char * argv[]) {
+    int queries = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 4;
+    test::TestServer server(reply);
+
+    std::vector<std::pair<const char *, SocketOptions> > profiles;
+    SocketOptions options;
+    profiles.push_back(std::make_pair("defaults (Nagle)", options));
+    options.noDelay = true;
+    profiles.push_back(std::make_pair("TCP_NODELAY", options));
+    options = SocketOptions();
+    options.receiveBufferSize = options.sendBufferSize = 4096;
+    profiles.push_back(std::make_pair("4 KiB buffers", options));
+    options = SocketOptions();
+    options.keepAlive = true;
+    options.keepAliveIdle = 10;
+    options.keepAliveInterval = 5;
+    options.keepAliveCount = 3;
+    profiles.push_back(std::make_pair("keepalive", options));
+    options = SocketOptions();
+    options.userTimeout = 5000;
+    profiles.push_back(std::make_pair("TCP_USER_TIMEOUT", options));
+
+    for (size_t n = 0; n < profiles.size(); ++n) {
+        double one = serial(server, profiles[n].second, queries);
+        double shared = multiplexed(server, profiles[n].second, queries, threads);
+        std::cout << profiles[n].first << ": " << one << " us per round trip, " << shared << " us per query from "
+                  << threads << " threads" << std::endl;
+    }
+    return 0;
+}
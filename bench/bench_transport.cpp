@@ -0,0 +1,68 @@
+//
+// Compares the io_uring transport with the default sockets: many clients, each on its own thread,
+// polling a local stand-in server with GET and LIST queries.
+// Usage: bench_transport [clients] [queries per client]
+//
+
+#include "../uringsocket.h"
+#include "../tests/testing.h"
+#include <chrono>
+#include <cstdlib>
+
+using namespace nut;
+
+static std::string listReply;
+
+static std::string reply(const std::string & line) {
+    if (line == "LIST VAR ups") {
+        return listReply;
+    }
+    return "VAR ups battery.charge \"100\"\n";
+}
+
+static double run(const char * name, const test::TestServer & server, int clients, int queries) {
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&server, queries]() {
+            TcpClient client("127.0.0.1", server.port());
+            for (int n = 0; n < queries; ++n) {
+                if (n % 10 == 0) {
+                    client.getDeviceVariableValues("ups");
+                } else {
+                    client.getDeviceVariableValue("ups", "battery.charge");
+                }
+            }
+        });
+    }
+    for (std::thread & t : threads) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rate = clients * queries / seconds;
+    std::cout << name << ": " << clients * queries << " queries in " << seconds << " s, " << rate << " queries/s" << std::endl;
+    return rate;
+}
+
+int main(int argc, char * argv[]) {
+    int clients = argc > 1 ? std::atoi(argv[1]) : 16;
+    int queries = argc > 2 ? std::atoi(argv[2]) : 5000;
+
+    listReply = "BEGIN LIST VAR ups\n";
+    for (int n = 0; n < 100; ++n) {
+        listReply += "VAR ups var" + std::to_string(n) + " \"" + std::to_string(n * 7) + "\"\n";
+    }
+    listReply += "END LIST VAR ups\n";
+    test::TestServer server(reply);
+
+    registerSocketFactory(internal::defaultFactory);
+    double base = run("default", server, clients, queries);
+    if (!uringAvailable()) {
+        std::cout << "io_uring: not available on this kernel" << std::endl;
+        return 0;
+    }
+    registerSocketFactory(uringSocketFactory);
+    double uring = run("io_uring", server, clients, queries);
+    std::cout << "io_uring / default: " << uring / base << std::endl;
+    return 0;
+}
@@ -0,0 +1,56 @@
+//
+// Compares TCP loopback with a unix domain socket (unix:/path host) to the same stand-in server: the latency
+// of GET round trips and the throughput of LIST VAR replies.
+// Usage: bench_unixsocket [queries] [variables]
+//
+
+#include "../nutclient.h"
+#include "../tests/testing.h"
+#include <chrono>
+#include <cstdlib>
+
+using namespace nut;
+
+static std::string listReply;
+
+static std::string reply(const std::string & line) {
+    if (line == "LIST VAR ups") {
+        return listReply;
+    }
+    return "VAR ups battery.charge \"100\"\n";
+}
+
+static void run(const char * name, const std::string & host, int port, int queries) {
+    TcpClient client(host, port);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int n = 0; n < queries; ++n) {
+        client.getDeviceVariableValue("ups", "battery.charge");
+    }
+    double latency = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    ListTable table;
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < queries; ++n) {
+        client.getDeviceVariableTable("ups", table);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << latency / queries << " us per GET, " << queries / seconds << " LIST VAR/s ("
+              << listReply.size() * queries / seconds / (1 << 20) << " MiB/s)" << std::endl;
+}
+
+int main(int argc, char * argv[]) {
+    int queries = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int variables = argc > 2 ? std::atoi(argv[2]) : 150;
+
+    listReply = "BEGIN LIST VAR ups\n";
+    for (int n = 0; n < variables; ++n) {
+        listReply += "VAR ups device.variable" + std::to_string(n) + " \"" + std::to_string(n * 7) + "\"\n";
+    }
+    listReply += "END LIST VAR ups\n";
+    const std::string path = "/tmp/bench_unixsocket." + std::to_string(::getpid());
+    test::TestServer tcp(reply);
+    test::TestServer local(reply, path);
+
+    run("TCP loopback", "127.0.0.1", tcp.port(), queries);
+    run("unix domain socket", "unix:" + path, 0, queries);
+    return 0;
+}
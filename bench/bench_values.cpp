@@ -0,0 +1,100 @@
+//
+// Compares the numeric parsing of a realistic UPS variable set: std::stod() and strtod() as callers did it,
+// ValueParser::parseDouble() on each value, and DeviceSnapshot::numericValues() for all of them at once.
+// Usage: bench_values [iterations]
+//
+
+#include "../nutclient.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace nut;
+
+static const char * const VARIABLES[][2] = {
+    {"ambient.humidity", "41.2"}, {"ambient.temperature", "24.8"}, {"battery.charge", "100"},
+    {"battery.charge.low", "10"}, {"battery.charge.warning", "50"}, {"battery.mfr.date", "2019/03/12"},
+    {"battery.runtime", "2370"}, {"battery.runtime.low", "120"}, {"battery.type", "PbAc"},
+    {"battery.voltage", "27.3"}, {"battery.voltage.nominal", "24.0"}, {"device.mfr", "American Power Conversion"},
+    {"device.model", "Back-UPS RS 1500G"}, {"device.serial", "4B1920P12345"}, {"device.type", "ups"},
+    {"driver.name", "usbhid-ups"}, {"driver.parameter.pollfreq", "30"}, {"driver.parameter.pollinterval", "2"},
+    {"driver.parameter.port", "auto"}, {"driver.version", "2.8.0"}, {"driver.version.data", "APC HID 0.98"},
+    {"input.frequency", "59.9"}, {"input.sensitivity", "medium"}, {"input.transfer.high", "144"},
+    {"input.transfer.low", "88"}, {"input.transfer.reason", "input voltage out of range"},
+    {"input.voltage", "121.0"}, {"input.voltage.nominal", "120"}, {"output.frequency", "59.9"},
+    {"output.voltage", "120.0"}, {"ups.beeper.status", "enabled"}, {"ups.delay.shutdown", "20"},
+    {"ups.firmware", "865.L7 .D"}, {"ups.load", "23"}, {"ups.mfr", "American Power Conversion"},
+    {"ups.model", "Back-UPS RS 1500G"}, {"ups.productid", "0002"}, {"ups.realpower.nominal", "865"},
+    {"ups.serial", "4B1920P12345"}, {"ups.status", "OL CHRG"}, {"ups.temperature", "31.5"},
+    {"ups.test.result", "No test initiated"}, {"ups.timer.reboot", "0"}, {"ups.timer.shutdown", "-1"},
+    {"ups.vendorid", "051d"},
+};
+
+template<typename Parse>
+static void run(const char * name, int iterations, Parse parse) {
+    double sum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; ++n) {
+        sum += parse();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << ns / iterations << " ns per device (sum " << sum / iterations << ")" << std::endl;
+}
+
+int main(int argc, char * argv[]) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    std::map<std::string, std::vector<std::string> > variables;
+    for (const auto & var : VARIABLES) {
+        variables[var[0]].push_back(var[1]);
+    }
+    DeviceSnapshot snapshot(variables);
+    std::cout << variables.size() << " variables" << std::endl;
+
+    run("std::stod", iterations, [&variables]() {
+        double sum = 0;
+        for (const auto & var : variables) {
+            try {
+                size_t end;
+                double value = std::stod(var.second[0], &end);
+                if (end == var.second[0].size()) {
+                    sum += value;
+                }
+            } catch (const std::exception &) {
+            }
+        }
+        return sum;
+    });
+    run("strtod", iterations, [&variables]() {
+        double sum = 0;
+        for (const auto & var : variables) {
+            char * end;
+            double value = std::strtod(var.second[0].c_str(), &end);
+            if (*end == '\0') {
+                sum += value;
+            }
+        }
+        return sum;
+    });
+    run("ValueParser::parseDouble", iterations, [&variables]() {
+        double sum = 0;
+        for (const auto & var : variables) {
+            double value;
+            if (ValueParser::parseDouble(var.second[0], value)) {
+                sum += value;
+            }
+        }
+        return sum;
+    });
+    run("DeviceSnapshot::numericValues", iterations, [&snapshot]() {
+        double sum = 0;
+        std::vector<double> values = snapshot.numericValues();
+        for (double value : values) {
+            if (value == value) {
+                sum += value;
+            }
+        }
+        return sum;
+    });
+    return 0;
+}
@@ -0,0 +1,262 @@
+//
+// Pool of connected and authenticated TcpClient sessions shared by many threads.
+//
+
+#include "connectionpool.h"
+#include <sstream>
+
+namespace nut {
+
+    /*
+     *
+     * ConnectionPool::Session implementation
+     *
+     */
+
+    ConnectionPool::Session::Session() :
+            _pool(nullptr) {
+    }
+
+    ConnectionPool::Session::Session(ConnectionPool * pool, const std::string & key,
+                                     std::unique_ptr<TcpClient> && client) :
+            _pool(pool),
+            _key(key),
+            _client(std::move(client)) {
+    }
+
+    ConnectionPool::Session::Session(Session && other) :
+            _pool(other._pool),
+            _key(std::move(other._key)),
+            _client(std::move(other._client)) {
+        other._pool = nullptr;
+    }
+
+    ConnectionPool::Session & ConnectionPool::Session::operator=(Session && other) {
+        if (this != &other) {
+            release();
+            _pool = other._pool;
+            _key = std::move(other._key);
+            _client = std::move(other._client);
+            other._pool = nullptr;
+        }
+        return *this;
+    }
+
+    ConnectionPool::Session::~Session() {
+        release();
+    }
+
+    void ConnectionPool::Session::release() {
+        if (_pool != nullptr && _client) {
+            _pool->giveBack(_key, std::move(_client));
+        }
+        _pool = nullptr;
+        _client.reset();
+    }
+
+    void ConnectionPool::Session::discard() {
+        if (_client) {
+            _client->disconnect();
+        }
+        release();
+    }
+
+    /*
+     *
+     * ConnectionPool implementation
+     *
+     */
+
+    ConnectionPool::ConnectionPool(const ConnectionPoolOptions & options) :
+            _options(options) {
+        if (_options.maxSize == 0) {
+            _options.maxSize = 1;
+        }
+        if (_options.minSize > _options.maxSize) {
+            _options.minSize = _options.maxSize;
+        }
+    }
+
+    ConnectionPool::~ConnectionPool() {
+        clear();
+    }
+
+    std::string ConnectionPool::key(const std::string & host, int port) {
+        std::ostringstream key;
+        key << host << ':' << port;
+        return key.str();
+    }
+
+    ConnectionPool::Session ConnectionPool::checkout(const std::string & host, int port) {
+        std::string k = key(host, port);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(_options.checkoutTimeout);
+        std::vector<std::unique_ptr<TcpClient> > closed;
+        std::unique_lock<std::mutex> lock(_mutex);
+        Pool & pool = _pools[k];
+        evictLocked(pool, closed);
+
+        while (true) {
+            if (!pool.idle.empty()) {
+                // Most recently used first: it is the likeliest to be alive, and the others can expire.
+                Idle idle = std::move(pool.idle.back());
+                pool.idle.pop_back();
+                lock.unlock();
+                closed.clear();
+
+                bool check = _options.healthCheckInterval >= 0 &&
+                        std::chrono::steady_clock::now() - idle.since >= std::chrono::seconds(_options.healthCheckInterval);
+                if (idle.client->isConnected() && (!check || healthy(*idle.client))) {
+                    return Session(this, k, std::move(idle.client));
+                }
+                idle.client.reset();
+                lock.lock();
+                --pool.total;
+                continue;
+            }
+
+            if (pool.total < _options.maxSize) {
+                ++pool.total;
+                lock.unlock();
+                closed.clear();
+                try {
+                    return Session(this, k, open(host, port));
+                }
+                catch (...) {
+                    lock.lock();
+                    --pool.total;
+                    _available.notify_all();
+                    throw;
+                }
+            }
+
+            if (_options.checkoutTimeout < 0) {
+                _available.wait(lock);
+            } else if (_available.wait_until(lock, deadline) == std::cv_status::timeout &&
+                       pool.idle.empty() && pool.total >= _options.maxSize) {
+                throw nut::TimeoutException();
+            }
+        }
+    }
+
+    void ConnectionPool::prewarm(const std::string & host, int port) {
+        std::string k = key(host, port);
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                Pool & pool = _pools[k];
+                if (pool.total >= _options.minSize) {
+                    return;
+                }
+                ++pool.total;
+            }
+            std::unique_ptr<TcpClient> client;
+            try {
+                client = open(host, port);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                --_pools[k].total;
+                _available.notify_all();
+                throw;
+            }
+            giveBack(k, std::move(client));
+        }
+    }
+
+    void ConnectionPool::evictIdle() {
+        // Declared first, so the connections are closed once the lock is released.
+        std::vector<std::unique_ptr<TcpClient> > closed;
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto & entry : _pools) {
+            evictLocked(entry.second, closed);
+        }
+    }
+
+    void ConnectionPool::clear() {
+        std::vector<std::unique_ptr<TcpClient> > closed;
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto & entry : _pools) {
+            Pool & pool = entry.second;
+            pool.total -= pool.idle.size();
+            for (auto & idle : pool.idle) {
+                closed.push_back(std::move(idle.client));
+            }
+            pool.idle.clear();
+        }
+    }
+
+    size_t ConnectionPool::size(const std::string & host, int port) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _pools.find(key(host, port));
+        return it != _pools.end() ? it->second.total : 0;
+    }
+
+    size_t ConnectionPool::idle(const std::string & host, int port) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _pools.find(key(host, port));
+        return it != _pools.end() ? it->second.idle.size() : 0;
+    }
+
+    /*
+     * Opens a session: connects, then authenticates and logs in to the devices once for all its users.
+     */
+    std::unique_ptr<TcpClient> ConnectionPool::open(const std::string & host, int port) const {
+        std::unique_ptr<TcpClient> client(new TcpClient());
+        client->setTimeout(_options.timeout);
+        client->setSocketOptions(_options.socketOptions);
+        client->connect(host, port);
+        if (!_options.user.empty()) {
+            client->authenticate(_options.user, _options.password);
+            for (const std::string & dev : _options.devices) {
+                client->deviceLogin(dev);
+            }
+        }
+        return client;
+    }
+
+    /*
+     * Checks that the server still answers on the connection.
+     */
+    bool ConnectionPool::healthy(TcpClient & client) {
+        try {
+            client.sendQuery("VER");
+            return client.isConnected();
+        }
+        catch (NutException &) {
+            return false;
+        }
+    }
+
+    void ConnectionPool::giveBack(const std::string & key, std::unique_ptr<TcpClient> && client) {
+        std::unique_ptr<TcpClient> closed;
+        std::lock_guard<std::mutex> lock(_mutex);
+        Pool & pool = _pools[key];
+        if (client->isConnected()) {
+            Idle idle;
+            idle.client = std::move(client);
+            idle.since = std::chrono::steady_clock::now();
+            pool.idle.push_back(std::move(idle));
+        } else {
+            // Broken by an I/O error or a timeout, or discarded.
+            closed = std::move(client);
+            --pool.total;
+        }
+        _available.notify_all();
+    }
+
+    /*
+     * Moves the expired idle connections of the pool to closed. The caller holds _mutex.
+     */
+    void ConnectionPool::evictLocked(Pool & pool, std::vector<std::unique_ptr<TcpClient> > & closed) {
+        if (_options.idleTimeout < 0) {
+            return;
+        }
+        auto limit = std::chrono::steady_clock::now() - std::chrono::seconds(_options.idleTimeout);
+        while (!pool.idle.empty() && pool.total > _options.minSize && pool.idle.front().since <= limit) {
+            closed.push_back(std::move(pool.idle.front().client));
+            pool.idle.pop_front();
+            --pool.total;
+        }
+    }
+
+}
@@ -0,0 +1,148 @@
+//
+// Pool of connected and authenticated TcpClient sessions shared by many threads.
+//
+
+#ifndef NUTCLIENT_CONNECTIONPOOL_H
+#define NUTCLIENT_CONNECTIONPOOL_H
+#include "nutclient.h"
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <unordered_map>
+
+namespace nut {
+
+    class LIB_API ConnectionPool;
+
+    /*
+     * Settings of a ConnectionPool, shared by all the servers it connects to.
+     */
+    struct ConnectionPoolOptions {
+        ConnectionPoolOptions() : minSize(0), maxSize(8), idleTimeout(60), healthCheckInterval(5),
+                checkoutTimeout(-1), timeout(-1) {}
+
+        /* Credentials sent once when a connection is opened, no authentication if user is empty */
+        std::string user;
+        std::string password;
+        /* Devices the sessions LOGIN to once authenticated */
+        std::vector<std::string> devices;
+        /* Connections kept per host:port by prewarm() and evictIdle(), and most connections opened at once */
+        size_t minSize;
+        size_t maxSize;
+        /* Seconds an idle connection beyond minSize is kept, negative to keep it forever */
+        long idleTimeout;
+        /* Seconds of idleness after which a connection is checked (VER query) before being handed out,
+         * negative to never check */
+        long healthCheckInterval;
+        /* Seconds checkout() waits for a connection once maxSize is reached, negative to wait forever */
+        long checkoutTimeout;
+        /* Timeout of the sessions, see TcpClient::setTimeout() */
+        long timeout;
+        SocketOptions socketOptions;
+    };
+
+    /*
+     * ConnectionPool hands out TcpClient sessions that are already connected, authenticated and logged in to the
+     * configured devices, so that a checkout never costs a handshake. Sessions are kept per host:port.
+     * A session is used by one thread at a time and goes back to the pool when its Session handle is destroyed.
+     * A session whose connection failed is closed instead, and replaced at the next checkout.
+     * There is no background thread: idle connections are evicted by checkout() and evictIdle().
+     * All the methods are thread safe. The pool must outlive the sessions it handed out.
+     */
+    class ConnectionPool {
+    public:
+        /*
+         * Lease of a pooled TcpClient, returns it to the pool when destroyed. Movable, not copyable.
+         */
+        class Session {
+            friend class ConnectionPool;
+
+        public:
+            Session();
+            Session(Session && other);
+            Session & operator=(Session && other);
+            ~Session();
+
+            TcpClient * operator->() const { return _client.get(); }
+            TcpClient & operator*() const { return *_client; }
+            TcpClient * get() const { return _client.get(); }
+            explicit operator bool() const { return _client != nullptr; }
+
+            /*
+             * Returns the session to the pool now.
+             */
+            void release();
+            /*
+             * Closes the session instead of returning it, for instance after a LOGOUT or any change of the
+             * session state that the next user would not expect.
+             */
+            void discard();
+
+        private:
+            Session(ConnectionPool * pool, const std::string & key, std::unique_ptr<TcpClient> && client);
+            Session(const Session &) = delete;
+            Session & operator=(const Session &) = delete;
+
+            ConnectionPool * _pool;
+            std::string _key;
+            std::unique_ptr<TcpClient> _client;
+        };
+
+        explicit ConnectionPool(const ConnectionPoolOptions & options);
+
+        ~ConnectionPool();
+
+        /*
+         * Hands out a session to host:port: an idle one if any (checked first if it has been idle long),
+         * otherwise a new one if maxSize is not reached, otherwise the first one returned.
+         *     Throws TimeoutException if none is available within checkoutTimeout, and the TcpClient
+         *     exceptions if a new connection cannot be opened or authenticated.
+         */
+        Session checkout(const std::string & host, int port = 3493);
+        /*
+         * Opens connections to host:port until minSize of them exist.
+         */
+        void prewarm(const std::string & host, int port = 3493);
+        /*
+         * Closes the connections idle for more than idleTimeout, keeping minSize connections per host:port.
+         */
+        void evictIdle();
+        /*
+         * Closes all the idle connections.
+         */
+        void clear();
+        /*
+         * Returns the number of connections to host:port, in use or idle, and the number of idle ones.
+         */
+        size_t size(const std::string & host, int port = 3493) const;
+        size_t idle(const std::string & host, int port = 3493) const;
+
+    private:
+        struct Idle {
+            std::unique_ptr<TcpClient> client;
+            std::chrono::steady_clock::time_point since;
+        };
+
+        struct Pool {
+            Pool() : total(0) {}
+
+            std::deque<Idle> idle;   /* least recently used first */
+            size_t total;            /* connections in use, idle or being opened */
+        };
+
+        static std::string key(const std::string & host, int port);
+        std::unique_ptr<TcpClient> open(const std::string & host, int port) const;
+        static bool healthy(TcpClient & client);
+        void giveBack(const std::string & key, std::unique_ptr<TcpClient> && client);
+        void evictLocked(Pool & pool, std::vector<std::unique_ptr<TcpClient> > & closed);
+
+        ConnectionPoolOptions _options;
+        mutable std::mutex _mutex;
+        std::condition_variable _available;
+        std::unordered_map<std::string, Pool> _pools;
+    };
+
+}
+
+#endif //NUTCLIENT_CONNECTIONPOOL_H
@@ -0,0 +1,195 @@
+//
+// C++20 coroutine interface on top of the event driven transport.
+//
+
+#include "coroutine.h"
+
+namespace nut {
+
+    namespace internal {
+
+        /*
+         * Returns an AsyncClient handler completing the awaited query.
+         */
+        template<typename T>
+        static auto resultHandler(const std::shared_ptr<AwaitState<T> > & state) {
+            return [state](const T & value, std::exception_ptr error) {
+                if (error) {
+                    state->outcome.error = error;
+                }
+                else {
+                    state->outcome.set(value);
+                }
+                state->complete();
+            };
+        }
+
+        static AsyncClient::DoneHandler doneHandler(const std::shared_ptr<AwaitState<void> > & state) {
+            return [state](std::exception_ptr error) {
+                state->outcome.error = error;
+                state->complete();
+            };
+        }
+
+    }
+
+    using internal::AwaitState;
+    using internal::resultHandler;
+    using internal::doneHandler;
+
+    typedef std::set<std::string> Names;
+    typedef std::vector<std::string> Values;
+    typedef std::vector<std::vector<std::string> > Rows;
+
+    CoClient::CoClient(Reactor & reactor) :
+            _client(reactor) {
+    }
+
+    Awaitable<void> CoClient::connect(const std::string & host, int port) {
+        return Awaitable<void>([this, host, port](const std::shared_ptr<AwaitState<void> > & state) {
+            _client.connect(host, port, doneHandler(state));
+        });
+    }
+
+    void CoClient::disconnect() {
+        _client.disconnect();
+    }
+
+    bool CoClient::isConnected() const {
+        return _client.isConnected();
+    }
+
+    void CoClient::setTimeout(long timeout) {
+        _client.setTimeout(timeout);
+    }
+
+    Awaitable<void> CoClient::authenticate(const std::string & user, const std::string & passwd) {
+        return Awaitable<void>([this, user, passwd](const std::shared_ptr<AwaitState<void> > & state) {
+            _client.authenticate(user, passwd, doneHandler(state));
+        });
+    }
+
+    Awaitable<void> CoClient::logout() {
+        return Awaitable<void>([this](const std::shared_ptr<AwaitState<void> > & state) {
+            _client.logout(doneHandler(state));
+        });
+    }
+
+    Awaitable<Names> CoClient::getDeviceNames() {
+        return Awaitable<Names>([this](const std::shared_ptr<AwaitState<Names> > & state) {
+            _client.getDeviceNames(resultHandler(state));
+        });
+    }
+
+    Awaitable<std::string> CoClient::getDeviceDescription(const std::string & name) {
+        return Awaitable<std::string>([this, name](const std::shared_ptr<AwaitState<std::string> > & state) {
+            _client.getDeviceDescription(name, resultHandler(state));
+        });
+    }
+
+    Awaitable<Names> CoClient::getDeviceVariableNames(const std::string & dev) {
+        return Awaitable<Names>([this, dev](const std::shared_ptr<AwaitState<Names> > & state) {
+            _client.getDeviceVariableNames(dev, resultHandler(state));
+        });
+    }
+
+    Awaitable<Names> CoClient::getDeviceRWVariableNames(const std::string & dev) {
+        return Awaitable<Names>([this, dev](const std::shared_ptr<AwaitState<Names> > & state) {
+            _client.getDeviceRWVariableNames(dev, resultHandler(state));
+        });
+    }
+
+    Awaitable<std::string> CoClient::getDeviceVariableDescription(const std::string & dev, const std::string & name) {
+        return Awaitable<std::string>([this, dev, name](const std::shared_ptr<AwaitState<std::string> > & state) {
+            _client.getDeviceVariableDescription(dev, name, resultHandler(state));
+        });
+    }
+
+    Awaitable<Values> CoClient::getDeviceVariableValue(const std::string & dev, const std::string & name) {
+        return Awaitable<Values>([this, dev, name](const std::shared_ptr<AwaitState<Values> > & state) {
+            _client.getDeviceVariableValue(dev, name, resultHandler(state));
+        });
+    }
+
+    Awaitable<std::map<std::string, Values> > CoClient::getDeviceVariableValues(const std::string & dev) {
+        typedef std::map<std::string, Values> Variables;
+        return Awaitable<Variables>([this, dev](const std::shared_ptr<AwaitState<Variables> > & state) {
+            _client.getDeviceVariableValues(dev, resultHandler(state));
+        });
+    }
+
+    Awaitable<TrackingID> CoClient::setDeviceVariable(const std::string & dev, const std::string & name, const std::string & value) {
+        return Awaitable<TrackingID>([this, dev, name, value](const std::shared_ptr<AwaitState<TrackingID> > & state) {
+            _client.setDeviceVariable(dev, name, value, resultHandler(state));
+        });
+    }
+
+    Awaitable<TrackingID> CoClient::setDeviceVariable(const std::string & dev, const std::string & name, const std::vector<std::string> & values) {
+        return Awaitable<TrackingID>([this, dev, name, values](const std::shared_ptr<AwaitState<TrackingID> > & state) {
+            _client.setDeviceVariable(dev, name, values, resultHandler(state));
+        });
+    }
+
+    Awaitable<Names> CoClient::getDeviceCommandNames(const std::string & dev) {
+        return Awaitable<Names>([this, dev](const std::shared_ptr<AwaitState<Names> > & state) {
+            _client.getDeviceCommandNames(dev, resultHandler(state));
+        });
+    }
+
+    Awaitable<std::string> CoClient::getDeviceCommandDescription(const std::string & dev, const std::string & name) {
+        return Awaitable<std::string>([this, dev, name](const std::shared_ptr<AwaitState<std::string> > & state) {
+            _client.getDeviceCommandDescription(dev, name, resultHandler(state));
+        });
+    }
+
+    Awaitable<TrackingID> CoClient::executeDeviceCommand(const std::string & dev, const std::string & name, const std::string & param) {
+        return Awaitable<TrackingID>([this, dev, name, param](const std::shared_ptr<AwaitState<TrackingID> > & state) {
+            _client.executeDeviceCommand(dev, name, param, resultHandler(state));
+        });
+    }
+
+    Awaitable<void> CoClient::deviceLogin(const std::string & dev) {
+        return Awaitable<void>([this, dev](const std::shared_ptr<AwaitState<void> > & state) {
+            _client.deviceLogin(dev, doneHandler(state));
+        });
+    }
+
+    Awaitable<void> CoClient::deviceMaster(const std::string & dev) {
+        return Awaitable<void>([this, dev](const std::shared_ptr<AwaitState<void> > & state) {
+            _client.deviceMaster(dev, doneHandler(state));
+        });
+    }
+
+    Awaitable<void> CoClient::deviceForcedShutdown(const std::string & dev) {
+        return Awaitable<void>([this, dev](const std::shared_ptr<AwaitState<void> > & state) {
+            _client.deviceForcedShutdown(dev, doneHandler(state));
+        });
+    }
+
+    Awaitable<int> CoClient::deviceGetNumLogins(const std::string & dev) {
+        return Awaitable<int>([this, dev](const std::shared_ptr<AwaitState<int> > & state) {
+            _client.deviceGetNumLogins(dev, resultHandler(state));
+        });
+    }
+
+    Awaitable<Values> CoClient::get(const std::string & subcmd, const std::string & params) {
+        return Awaitable<Values>([this, subcmd, params](const std::shared_ptr<AwaitState<Values> > & state) {
+            _client.get(subcmd, params, resultHandler(state));
+        });
+    }
+
+    Awaitable<Rows> CoClient::list(const std::string & subcmd, const std::string & params) {
+        return Awaitable<Rows>([this, subcmd, params](const std::shared_ptr<AwaitState<Rows> > & state) {
+            _client.list(subcmd, params, resultHandler(state));
+        });
+    }
+
+    Awaitable<Rows> CoClient::listVar(const std::string & dev) {
+        return list("VAR", dev);
+    }
+
+    AsyncClient & CoClient::asyncClient() {
+        return _client;
+    }
+
+}
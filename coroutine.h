@@ -0,0 +1,300 @@
+//
+// C++20 coroutine interface on top of the event driven transport (see reactor.h).
+// Built with NUTCLIENT_BUILD_WITH_COROUTINES, needs a C++20 compiler.
+//
+
+#ifndef NUTCLIENT_COROUTINE_H
+#define NUTCLIENT_COROUTINE_H
+#include "reactor.h"
+#include <coroutine>
+#include <optional>
+#include <utility>
+
+namespace nut {
+
+    template<typename T> class Task;
+    template<typename T> class Awaitable;
+    class LIB_API CoClient;
+    template<typename T> T run(Reactor & reactor, Task<T> task);
+
+    namespace internal {
+
+        /*
+         * Result slot of a coroutine or of an awaited query: a value or an exception.
+         */
+        template<typename T>
+        struct Outcome {
+            std::optional<T> value;
+            std::exception_ptr error;
+
+            void set(T v) { value.emplace(std::move(v)); }
+            T get() {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct Outcome<void> {
+            std::exception_ptr error;
+
+            void get() {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        };
+
+        template<typename T>
+        struct TaskPromiseBase {
+            Outcome<T> outcome;
+            std::coroutine_handle<> continuation;
+
+            struct FinalAwaiter {
+                bool await_ready() noexcept { return false; }
+                template<typename P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+                    std::coroutine_handle<> next = h.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() { outcome.error = std::current_exception(); }
+        };
+
+        template<typename T>
+        struct TaskPromise : TaskPromiseBase<T> {
+            Task<T> get_return_object();
+            template<typename U>
+            void return_value(U && v) { this->outcome.set(std::forward<U>(v)); }
+        };
+
+        template<>
+        struct TaskPromise<void> : TaskPromiseBase<void> {
+            Task<void> get_return_object();
+            void return_void() {}
+        };
+
+        /*
+         * Coroutine started by spawn(), it destroys itself once done.
+         */
+        struct Detached {
+            struct promise_type {
+                Detached get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+
+        /*
+         * Shared by an Awaitable and the handler of its query, which may outlive the awaiting coroutine:
+         * the Awaitable clears the waiter when the coroutine frame holding it is destroyed.
+         */
+        template<typename T>
+        struct AwaitState {
+            Outcome<T> outcome;
+            bool completed = false;
+            std::coroutine_handle<> waiter;
+
+            void complete() {
+                completed = true;
+                if (waiter) {
+                    std::exchange(waiter, nullptr).resume();
+                }
+            }
+        };
+
+    }
+
+    /*
+     * Task is a lazily started coroutine returning T.
+     * It starts when awaited, and resumes its awaiter once done; use spawn() or run() to start a top level one.
+     * Destroying a suspended task destroys its frame, and the frames of the tasks it awaits: the queries they
+     * wait for complete without resuming anything.
+     */
+    template<typename T = void>
+    class Task {
+        template<typename U> friend U run(Reactor & reactor, Task<U> task);
+
+    public:
+        typedef internal::TaskPromise<T> promise_type;
+
+        explicit Task(std::coroutine_handle<promise_type> h) : _handle(h) {}
+        Task(Task && other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+        Task & operator=(Task && other) noexcept {
+            if (this != &other) {
+                if (_handle) {
+                    _handle.destroy();
+                }
+                _handle = std::exchange(other._handle, nullptr);
+            }
+            return *this;
+        }
+        Task(const Task &) = delete;
+        Task & operator=(const Task &) = delete;
+        ~Task() {
+            if (_handle) {
+                _handle.destroy();
+            }
+        }
+
+        bool await_ready() const noexcept { return !_handle || _handle.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+            _handle.promise().continuation = awaiter;
+            return _handle;
+        }
+        T await_resume() { return _handle.promise().outcome.get(); }
+
+    private:
+        std::coroutine_handle<promise_type> _handle;
+    };
+
+    template<typename T>
+    Task<T> internal::TaskPromise<T>::get_return_object() {
+        return Task<T>(std::coroutine_handle<TaskPromise<T> >::from_promise(*this));
+    }
+
+    inline Task<void> internal::TaskPromise<void>::get_return_object() {
+        return Task<void>(std::coroutine_handle<TaskPromise<void> >::from_promise(*this));
+    }
+
+    /*
+     * Awaitable is the result of a CoClient query: co_await it to send the query and get its decoded result,
+     * or the exception that the TcpClient call would have thrown.
+     * The query is sent when awaited, an Awaitable must be awaited once.
+     */
+    template<typename T>
+    class Awaitable {
+    public:
+        typedef std::function<void(const std::shared_ptr<internal::AwaitState<T> > & state)> Starter;
+
+        explicit Awaitable(Starter start) :
+                _start(std::move(start)),
+                _state(std::make_shared<internal::AwaitState<T> >()) {
+        }
+        Awaitable(Awaitable &&) = default;
+        Awaitable & operator=(Awaitable &&) = default;
+        Awaitable(const Awaitable &) = delete;
+        Awaitable & operator=(const Awaitable &) = delete;
+        ~Awaitable() {
+            if (_state) {
+                // The awaiting frame is being destroyed, the reply must not resume it.
+                _state->waiter = nullptr;
+            }
+        }
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> awaiter) {
+            _start(_state);
+            if (_state->completed) {
+                // Failed at once, without waiting for the reactor.
+                return false;
+            }
+            _state->waiter = awaiter;
+            return true;
+        }
+        T await_resume() { return _state->outcome.get(); }
+
+    private:
+        Starter _start;
+        std::shared_ptr<internal::AwaitState<T> > _state;
+    };
+
+    /*
+     * Starts a task on the current thread, which must run the reactor the task awaits on.
+     * An exception escaping the task terminates the program, as it would from a std::thread.
+     */
+    inline void spawn(Task<void> task) {
+        [](Task<void> t) -> internal::Detached {
+            co_await t;
+        }(std::move(task));
+    }
+
+    /*
+     * Runs the reactor until the task completes, then returns its result or throws its exception.
+     * If the reactor is stopped first, the task is destroyed and NutException is thrown.
+     */
+    template<typename T>
+    T run(Reactor & reactor, Task<T> task) {
+        // Without a continuation the task stays suspended at its end, its result kept in its frame.
+        task._handle.resume();
+        while (!task._handle.done() && reactor.runOnce(-1)) {
+        }
+        if (!task._handle.done()) {
+            throw NutException("Reactor stopped before the task completed");
+        }
+        return task.await_resume();
+    }
+
+    /*
+     * CoClient offers the AsyncClient queries as awaitables, for use in Task coroutines:
+     *     Task<void> poll(CoClient & client) {
+     *         co_await client.connect("localhost", 3493);
+     *         auto vars = co_await client.getDeviceVariableValues("myups");
+     *     }
+     * Like AsyncClient, it must be used from the reactor thread, and must outlive the queries it sends.
+     */
+    class CoClient {
+    public:
+        explicit CoClient(Reactor & reactor);
+
+        Awaitable<void> connect(const std::string & host, int port);
+        void disconnect();
+        bool isConnected() const;
+        /*
+         * Sets the timeout in seconds of the connection and of each reply, negative to wait forever.
+         */
+        void setTimeout(long timeout);
+
+        Awaitable<void> authenticate(const std::string & user, const std::string & passwd);
+        Awaitable<void> logout();
+
+        Awaitable<std::set<std::string> > getDeviceNames();
+        Awaitable<std::string> getDeviceDescription(const std::string & name);
+
+        Awaitable<std::set<std::string> > getDeviceVariableNames(const std::string & dev);
+        Awaitable<std::set<std::string> > getDeviceRWVariableNames(const std::string & dev);
+        Awaitable<std::string> getDeviceVariableDescription(const std::string & dev, const std::string & name);
+        Awaitable<std::vector<std::string> > getDeviceVariableValue(const std::string & dev, const std::string & name);
+        Awaitable<std::map<std::string, std::vector<std::string> > > getDeviceVariableValues(const std::string & dev);
+        Awaitable<TrackingID> setDeviceVariable(const std::string & dev, const std::string & name, const std::string & value);
+        Awaitable<TrackingID> setDeviceVariable(const std::string & dev, const std::string & name, const std::vector<std::string> & values);
+
+        Awaitable<std::set<std::string> > getDeviceCommandNames(const std::string & dev);
+        Awaitable<std::string> getDeviceCommandDescription(const std::string & dev, const std::string & name);
+        Awaitable<TrackingID> executeDeviceCommand(const std::string & dev, const std::string & name, const std::string & param = "");
+
+        Awaitable<void> deviceLogin(const std::string & dev);
+        Awaitable<void> deviceMaster(const std::string & dev);
+        Awaitable<void> deviceForcedShutdown(const std::string & dev);
+        Awaitable<int> deviceGetNumLogins(const std::string & dev);
+
+        /*
+         * Generic GET and LIST queries, as TcpClient::get() and TcpClient::list().
+         */
+        Awaitable<std::vector<std::string> > get(const std::string & subcmd, const std::string & params = "");
+        Awaitable<std::vector<std::vector<std::string> > > list(const std::string & subcmd, const std::string & params = "");
+        /*
+         * Shorthand for list("VAR", dev).
+         */
+        Awaitable<std::vector<std::vector<std::string> > > listVar(const std::string & dev);
+
+        /*
+         * Returns the underlying callback based client.
+         */
+        AsyncClient & asyncClient();
+
+    private:
+        AsyncClient _client;
+    };
+
+}
+
+#endif //NUTCLIENT_COROUTINE_H
@@ -3,6 +3,8 @@
 //
 
 #include "defaultsocket.h"
+#include <algorithm>
+#include <thread>
 
 namespace nut {
     namespace internal {
@@ -23,20 +25,165 @@ namespace nut {
             return ::closesocket(socket);
         }
 
+        inline int xshutdown(FD_TYPE socket) {
+            return ::shutdown(socket, SD_BOTH);
+        }
+
+        typedef WSABUF IoVec;
+
+        inline void setIoVec(IoVec & v, const char * buf, size_t size) {
+            v.buf = const_cast<char *>(buf);
+            v.len = static_cast<ULONG>(size);
+        }
+
+        inline size_t ioVecSize(const IoVec & v) {
+            return v.len;
+        }
+
+        inline void ioVecSkip(IoVec & v, size_t size) {
+            v.buf += size;
+            v.len -= static_cast<ULONG>(size);
+        }
+
+        inline bool xwouldblock() {
+            return WSAGetLastError() == WSAEWOULDBLOCK;
+        }
+
+        inline bool xinterrupted() {
+            return WSAGetLastError() == WSAEINTR;
+        }
+
+        inline bool xinprogress() {
+            return WSAGetLastError() == WSAEWOULDBLOCK;
+        }
+
+        inline void xsetnonblocking(FD_TYPE socket) {
+            u_long mode = 1;
+            ioctlsocket(socket, FIONBIO, &mode);
+        }
+
+        inline int xpoll(struct pollfd * fds, unsigned long count, int timeout) {
+            return WSAPoll(fds, count, timeout);
+        }
+
+        inline ssize_t xwritev(FD_TYPE socket, IoVec * iov, int count) {
+            DWORD sent = 0;
+            if (WSASend(socket, iov, count, &sent, 0, nullptr, nullptr) != 0) {
+                return -1;
+            }
+            return static_cast<ssize_t>(sent);
+        }
+
 #endif
 #ifndef WIN32
         #define FD_TYPE int
         inline int xread(FD_TYPE socket, char * buf, int size) {
             return ::read(socket, buf, size);
         }
+#ifdef MSG_NOSIGNAL
+        /* A write on a connection the peer or another thread shut down fails with EPIPE instead of a SIGPIPE. */
+        static const int WRITE_FLAGS = MSG_NOSIGNAL;
+#else
+        static const int WRITE_FLAGS = 0;
+#endif
         inline int xwrite(FD_TYPE socket, const char * buf, int size) {
-            return ::write(socket, buf, size);
+            return ::send(socket, buf, size, WRITE_FLAGS);
         }
         inline int xclose(FD_TYPE socket) {
             return ::close(socket);
         }
+        inline int xshutdown(FD_TYPE socket) {
+            return ::shutdown(socket, SHUT_RDWR);
+        }
+
+        typedef struct iovec IoVec;
+
+        inline void setIoVec(IoVec & v, const char * buf, size_t size) {
+            v.iov_base = const_cast<char *>(buf);
+            v.iov_len = size;
+        }
+
+        inline size_t ioVecSize(const IoVec & v) {
+            return v.iov_len;
+        }
+
+        inline void ioVecSkip(IoVec & v, size_t size) {
+            v.iov_base = static_cast<char *>(v.iov_base) + size;
+            v.iov_len -= size;
+        }
+
+        inline ssize_t xwritev(FD_TYPE socket, IoVec * iov, int count) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            return ::sendmsg(socket, &msg, WRITE_FLAGS);
+        }
+
+        inline bool xwouldblock() {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        inline bool xinterrupted() {
+            return errno == EINTR;
+        }
+
+        inline bool xinprogress() {
+            // An interrupted connect() goes on asynchronously, like a non blocking one.
+            return errno == EINPROGRESS || errno == EINTR;
+        }
+
+        inline void xsetnonblocking(FD_TYPE socket) {
+            int fd_flags = fcntl(socket, F_GETFL);
+            fcntl(socket, F_SETFL, fd_flags | O_NONBLOCK);
+        }
+
+        inline int xpoll(struct pollfd * fds, unsigned long count, int timeout) {
+            return ::poll(fds, static_cast<nfds_t>(count), timeout);
+        }
 #endif
 
+        /* Max buffers gathered by one sendmsg() call, IOV_MAX is 1024 on the common systems. */
+        static const int MAX_IOVEC = 1024;
+        /* Delay before starting a connection attempt to the next address, as recommended by RFC 8305 */
+        static const long CONNECTION_ATTEMPT_DELAY_MS = 250;
+        /* First and longest delays between the connections to a unix domain socket whose backlog is full */
+        static const long UNIX_CONNECT_FIRST_DELAY_MS = 1;
+        static const long UNIX_CONNECT_MAX_DELAY_MS = 50;
+        /* Name resolution attempts while the resolver answers EAI_AGAIN, and the first delay between them */
+        static const int RESOLVE_ATTEMPTS = 4;
+        static const long RESOLVE_BACKOFF_MS = 100;
+        /* Host prefix selecting a unix domain socket: unix:/path/to/socket */
+        static const char UNIX_PREFIX[] = "unix:";
+        static const size_t UNIX_PREFIX_LEN = sizeof(UNIX_PREFIX) - 1;
+        /* Default lifetimes in seconds of the resolver cache entries, see setResolverCacheTtl() */
+        static const long RESOLVER_CACHE_TTL = 30;
+        static const long RESOLVER_CACHE_NEGATIVE_TTL = 5;
+
+        /*
+         * poll() is used rather than select(), whose fd_set cannot hold descriptors above FD_SETSIZE.
+         */
+        bool waitSocket(SOCKET sock, bool forWrite, const Deadline & deadline) {
+            while (true) {
+                struct pollfd pfd;
+                pfd.fd = sock;
+                pfd.events = forWrite ? POLLOUT : POLLIN;
+                pfd.revents = 0;
+                // Recomputed at each turn, the wait may have been interrupted.
+                long ms = deadline.remainingMs();
+                int ret = xpoll(&pfd, 1, ms > INT_MAX ? INT_MAX : static_cast<int>(ms));
+                if (ret > 0) {
+                    return true;
+                }
+                if (ret == 0) {
+                    return false;
+                }
+                if (!xinterrupted()) {
+                    throw nut::SystemException();
+                }
+            }
+        }
+
         class DefaultSocket : public AbstractSocket {
         public:
             DefaultSocket();
@@ -55,12 +202,23 @@ namespace nut {
 
             std::string  read() override;
 
+            LineView readLine() override;
+
             void write(const std::string & s) override;
 
+            void writeLines(const std::vector<std::string> & lines) override;
+
+            void shutdown() override;
+
         private:
+            void failed();
+            size_t readSome(void * buf, size_t sz, const Deadline & deadline);
+            void writeAll(IoVec * iov, size_t count, const Deadline & deadline);
+            void wait(bool forWrite, const Deadline & deadline);
+
             SOCKET _sock;
-            struct timeval _tv;
-            std::string _buffer; /* Received buffer, string because data should be text only. */
+            LineBuffer _buffer; /* Received data not consumed yet. */
+            std::vector<IoVec> _iov; /* Gather list of writeLines(), kept to avoid reallocation. */
         };
 
 #ifdef WIN32
@@ -68,10 +226,7 @@ namespace nut {
 #endif
 
         DefaultSocket::DefaultSocket() :
-                _sock(INVALID_SOCKET),
-                _tv() {
-            _tv.tv_sec = -1;
-            _tv.tv_usec = 0;
+                _sock(INVALID_SOCKET) {
         }
 
         DefaultSocket::~DefaultSocket() {
@@ -85,20 +240,9 @@ namespace nut {
         }
 
         void DefaultSocket::connect(const std::string &host, int port) {
-            FD_TYPE sock_fd;
-            struct addrinfo hints, *res, *ai;
-            char sport[NI_MAXSERV];
-            int v;
-            fd_set wfds;
-            int error;
-            socklen_t error_size;
-            long fd_flags;
-
-            _sock = -1;
+            Deadline deadline(getTimeout());
 
-            if (host.empty()) {
-                throw nut::UnknownHostException();
-            }
+            disconnect();
 
 #ifdef WIN32
             if (!WSAInitialised) {
@@ -110,6 +254,337 @@ namespace nut {
             }
 #endif
 
+            _sock = openConnection(host, port, deadline, getOptions());
+
+
+#ifdef OLD
+            struct hostent *hostinfo = nullptr;
+    SOCKADDR_IN sin = { 0 };
+    hostinfo = ::gethostbyname(host.c_str());
+    if(hostinfo == nullptr) /* Host doesnt exist */
+    {
+        throw nut::UnknownHostException();
+    }
+
+    // Create socket
+    _sock = ::socket(PF_INET, SOCK_STREAM, 0);
+    if(_sock == INVALID_SOCKET)
+    {
+        throw nut::IOException("Cannot create socket");
+    }
+
+    // Connect
+    sin.sin_addr = *(IN_ADDR *) hostinfo->h_addr;
+    sin.sin_port = htons(port);
+    sin.sin_family = AF_INET;
+    if(::connect(_sock,(SOCKADDR *) &sin, sizeof(SOCKADDR)) == SOCKET_ERROR)
+    {
+        _sock = INVALID_SOCKET;
+        throw nut::IOException("Cannot connect to host");
+    }
+#endif // OLD
+        }
+
+        void DefaultSocket::disconnect() {
+            if (_sock != INVALID_SOCKET) {
+                ::closesocket(_sock);
+                _sock = INVALID_SOCKET;
+            }
+            _buffer.clear();
+        }
+
+        bool DefaultSocket::isConnected() const {
+            return _sock != INVALID_SOCKET;
+        }
+
+        void DefaultSocket::shutdown() {
+            if (_sock != INVALID_SOCKET) {
+                xshutdown(_sock);
+            }
+        }
+
+        /*
+         * Closes the connection after an error, unless the user of the socket closes it itself.
+         */
+        void DefaultSocket::failed() {
+            if (disconnectsOnError()) {
+                disconnect();
+            }
+        }
+
+        size_t DefaultSocket::read(void *buf, size_t sz) {
+            return readSome(buf, sz, Deadline(getTimeout()));
+        }
+
+        size_t DefaultSocket::write(const void *buf, size_t sz) {
+            if (!isConnected()) {
+                throw nut::NotConnectedException();
+            }
+
+            Deadline deadline(getTimeout());
+            while (true) {
+                ssize_t res = xwrite(_sock, static_cast<const char *>(buf), sz);
+                if (res >= 0) {
+                    return static_cast<size_t>(res);
+                }
+                if (xwouldblock()) {
+                    wait(true, deadline);
+                } else if (!xinterrupted()) {
+                    failed();
+                    throw nut::IOException("Error while writing on socket");
+                }
+            }
+        }
+
+        size_t DefaultSocket::readSome(void *buf, size_t sz, const Deadline & deadline) {
+            if (!isConnected()) {
+                throw nut::NotConnectedException();
+            }
+
+            while (true) {
+                // Try first, pipelined replies are often already there.
+                ssize_t res = xread(_sock, static_cast<char *>(buf), sz);
+                if (res >= 0) {
+                    return static_cast<size_t>(res);
+                }
+                if (xwouldblock()) {
+                    wait(false, deadline);
+                } else if (!xinterrupted()) {
+                    failed();
+                    throw nut::IOException("Error while reading from socket");
+                }
+            }
+        }
+
+        void DefaultSocket::wait(bool forWrite, const Deadline & deadline) {
+            if (!waitSocket(_sock, forWrite, deadline)) {
+                // Whatever answer comes later would be taken for the reply of the next query.
+                failed();
+                throw nut::TimeoutException();
+            }
+        }
+
+        std::string DefaultSocket::read() {
+            return readLine().str();
+        }
+
+        LineView DefaultSocket::readLine() {
+            const char * line;
+            size_t len;
+            Deadline deadline(getTimeout());
+
+            while (!_buffer.nextLine(line, len)) {
+                size_t room;
+                char * dst = _buffer.prepare(room);
+                size_t sz = readSome(dst, room, deadline);
+                if (sz == 0) {
+                    failed();
+                    throw nut::IOException("Server closed connection unexpectedly");
+                }
+                _buffer.commit(sz);
+            }
+            return LineView(line, len);
+        }
+        static const char NEWLINE = '\n';
+
+        void DefaultSocket::write(const std::string& s) {
+            IoVec iov[2];
+            setIoVec(iov[0], s.data(), s.size());
+            setIoVec(iov[1], &NEWLINE, 1);
+            writeAll(iov, 2, Deadline(getTimeout()));
+        }
+
+        void DefaultSocket::writeLines(const std::vector<std::string> & lines) {
+            _iov.resize(lines.size() * 2);
+            for (size_t n = 0; n < lines.size(); ++n) {
+                setIoVec(_iov[2 * n], lines[n].data(), lines[n].size());
+                setIoVec(_iov[2 * n + 1], &NEWLINE, 1);
+            }
+            if (!_iov.empty()) {
+                writeAll(&_iov[0], _iov.size(), Deadline(getTimeout()));
+            }
+        }
+
+        /*
+         * Writes the whole gather list, with as few system calls as the kernel allows.
+         */
+        void DefaultSocket::writeAll(IoVec * iov, size_t count, const Deadline & deadline) {
+            if (!isConnected()) {
+                throw nut::NotConnectedException();
+            }
+
+            while (count > 0) {
+                int n = count > static_cast<size_t>(MAX_IOVEC) ? MAX_IOVEC : static_cast<int>(count);
+                ssize_t res = xwritev(_sock, iov, n);
+                if (res == -1) {
+                    if (xwouldblock()) {
+                        wait(true, deadline);
+                        continue;
+                    }
+                    if (xinterrupted()) {
+                        continue;
+                    }
+                    failed();
+                    throw nut::IOException("Error while writing on socket");
+                }
+                if (res == 0) {
+                    failed();
+                    throw nut::IOException("Writing string failed");
+                }
+
+                // Skip what has been sent, a partial write may stop in the middle of a buffer.
+                size_t sent = static_cast<size_t>(res);
+                while (count > 0 && sent >= ioVecSize(*iov)) {
+                    sent -= ioVecSize(*iov);
+                    ++iov;
+                    --count;
+                }
+                if (sent > 0) {
+                    ioVecSkip(*iov, sent);
+                }
+            }
+        }
+
+        Deadline::Deadline(long timeout) :
+                _set(timeout >= 0),
+                _at(std::chrono::steady_clock::now() + std::chrono::seconds(timeout >= 0 ? timeout : 0)) {
+        }
+
+        bool Deadline::isSet() const {
+            return _set;
+        }
+
+        long Deadline::remainingMs() const {
+            if (!_set) {
+                return -1;
+            }
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(_at - std::chrono::steady_clock::now());
+            return left.count() > 0 ? static_cast<long>(left.count()) : 0;
+        }
+
+        LineBuffer::LineBuffer(size_t capacity) :
+                _data(capacity > 0 ? capacity : 1),
+                _base(&_data[0]),
+                _capacity(_data.size()),
+                _head(0),
+                _size(0),
+                _scanned(0) {
+        }
+
+        LineBuffer::LineBuffer(char * storage, size_t capacity) :
+                _data(storage != nullptr ? 0 : (capacity > 0 ? capacity : 1)),
+                _base(storage != nullptr ? storage : &_data[0]),
+                _capacity(storage != nullptr ? capacity : _data.size()),
+                _head(0),
+                _size(0),
+                _scanned(0) {
+        }
+
+        char * LineBuffer::prepare(size_t & sz) {
+            if (_size == _capacity) {
+                grow();
+            }
+            size_t tail = _head + _size;
+            if (tail >= _capacity) {
+                tail -= _capacity;
+                sz = _head - tail;
+            } else {
+                sz = _capacity - tail;
+            }
+            return _base + tail;
+        }
+
+        void LineBuffer::commit(size_t sz) {
+            _size += sz;
+        }
+
+        bool LineBuffer::nextLine(const char *& data, size_t & sz) {
+            const size_t cap = _capacity;
+            const char * base = _base;
+
+            while (_scanned < _size) {
+                size_t pos = _head + _scanned;
+                if (pos >= cap) {
+                    pos -= cap;
+                }
+                size_t chunk = _size - _scanned;
+                if (chunk > cap - pos) {
+                    chunk = cap - pos;
+                }
+                const char * nl = static_cast<const char *>(memchr(base + pos, '\n', chunk));
+                if (nl == nullptr) {
+                    _scanned += chunk;
+                    continue;
+                }
+
+                size_t len = _scanned + static_cast<size_t>(nl - (base + pos));
+                if (_head + len <= cap) {
+                    data = base + _head;
+                } else {
+                    // The line crosses the end of the ring, this is the only case when it is copied.
+                    size_t first = cap - _head;
+                    _wrapped.assign(base + _head, first);
+                    _wrapped.append(base, len - first);
+                    data = _wrapped.data();
+                }
+                sz = len;
+                consume(len + 1);
+                return true;
+            }
+            return false;
+        }
+
+        bool LineBuffer::empty() const {
+            return _size == 0;
+        }
+
+        void LineBuffer::clear() {
+            _head = 0;
+            _size = 0;
+            _scanned = 0;
+        }
+
+        void LineBuffer::grow() {
+            std::vector<char> data(_capacity * 2);
+            size_t first = _capacity - _head;
+            if (first > _size) {
+                first = _size;
+            }
+            memcpy(&data[0], _base + _head, first);
+            memcpy(&data[first], _base, _size - first);
+            _data.swap(data);
+            _base = &_data[0];
+            _capacity = _data.size();
+            _head = 0;
+        }
+
+        void LineBuffer::consume(size_t sz) {
+            _head += sz;
+            if (_head >= _capacity) {
+                _head -= _capacity;
+            }
+            _size -= sz;
+            _scanned = 0;
+            if (_size == 0) {
+                // Restart at the beginning to offer the largest contiguous space to the next recv().
+                _head = 0;
+            }
+        }
+
+        /*
+         * Asks the resolver, bypassing the cache.
+         */
+        static std::vector<Endpoint> lookup(const std::string & host, int port, const Deadline & deadline) {
+            struct addrinfo hints, *res, *ai;
+            char sport[NI_MAXSERV];
+            int v;
+            int attempt = 0;
+            long backoff = RESOLVE_BACKOFF_MS;
+
+            if (host.empty()) {
+                throw nut::UnknownHostException();
+            }
+
             snprintf(sport, sizeof(sport), "%hu", static_cast<unsigned short int>(port));
 
             memset(&hints, 0, sizeof(hints));
@@ -119,13 +594,24 @@ namespace nut {
 
             while ((v = getaddrinfo(host.c_str(), sport, &hints, &res)) != 0) {
                 switch (v) {
-                    case EAI_AGAIN:
+                    case EAI_AGAIN: {
+                        // The resolver is temporarily unavailable: retry a few times, backing off.
+                        if (++attempt >= RESOLVE_ATTEMPTS) {
+                            throw nut::NutException("Temporary failure in name resolution");
+                        }
+                        long left = deadline.remainingMs();
+                        if (left == 0) {
+                            throw nut::TimeoutException();
+                        }
+                        std::this_thread::sleep_for(std::chrono::milliseconds(left > 0 && left < backoff ? left : backoff));
+                        backoff *= 2;
                         continue;
+                    }
                     case EAI_NONAME:
                         throw nut::UnknownHostException();
 #ifndef WIN32
-                        case EAI_SYSTEM:
-            throw nut::SystemException();
+                    case EAI_SYSTEM:
+                        throw nut::SystemException();
 #endif
                     case EAI_MEMORY:
                         throw nut::NutException("Out of memory");
@@ -134,230 +620,474 @@ namespace nut {
                 }
             }
 
+            std::vector<Endpoint> endpoints;
             for (ai = res; ai != nullptr; ai = ai->ai_next) {
-
-                sock_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
-
-                if (sock_fd < 0) {
-                    switch (errno) {
-                        case EAFNOSUPPORT:
-                        case EINVAL:
-                            break;
-                        default:
-                            throw nut::SystemException();
-                    }
+                if (ai->ai_addrlen > sizeof(Endpoint::addr)) {
                     continue;
                 }
+                Endpoint ep;
+                ep.family = ai->ai_family;
+                ep.socktype = ai->ai_socktype;
+                ep.protocol = ai->ai_protocol;
+                ep.addrlen = static_cast<socklen_t>(ai->ai_addrlen);
+                memcpy(&ep.addr, ai->ai_addr, ai->ai_addrlen);
+                endpoints.push_back(ep);
+            }
+            freeaddrinfo(res);
 
-
-#ifndef WIN32
-                /* non blocking connect */
-        if(hasTimeout()) {
-            fd_flags = fcntl(sock_fd, F_GETFL);
-            fd_flags |= O_NONBLOCK;
-            fcntl(sock_fd, F_SETFL, fd_flags);
+            // Alternate the address families (RFC 8305, section 4), keeping the resolver order within each,
+            // so that a dead route of one family delays the other one by one attempt at most.
+            std::vector<Endpoint> sorted;
+            sorted.reserve(endpoints.size());
+            std::vector<bool> taken(endpoints.size(), false);
+            int family = endpoints.empty() ? AF_UNSPEC : endpoints[0].family;
+            while (sorted.size() < endpoints.size()) {
+                size_t n = 0;
+                while (n < endpoints.size() && (taken[n] || endpoints[n].family != family)) {
+                    ++n;
+                }
+                if (n == endpoints.size()) {
+                    // No address of this family left, take the first one left.
+                    n = 0;
+                    while (taken[n]) {
+                        ++n;
+                    }
+                }
+                taken[n] = true;
+                sorted.push_back(endpoints[n]);
+                family = endpoints[n].family == AF_INET6 ? AF_INET : AF_INET6;
+            }
+            return sorted;
         }
-#endif
 
-                while ((v = ::connect(sock_fd, ai->ai_addr, ai->ai_addrlen)) < 0) {
-                    if (errno == EINPROGRESS) {
-                        FD_ZERO(&wfds);
-                        FD_SET(sock_fd, &wfds);
-                        select(sock_fd + 1, nullptr, &wfds, nullptr, hasTimeout() ? &_tv : nullptr);
-                        if (FD_ISSET(sock_fd, &wfds)) {
-                            error_size = sizeof(error);
-#ifndef WIN32
-                            getsockopt(sock_fd, SOL_SOCKET, SO_ERROR,
-                            &error, &error_size);
-#endif
+        /*
+         * Builds the endpoint of a unix:/path host.
+         */
+        static Endpoint unixEndpoint(const std::string & path) {
 #ifdef WIN32
-                            getsockopt(sock_fd, SOL_SOCKET, SO_ERROR,
-                                       (char *) &error, &error_size);
+            NUT_UNUSED_VARIABLE(path);
+            throw nut::IOException("Unix domain sockets are not supported");
+#else
+            struct sockaddr_un addr;
+            if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+                throw nut::UnknownHostException();
+            }
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            memcpy(addr.sun_path, path.data(), path.size());
+
+            Endpoint ep;
+            ep.family = AF_UNIX;
+            ep.socktype = SOCK_STREAM;
+            ep.protocol = 0;
+            ep.addrlen = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path.size() + 1);
+            memset(&ep.addr, 0, sizeof(ep.addr));
+            memcpy(&ep.addr, &addr, sizeof(addr));
+            return ep;
 #endif
-                            if (error == 0) {
-                                /* connect successful */
-                                v = 0;
-                                break;
-                            }
-                            errno = error;
-                        } else {
-                            /* Timeout */
-                            v = -1;
-                            break;
-                        }
-                    }
+        }
+
+        std::vector<Endpoint> resolve(const std::string & host, int port, const Deadline & deadline) {
+            if (host.empty()) {
+                throw nut::UnknownHostException();
+            }
+            if (host.compare(0, UNIX_PREFIX_LEN, UNIX_PREFIX) == 0) {
+                // Nothing to resolve nor to cache, the port is meaningless.
+                return std::vector<Endpoint>(1, unixEndpoint(host.substr(UNIX_PREFIX_LEN)));
+            }
 
-                    switch (errno) {
-                        case EAFNOSUPPORT:
-                            break;
-                        case EINTR:
-                        case EAGAIN:
-                            continue;
-                        default:
-//				ups->upserror = UPSCLI_ERR_CONNFAILURE;
-//				ups->syserrno = errno;
-                            break;
+            std::ostringstream key;
+            key << host << ':' << port;
+            ResolverCache & cache = ResolverCache::instance();
+            std::vector<Endpoint> endpoints;
+            switch (cache.acquire(key.str(), endpoints, deadline)) {
+                case ResolverCache::HIT:
+                    return endpoints;
+                case ResolverCache::UNKNOWN:
+                    throw nut::UnknownHostException();
+                case ResolverCache::MISS:
+                    break;
+            }
+
+            try {
+                endpoints = lookup(host, port, deadline);
+            }
+            catch (nut::UnknownHostException &) {
+                cache.storeUnknown(key.str());
+                throw;
+            }
+            catch (...) {
+                cache.abandon(key.str());
+                throw;
+            }
+            cache.store(key.str(), endpoints);
+            return endpoints;
+        }
+
+        ResolverCache & ResolverCache::instance() {
+            static ResolverCache cache;
+            return cache;
+        }
+
+        ResolverCache::ResolverCache() :
+                _ttl(RESOLVER_CACHE_TTL),
+                _negativeTtl(RESOLVER_CACHE_NEGATIVE_TTL),
+                _hits(0),
+                _misses(0) {
+        }
+
+        ResolverCache::Result ResolverCache::acquire(const std::string & key, std::vector<Endpoint> & endpoints,
+                                                     const Deadline & deadline) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true) {
+                auto it = _entries.find(key);
+                if (it != _entries.end()) {
+                    if (it->second.expires > std::chrono::steady_clock::now()) {
+                        ++_hits;
+                        if (it->second.unknown) {
+                            return UNKNOWN;
+                        }
+                        endpoints = it->second.endpoints;
+                        return HIT;
                     }
+                    _entries.erase(it);
+                }
+                if (_ttl <= 0 || _resolving.count(key) == 0) {
                     break;
                 }
 
-                if (v < 0) {
-                    xclose(sock_fd);
-                    continue;
+                // Another thread is resolving this host, its answer will do.
+                long left = deadline.remainingMs();
+                if (left == 0) {
+                    throw nut::TimeoutException();
                 }
+                if (left < 0) {
+                    _resolved.wait(lock);
+                } else {
+                    _resolved.wait_for(lock, std::chrono::milliseconds(left));
+                }
+            }
+            ++_misses;
+            if (_ttl > 0) {
+                _resolving.insert(key);
+            }
+            return MISS;
+        }
 
-#ifndef WIN32
-                /* switch back to blocking operation */
-        if(hasTimeout()) {
-            fd_flags = fcntl(sock_fd, F_GETFL);
-            fd_flags &= ~O_NONBLOCK;
-            fcntl(sock_fd, F_SETFL, fd_flags);
+        void ResolverCache::store(const std::string & key, const std::vector<Endpoint> & endpoints) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            insert(key, endpoints, false, _ttl);
         }
-#endif
-                _sock = sock_fd;
-//		ups->upserror = 0;
-//		ups->syserrno = 0;
-                break;
-            }
 
-            freeaddrinfo(res);
+        void ResolverCache::storeUnknown(const std::string & key) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            insert(key, std::vector<Endpoint>(), true, _negativeTtl);
+        }
 
-            if (_sock < 0) {
-                throw nut::IOException("Cannot connect to host");
+        void ResolverCache::abandon(const std::string & key) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _resolving.erase(key);
+            _resolved.notify_all();
+        }
+
+        /*
+         * Caches a lookup result and wakes the threads waiting for it. The caller holds _mutex.
+         */
+        void ResolverCache::insert(const std::string & key, const std::vector<Endpoint> & endpoints, bool unknown,
+                                   long ttl) {
+            _resolving.erase(key);
+            _resolved.notify_all();
+            if (ttl <= 0 || _ttl <= 0) {
+                return;
             }
 
+            auto now = std::chrono::steady_clock::now();
+            if (_entries.size() >= MAX_ENTRIES) {
+                for (auto it = _entries.begin(); it != _entries.end();) {
+                    if (it->second.expires <= now) {
+                        it = _entries.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                if (_entries.size() >= MAX_ENTRIES) {
+                    _entries.clear();
+                }
+            }
+            Entry & entry = _entries[key];
+            entry.endpoints = endpoints;
+            entry.unknown = unknown;
+            entry.expires = now + std::chrono::seconds(ttl);
+        }
 
-#ifdef OLD
-            struct hostent *hostinfo = nullptr;
-    SOCKADDR_IN sin = { 0 };
-    hostinfo = ::gethostbyname(host.c_str());
-    if(hostinfo == nullptr) /* Host doesnt exist */
-    {
-        throw nut::UnknownHostException();
-    }
+        void ResolverCache::setTtl(long ttl, long negativeTtl) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ttl = ttl;
+            _negativeTtl = negativeTtl;
+            if (_ttl <= 0) {
+                _entries.clear();
+            }
+        }
 
-    // Create socket
-    _sock = ::socket(PF_INET, SOCK_STREAM, 0);
-    if(_sock == INVALID_SOCKET)
-    {
-        throw nut::IOException("Cannot create socket");
-    }
+        void ResolverCache::invalidate() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _entries.clear();
+        }
 
-    // Connect
-    sin.sin_addr = *(IN_ADDR *) hostinfo->h_addr;
-    sin.sin_port = htons(port);
-    sin.sin_family = AF_INET;
-    if(::connect(_sock,(SOCKADDR *) &sin, sizeof(SOCKADDR)) == SOCKET_ERROR)
-    {
-        _sock = INVALID_SOCKET;
-        throw nut::IOException("Cannot connect to host");
-    }
-#endif // OLD
+        void ResolverCache::invalidate(const std::string & key) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _entries.erase(key);
         }
 
-        void DefaultSocket::disconnect() {
-            if (_sock != INVALID_SOCKET) {
-                ::closesocket(_sock);
-                _sock = INVALID_SOCKET;
-            }
-            _buffer.clear();
+        ResolverCacheStats ResolverCache::stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ResolverCacheStats stats;
+            stats.hits = _hits;
+            stats.misses = _misses;
+            stats.entries = _entries.size();
+            return stats;
         }
 
-        bool DefaultSocket::isConnected() const {
-            return _sock != INVALID_SOCKET;
+        static void setIntOption(SOCKET sock, int level, int name, int value) {
+            // Best effort: a refused value leaves the system default.
+            setsockopt(sock, level, name, reinterpret_cast<const char *>(&value), sizeof(value));
         }
 
-        size_t DefaultSocket::read(void *buf, size_t sz) {
-            if (!isConnected()) {
-                throw nut::NotConnectedException();
+        void applySocketOptions(SOCKET sock, int family, const SocketOptions & options) {
+            // Buffer sizes must be set before connecting, the TCP window scale is negotiated then.
+            if (options.receiveBufferSize > 0) {
+                setIntOption(sock, SOL_SOCKET, SO_RCVBUF, options.receiveBufferSize);
             }
+            if (options.sendBufferSize > 0) {
+                setIntOption(sock, SOL_SOCKET, SO_SNDBUF, options.sendBufferSize);
+            }
+            if (family != AF_INET && family != AF_INET6) {
+                return;  // The other options are TCP ones
+            }
+            if (options.noDelay) {
+                setIntOption(sock, IPPROTO_TCP, TCP_NODELAY, 1);
+            }
+            if (options.keepAlive) {
+                setIntOption(sock, SOL_SOCKET, SO_KEEPALIVE, 1);
+#if defined(TCP_KEEPIDLE)
+                if (options.keepAliveIdle > 0) {
+                    setIntOption(sock, IPPROTO_TCP, TCP_KEEPIDLE, options.keepAliveIdle);
+                }
+#elif defined(TCP_KEEPALIVE) /* macOS */
+                if (options.keepAliveIdle > 0) {
+                    setIntOption(sock, IPPROTO_TCP, TCP_KEEPALIVE, options.keepAliveIdle);
+                }
+#endif
+#ifdef TCP_KEEPINTVL
+                if (options.keepAliveInterval > 0) {
+                    setIntOption(sock, IPPROTO_TCP, TCP_KEEPINTVL, options.keepAliveInterval);
+                }
+#endif
+#ifdef TCP_KEEPCNT
+                if (options.keepAliveCount > 0) {
+                    setIntOption(sock, IPPROTO_TCP, TCP_KEEPCNT, options.keepAliveCount);
+                }
+#endif
+            }
+#ifdef TCP_USER_TIMEOUT
+            if (options.userTimeout > 0) {
+                setIntOption(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, static_cast<int>(options.userTimeout));
+            }
+#endif
+        }
 
-            if (_tv.tv_sec >= 0) {
-                fd_set fds;
-                FD_ZERO(&fds);
-                FD_SET(_sock, &fds);
-                int ret = select(_sock + 1, &fds, nullptr, nullptr, &_tv);
-                if (ret < 1) {
-                    throw nut::TimeoutException();
+        SOCKET startConnect(const Endpoint & ep, bool & pending, const SocketOptions & options) {
+            pending = false;
+            FD_TYPE sock_fd = socket(ep.family, ep.socktype, ep.protocol);
+            if (sock_fd == INVALID_SOCKET) {
+                switch (errno) {
+                    case EAFNOSUPPORT:
+                    case EINVAL:
+                        return INVALID_SOCKET;
+                    default:
+                        throw nut::SystemException();
                 }
             }
 
-            ssize_t res = xread(_sock, static_cast<char *>(buf), sz);
-            if (res == -1) {
-                disconnect();
-                throw nut::IOException("Error while reading from socket");
+            /* The socket stays non blocking, all operations wait for readiness within their deadline */
+            xsetnonblocking(sock_fd);
+            applySocketOptions(sock_fd, ep.family, options);
+
+            if (::connect(sock_fd, reinterpret_cast<const struct sockaddr *>(&ep.addr), ep.addrlen) < 0) {
+                if (!xinprogress()) {
+                    // Keep the error of connect() for the caller.
+                    int error = errno;
+                    xclose(sock_fd);
+                    errno = error;
+                    return INVALID_SOCKET;
+                }
+                pending = true;
             }
-            return static_cast<size_t>(res);
+            return sock_fd;
         }
 
-        size_t DefaultSocket::write(const void *buf, size_t sz) {
-            if (!isConnected()) {
-                throw nut::NotConnectedException();
+        /*
+         * Closes the connection attempts still in progress.
+         */
+        static void closeAttempts(std::vector<struct pollfd> & attempts) {
+            for (size_t n = 0; n < attempts.size(); ++n) {
+                xclose(attempts[n].fd);
             }
+            attempts.clear();
+        }
 
-            if (_tv.tv_sec >= 0) {
-                fd_set fds;
-                FD_ZERO(&fds);
-                FD_SET(_sock, &fds);
-                int ret = select(_sock + 1, nullptr, &fds, nullptr, &_tv);
-                if (ret < 1) {
+#ifndef WIN32
+        /*
+         * Connects to a unix domain socket. On Linux a full listen backlog fails its connect() at once with
+         * EAGAIN rather than leaving it in progress, so the connection is tried again until the deadline.
+         */
+        static SOCKET openUnixConnection(const Endpoint & ep, const Deadline & deadline,
+                                         const SocketOptions & options) {
+            long delay = UNIX_CONNECT_FIRST_DELAY_MS;
+            while (true) {
+                bool pending;
+                SOCKET sock_fd = startConnect(ep, pending, options);
+                if (sock_fd != INVALID_SOCKET) {
+                    if (pending && (!waitSocket(sock_fd, true, deadline) || !connectSucceeded(sock_fd))) {
+                        bool expired = deadline.remainingMs() == 0;
+                        xclose(sock_fd);
+                        if (expired) {
+                            throw nut::TimeoutException();
+                        }
+                        throw nut::IOException("Cannot connect to host");
+                    }
+                    return sock_fd;
+                }
+                if (!xwouldblock()) {
+                    throw nut::IOException("Cannot connect to host");
+                }
+                long timeout = deadline.remainingMs();
+                if (timeout == 0) {
                     throw nut::TimeoutException();
                 }
+                std::this_thread::sleep_for(std::chrono::milliseconds(timeout > 0 && timeout < delay ? timeout : delay));
+                delay = std::min(delay * 2, UNIX_CONNECT_MAX_DELAY_MS);
             }
+        }
+#endif
 
-            ssize_t res = xwrite(_sock, static_cast<const char *>(buf), sz);
-            if (res == -1) {
-                disconnect();
-                throw nut::IOException("Error while writing on socket");
+        SOCKET openConnection(const std::string & host, int port, const Deadline & deadline,
+                              const SocketOptions & options) {
+            std::vector<Endpoint> endpoints = resolve(host, port, deadline);
+#ifndef WIN32
+            if (endpoints.size() == 1 && endpoints[0].family == AF_UNIX) {
+                return openUnixConnection(endpoints[0], deadline, options);
             }
-            return static_cast<size_t>(res);
-        }
-        std::string DefaultSocket::read() {
-            std::string res;
-            char buff[256];
-
-            while(true)
-            {
-                // Look at already read data in _buffer
-                if(!_buffer.empty())
-                {
-                    size_t idx = _buffer.find('\n');
-                    if(idx!=std::string::npos)
-                    {
-                        res += _buffer.substr(0, idx);
-                        _buffer.erase(0, idx+1);
-                        return res;
+#endif
+
+            // Happy Eyeballs (RFC 8305): a new attempt starts when the previous one fails, or when it has not
+            // completed within CONNECTION_ATTEMPT_DELAY_MS. The first connection established wins.
+            std::vector<struct pollfd> attempts;
+            size_t next = 0;
+            auto nextStart = std::chrono::steady_clock::now();
+
+            while (next < endpoints.size() || !attempts.empty()) {
+                auto now = std::chrono::steady_clock::now();
+                if (next < endpoints.size() && (attempts.empty() || now >= nextStart)) {
+                    bool pending;
+                    FD_TYPE sock_fd;
+                    try {
+                        sock_fd = startConnect(endpoints[next++], pending, options);
+                    }
+                    catch (...) {
+                        closeAttempts(attempts);
+                        throw;
+                    }
+                    if (sock_fd == INVALID_SOCKET) {
+                        continue;
+                    }
+                    if (!pending) {
+                        closeAttempts(attempts);
+                        return sock_fd;
                     }
-                    res += _buffer;
+                    struct pollfd pfd;
+                    pfd.fd = sock_fd;
+                    pfd.events = POLLOUT;
+                    pfd.revents = 0;
+                    attempts.push_back(pfd);
+                    nextStart = now + std::chrono::milliseconds(CONNECTION_ATTEMPT_DELAY_MS);
+                    continue;
                 }
 
-                // Read new buffer
-                size_t sz = read(&buff, 256);
-                if(sz==0)
-                {
-                    disconnect();
-                    throw nut::IOException("Server closed connection unexpectedly");
+                long timeout = deadline.remainingMs();
+                if (timeout == 0) {
+                    closeAttempts(attempts);
+                    throw nut::TimeoutException();
+                }
+                if (next < endpoints.size()) {
+                    long delay = static_cast<long>(
+                            std::chrono::duration_cast<std::chrono::milliseconds>(nextStart - now).count()) + 1;
+                    if (timeout < 0 || delay < timeout) {
+                        timeout = delay;
+                    }
+                }
+                if (timeout > INT_MAX) {
+                    timeout = INT_MAX;
+                }
+
+                int res = xpoll(&attempts[0], static_cast<unsigned long>(attempts.size()), static_cast<int>(timeout));
+                if (res < 0) {
+                    if (xinterrupted()) {
+                        continue;
+                    }
+                    closeAttempts(attempts);
+                    throw nut::SystemException();
+                }
+
+                for (size_t n = 0; n < attempts.size();) {
+                    if (attempts[n].revents == 0) {
+                        ++n;
+                        continue;
+                    }
+                    FD_TYPE sock_fd = attempts[n].fd;
+                    attempts.erase(attempts.begin() + n);
+                    if (connectSucceeded(sock_fd)) {
+                        closeAttempts(attempts);
+                        return sock_fd;
+                    }
+                    xclose(sock_fd);
+                    // A failed attempt hands over to the next address at once.
+                    nextStart = std::chrono::steady_clock::now();
                 }
-                _buffer.assign(buff, sz);
             }
+
+            throw nut::IOException("Cannot connect to host");
         }
-        /*
-         * Don't touch this.
-         */
-        void DefaultSocket::write(const std::string& s) {
-            auto vs = s + '\n';
-            auto data = vs.data();
-            size_t nextPos = 0;
-            while (nextPos < vs.size()) {
-                size_t bw = write(reinterpret_cast<const void *>(&data[nextPos]), vs.size() - nextPos);
-                if (bw == 0)
-                    throw IOException("Writing string failed");
-                nextPos += bw;
+
+        bool connectSucceeded(SOCKET sock) {
+            int error = 0;
+            socklen_t error_size = sizeof(error);
+            if (getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &error_size) != 0) {
+                return false;
             }
+            return error == 0;
         }
 
         std::shared_ptr<nut::AbstractSocket> defaultFactory(){
             return std::shared_ptr<AbstractSocket>(new internal::DefaultSocket());
         };
     }
+
+    void setResolverCacheTtl(long ttl, long negativeTtl) {
+        internal::ResolverCache::instance().setTtl(ttl, negativeTtl);
+    }
+
+    void invalidateResolverCache() {
+        internal::ResolverCache::instance().invalidate();
+    }
+
+    void invalidateResolverCache(const std::string & host, int port) {
+        std::ostringstream key;
+        key << host << ':' << port;
+        internal::ResolverCache::instance().invalidate(key.str());
+    }
+
+    ResolverCacheStats getResolverCacheStats() {
+        return internal::ResolverCache::instance().stats();
+    }
 }
\ No newline at end of file
@@ -6,16 +6,27 @@
 #define NUTCLIENT_DEFAULTSOCKET_H
 #include "nutclient.h"
 #include <sstream>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 #ifdef WIN32
 #include <ws2tcpip.h>
 #include <io.h>
 #else
 #  include <sys/types.h>
 #  include <sys/socket.h>
+#  include <sys/uio.h> /* struct iovec */
+#  include <poll.h>
 #  include <netinet/in.h>
+#  include <netinet/tcp.h> /* TCP_NODELAY */
+#  include <sys/un.h> /* sockaddr_un */
+#  include <stddef.h> /* offsetof */
 #  include <arpa/inet.h>
 #  include <unistd.h> /* close */
 #  include <netdb.h> /* gethostbyname */
@@ -36,6 +47,196 @@ namespace nut {
 
         std::shared_ptr<nut::AbstractSocket> defaultFactory();
 
+        /*
+         * Point in time by which an operation must complete.
+         * Waits within the operation are computed from it, so the timeout bounds the whole operation
+         * rather than each system call.
+         */
+        class Deadline {
+        public:
+            /*
+             * Starts the countdown.
+             *     timeout - timeout in seconds, negative for no deadline
+             */
+            explicit Deadline(long timeout);
+            /*
+             * Returns true if the operation has a deadline.
+             */
+            bool isSet() const;
+            /*
+             * Returns the time left in milliseconds, 0 if the deadline has passed, and -1 if there is no deadline.
+             */
+            long remainingMs() const;
+
+        private:
+            bool _set;
+            std::chrono::steady_clock::time_point _at;
+        };
+
+        /*
+         * Resolved address of a server.
+         */
+        struct Endpoint {
+            int family;
+            int socktype;
+            int protocol;
+            socklen_t addrlen;
+            struct sockaddr_storage addr;
+        };
+
+        /*
+         * Resolves host and port into the list of addresses to try, in order, alternating IPv6 and IPv4.
+         * A unix:/path host gives the address of that unix domain socket, the port is then ignored.
+         * A temporary resolver failure (EAI_AGAIN) is retried a few times with an increasing delay.
+         *     deadline - bounds the retries
+         *     Throws UnknownHostException if the host is not found, TimeoutException if the deadline passes,
+         *     NutException or SystemException at any other error.
+         */
+        std::vector<Endpoint> resolve(const std::string & host, int port, const Deadline & deadline);
+
+        /*
+         * Process wide cache of the resolve() results, keyed by host:port.
+         * Positive entries hold the address list, negative ones remember that the host is unknown.
+         * Threads asking for a host being resolved wait for that lookup instead of starting their own.
+         */
+        class ResolverCache {
+        public:
+            enum Result {
+                HIT,        /* endpoints is set */
+                UNKNOWN,    /* the host is known to be unknown */
+                MISS        /* the caller must resolve, then call store(), storeUnknown() or abandon() */
+            };
+            /* Entries kept before the expired ones are purged */
+            enum { MAX_ENTRIES = 1024 };
+
+            static ResolverCache & instance();
+
+            Result acquire(const std::string & key, std::vector<Endpoint> & endpoints, const Deadline & deadline);
+            void store(const std::string & key, const std::vector<Endpoint> & endpoints);
+            void storeUnknown(const std::string & key);
+            /* The lookup failed for a transient reason, nothing is cached */
+            void abandon(const std::string & key);
+
+            void setTtl(long ttl, long negativeTtl);
+            void invalidate();
+            void invalidate(const std::string & key);
+            ResolverCacheStats stats() const;
+
+        private:
+            ResolverCache();
+            void insert(const std::string & key, const std::vector<Endpoint> & endpoints, bool unknown, long ttl);
+
+            struct Entry {
+                std::vector<Endpoint> endpoints;
+                bool unknown;
+                std::chrono::steady_clock::time_point expires;
+            };
+
+            mutable std::mutex _mutex;
+            std::condition_variable _resolved;
+            std::unordered_map<std::string, Entry> _entries;
+            std::set<std::string> _resolving;   /* keys being resolved by some thread */
+            long _ttl;
+            long _negativeTtl;
+            unsigned long long _hits;
+            unsigned long long _misses;
+        };
+
+        /*
+         * Applies the options to a socket of the address family, before it connects.
+         * TCP options are skipped for unix domain sockets, unsupported options are ignored.
+         */
+        void applySocketOptions(SOCKET sock, int family, const SocketOptions & options);
+        /*
+         * Creates a non blocking socket with the options and starts connecting it to the endpoint.
+         *     pending - set to true if the connection is in progress: wait for the socket to be writable,
+         *               then check the result with connectSucceeded()
+         *     Returns INVALID_SOCKET if the connection failed at once, with the error of connect() in errno.
+         *  Throws SystemException if the socket cannot be created.
+         */
+        SOCKET startConnect(const Endpoint & ep, bool & pending, const SocketOptions & options);
+        /*
+         * Returns true if the pending connection of the socket succeeded.
+         */
+        bool connectSucceeded(SOCKET sock);
+        /*
+         * Opens a non blocking connection to host:port. The resolved addresses are tried in turn, each one
+         * started 250 ms after the previous one (or as soon as it fails) while the previous attempts go on,
+         * and the first connection established is kept. A unix domain socket whose listen backlog is full is
+         * connected again until the deadline.
+         *     deadline - deadline of the whole connection
+         *     options - options of the socket
+         *  Throws UnknownHostException if the host is not found, TimeoutException if the deadline passes,
+         *  IOException("Cannot connect to host") if no address accepts the connection.
+         */
+        SOCKET openConnection(const std::string & host, int port, const Deadline & deadline,
+                              const SocketOptions & options);
+        /*
+         * Waits until the socket is readable, or writable if forWrite is set.
+         * Errors and hang-ups also end the wait, the following call reports them.
+         * Returns false if the deadline passes first.
+         */
+        bool waitSocket(SOCKET sock, bool forWrite, const Deadline & deadline);
+
+        /*
+         * Receive buffer for the line oriented NUT protocol.
+         * Received data is stored in a ring buffer, so a single recv() may service many lines and
+         * extracting a line never moves the remaining data. Newlines are searched with memchr(),
+         * which is vectorized by the C library, and each byte is scanned only once.
+         */
+        class LineBuffer {
+        public:
+            /* Big enough to hold a LIST VAR response of a typical UPS in one piece. */
+            enum { DEFAULT_CAPACITY = 32768 };
+
+            explicit LineBuffer(size_t capacity = DEFAULT_CAPACITY);
+            /*
+             * Creates a buffer receiving into the caller's storage, which must outlive it, or into its own
+             * if storage is null. The buffer moves to its own storage if it has to grow.
+             */
+            LineBuffer(char * storage, size_t capacity);
+            LineBuffer(const LineBuffer &) = delete;
+            LineBuffer & operator=(const LineBuffer &) = delete;
+
+            /*
+             * Returns the contiguous free space where the next received chunk should be stored.
+             *     sz - receives the size of that space
+             *     The buffer grows if it is full (a line longer than the buffer).
+             */
+            char * prepare(size_t & sz);
+            /*
+             * Marks sz bytes of the space returned by prepare() as received.
+             */
+            void commit(size_t sz);
+            /*
+             * Extracts the next complete line, without the \n separator.
+             *     data, sz - receive the line
+             *     Returns false if no complete line has been received yet.
+             *  The line data stays valid until the next call of a non-const method.
+             */
+            bool nextLine(const char *& data, size_t & sz);
+            /*
+             * Returns true if no unread data is held.
+             */
+            bool empty() const;
+            /*
+             * Discards all unread data.
+             */
+            void clear();
+
+        private:
+            void grow();
+            void consume(size_t sz);
+
+            std::vector<char> _data;  /* own storage, empty while the caller's is used */
+            char * _base;         /* storage in use */
+            size_t _capacity;
+            size_t _head;         /* offset of the first unread byte */
+            size_t _size;         /* count of unread bytes */
+            size_t _scanned;      /* count of unread bytes already known to contain no newline */
+            std::string _wrapped; /* assembled copy of the last line if it crossed the end of _data */
+        };
+
     }
 }
 #endif //NUTCLIENT_DEFAULTSOCKET_H
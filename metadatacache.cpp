@@ -0,0 +1,153 @@
+//
+// Cache of the device metadata (variable and command names, descriptions), used by TcpClient.
+//
+
+#include "metadatacache.h"
+
+namespace nut {
+    namespace internal {
+
+        /* Estimated bookkeeping cost of an entry and of a name, besides the characters */
+        static const size_t ENTRY_OVERHEAD = 128;
+        static const size_t NAME_OVERHEAD = 48;
+
+        MetadataCache::MetadataCache(const MetadataCacheOptions & options) :
+                _options(options) {
+        }
+
+        bool MetadataCache::getNames(const std::string & key, std::set<std::string> & names) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Entry * entry = find(key);
+            if (entry == nullptr) {
+                ++_stats.misses;
+                return false;
+            }
+            ++_stats.hits;
+            names = entry->names;
+            return true;
+        }
+
+        bool MetadataCache::getText(const std::string & key, std::string & text) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Entry * entry = find(key);
+            if (entry == nullptr) {
+                ++_stats.misses;
+                return false;
+            }
+            ++_stats.hits;
+            text = entry->text;
+            return true;
+        }
+
+        void MetadataCache::putNames(const std::string & key, const std::set<std::string> & names) {
+            Entry entry;
+            entry.names = names;
+            entry.bytes = ENTRY_OVERHEAD + key.size();
+            for (std::set<std::string>::const_iterator it = names.begin(); it != names.end(); ++it) {
+                entry.bytes += NAME_OVERHEAD + it->size();
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            put(key, entry);
+        }
+
+        void MetadataCache::putText(const std::string & key, const std::string & text) {
+            Entry entry;
+            entry.text = text;
+            entry.bytes = ENTRY_OVERHEAD + key.size() + text.size();
+            std::lock_guard<std::mutex> lock(_mutex);
+            put(key, entry);
+        }
+
+        bool MetadataCache::knows(const std::string & key, const std::string & name, bool & known) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Entry * entry = find(key);
+            if (entry == nullptr) {
+                return false;
+            }
+            known = entry->names.count(name) != 0;
+            if (!known) {
+                ++_stats.rejected;
+            }
+            return true;
+        }
+
+        void MetadataCache::invalidate(const std::string & dev) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (dev.empty()) {
+                _entries.clear();
+                _lru.clear();
+                _stats.bytes = 0;
+                _stats.entries = 0;
+                return;
+            }
+            // Keys are "<kind> <dev>" or "<kind> <dev> <name>".
+            for (Entries::iterator it = _entries.begin(); it != _entries.end();) {
+                const std::string & key = it->first;
+                size_t begin = key.find(' ') + 1;
+                if (key.compare(begin, dev.size(), dev) == 0 &&
+                    (begin + dev.size() == key.size() || key[begin + dev.size()] == ' ')) {
+                    Entries::iterator next = it;
+                    ++next;
+                    erase(it);
+                    it = next;
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+
+        MetadataCacheStats MetadataCache::stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats;
+        }
+
+        /*
+         * Returns the live entry of a key, marked as most recently used. The caller holds _mutex.
+         */
+        MetadataCache::Entry * MetadataCache::find(const std::string & key) {
+            Entries::iterator it = _entries.find(key);
+            if (it == _entries.end()) {
+                return nullptr;
+            }
+            if (it->second.expires <= std::chrono::steady_clock::now()) {
+                ++_stats.expirations;
+                erase(it);
+                return nullptr;
+            }
+            _lru.splice(_lru.begin(), _lru, it->second.lru);
+            return &it->second;
+        }
+
+        /*
+         * Stores an entry, evicting the least recently used ones beyond the size bound. The caller holds _mutex.
+         */
+        void MetadataCache::put(const std::string & key, Entry & entry) {
+            if (entry.bytes > _options.maxBytes) {
+                return;
+            }
+            Entries::iterator old = _entries.find(key);
+            if (old != _entries.end()) {
+                erase(old);
+            }
+            while (!_lru.empty() && _stats.bytes + entry.bytes > _options.maxBytes) {
+                ++_stats.evictions;
+                erase(_entries.find(_lru.back()));
+            }
+            entry.expires = std::chrono::steady_clock::now() + std::chrono::seconds(_options.ttl);
+            _lru.push_front(key);
+            entry.lru = _lru.begin();
+            _stats.bytes += entry.bytes;
+            ++_stats.entries;
+            _entries[key] = std::move(entry);
+        }
+
+        void MetadataCache::erase(Entries::iterator it) {
+            _stats.bytes -= it->second.bytes;
+            --_stats.entries;
+            _lru.erase(it->second.lru);
+            _entries.erase(it);
+        }
+
+    }
+}
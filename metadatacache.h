@@ -0,0 +1,73 @@
+//
+// Cache of the device metadata (variable and command names, descriptions), used by TcpClient.
+//
+
+#ifndef NUTCLIENT_METADATACACHE_H
+#define NUTCLIENT_METADATACACHE_H
+#include "nutclient.h"
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
+namespace nut {
+    namespace internal {
+
+        /*
+         * MetadataCache keeps the replies of the queries whose result hardly ever changes: LIST VAR, LIST RW and
+         * LIST CMD names, and the DESC and CMDDESC descriptions. Entries expire after a TTL, and the least
+         * recently used ones are evicted once the estimated memory size exceeds its bound.
+         * Entries are keyed by the query, "VAR ups", "DESC ups ups.status"...
+         * All the methods are thread safe.
+         */
+        class MetadataCache {
+        public:
+            explicit MetadataCache(const MetadataCacheOptions & options);
+
+            /*
+             * Looks a set of names or a description up, returns false on a miss.
+             */
+            bool getNames(const std::string & key, std::set<std::string> & names);
+            bool getText(const std::string & key, std::string & text);
+            /*
+             * Stores a set of names or a description.
+             */
+            void putNames(const std::string & key, const std::set<std::string> & names);
+            void putText(const std::string & key, const std::string & text);
+            /*
+             * Tests a name against a cached set of names without touching the statistics.
+             * Returns false if the set is not cached, otherwise sets known.
+             */
+            bool knows(const std::string & key, const std::string & name, bool & known);
+            /*
+             * Drops the entries of a device, or all the entries if dev is empty.
+             */
+            void invalidate(const std::string & dev);
+
+            MetadataCacheStats stats() const;
+
+        private:
+            struct Entry {
+                std::set<std::string> names;
+                std::string text;
+                size_t bytes;
+                std::chrono::steady_clock::time_point expires;
+                std::list<std::string>::iterator lru;
+            };
+            typedef std::unordered_map<std::string, Entry> Entries;
+
+            Entry * find(const std::string & key);
+            void put(const std::string & key, Entry & entry);
+            void erase(Entries::iterator it);
+
+            MetadataCacheOptions _options;
+            mutable std::mutex _mutex;
+            Entries _entries;
+            std::list<std::string> _lru;   /* Keys, most recently used first */
+            MetadataCacheStats _stats;
+        };
+
+    }
+}
+
+#endif //NUTCLIENT_METADATACACHE_H
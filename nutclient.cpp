@@ -19,6 +19,30 @@
 
 #include "nutclient.h"
 
+#include "pipeline.h"
+#include "metadatacache.h"
+#include "standardnames.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <locale>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <random>
+#include <thread>
+
+#include <sstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 #ifdef BUILD_WITH_DEFAULT_SOCKET
 #include "defaultsocket.h"
 #endif
@@ -120,6 +144,20 @@ LIB_API void registerSocketFactory(const std::function<std::shared_ptr<AbstractS
     nut::internal::socketFactory = factory;
 }
 
+LineView AbstractSocket::readLine()
+{
+    _line = read();
+    return LineView(_line);
+}
+
+void AbstractSocket::writeLines(const std::vector<std::string> & lines)
+{
+    for (std::vector<std::string>::const_iterator it = lines.cbegin(); it != lines.cend(); ++it)
+    {
+        write(*it);
+    }
+}
+
 /*
  *
  * Client implementation
@@ -231,6 +269,287 @@ bool Client::hasFeature(const Feature& feature)
 	}
 }
 
+/*
+ * The default asynchronous queries run the blocking ones when the future is waited for.
+ */
+
+std::future<std::set<std::string> > Client::getDeviceNamesAsync()
+{
+	return std::async(std::launch::deferred, [this]() { return getDeviceNames(); });
+}
+
+std::future<std::string> Client::getDeviceDescriptionAsync(const std::string& name)
+{
+	return std::async(std::launch::deferred, [this, name]() { return getDeviceDescription(name); });
+}
+
+std::future<std::set<std::string> > Client::getDeviceVariableNamesAsync(const std::string& dev)
+{
+	return std::async(std::launch::deferred, [this, dev]() { return getDeviceVariableNames(dev); });
+}
+
+std::future<std::set<std::string> > Client::getDeviceRWVariableNamesAsync(const std::string& dev)
+{
+	return std::async(std::launch::deferred, [this, dev]() { return getDeviceRWVariableNames(dev); });
+}
+
+std::future<std::string> Client::getDeviceVariableDescriptionAsync(const std::string& dev, const std::string& name)
+{
+	return std::async(std::launch::deferred, [this, dev, name]() { return getDeviceVariableDescription(dev, name); });
+}
+
+std::future<std::vector<std::string> > Client::getDeviceVariableValueAsync(const std::string& dev, const std::string& name)
+{
+	return std::async(std::launch::deferred, [this, dev, name]() { return getDeviceVariableValue(dev, name); });
+}
+
+std::future<std::map<std::string,std::vector<std::string> > > Client::getDeviceVariableValuesAsync(const std::string& dev)
+{
+	return std::async(std::launch::deferred, [this, dev]() { return getDeviceVariableValues(dev); });
+}
+
+std::future<TrackingID> Client::setDeviceVariableAsync(const std::string& dev, const std::string& name, const std::string& value)
+{
+	return std::async(std::launch::deferred, [this, dev, name, value]() { return setDeviceVariable(dev, name, value); });
+}
+
+std::future<TrackingID> Client::setDeviceVariableAsync(const std::string& dev, const std::string& name, const std::vector<std::string>& values)
+{
+	return std::async(std::launch::deferred, [this, dev, name, values]() { return setDeviceVariable(dev, name, values); });
+}
+
+std::future<std::set<std::string> > Client::getDeviceCommandNamesAsync(const std::string& dev)
+{
+	return std::async(std::launch::deferred, [this, dev]() { return getDeviceCommandNames(dev); });
+}
+
+std::future<std::string> Client::getDeviceCommandDescriptionAsync(const std::string& dev, const std::string& name)
+{
+	return std::async(std::launch::deferred, [this, dev, name]() { return getDeviceCommandDescription(dev, name); });
+}
+
+std::future<TrackingID> Client::executeDeviceCommandAsync(const std::string& dev, const std::string& name, const std::string& param)
+{
+	return std::async(std::launch::deferred, [this, dev, name, param]() { return executeDeviceCommand(dev, name, param); });
+}
+
+std::future<void> Client::deviceLoginAsync(const std::string& dev)
+{
+	return std::async(std::launch::deferred, [this, dev]() { deviceLogin(dev); });
+}
+
+std::future<int> Client::deviceGetNumLoginsAsync(const std::string& dev)
+{
+	return std::async(std::launch::deferred, [this, dev]() { return deviceGetNumLogins(dev); });
+}
+
+std::future<TrackingResult> Client::getTrackingResultAsync(const TrackingID& id)
+{
+	return std::async(std::launch::deferred, [this, id]() { return getTrackingResult(id); });
+}
+
+/*
+ *
+ * ValueParser implementation
+ *
+ */
+
+bool ValueParser::parseInt(const LineView& value, int64_t& res)
+{
+	size_t pos = 0;
+	bool negative = false;
+	if(pos < value.size() && value[pos] == '-')
+	{
+		negative = true;
+		++pos;
+	}
+	if(pos == value.size())
+	{
+		return false;
+	}
+	// Accumulated as a negative number, whose range includes INT64_MIN.
+	const int64_t min = std::numeric_limits<int64_t>::min();
+	int64_t num = 0;
+	for(; pos < value.size(); ++pos)
+	{
+		int digit = value[pos] - '0';
+		if(digit < 0 || digit > 9 || num < (min + digit) / 10)
+		{
+			return false;
+		}
+		num = num * 10 - digit;
+	}
+	if(!negative && num == min)
+	{
+		return false;
+	}
+	res = negative ? num : -num;
+	return true;
+}
+
+bool ValueParser::parseDouble(const LineView& value, double& res)
+{
+	static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	size_t pos = 0;
+	bool negative = false;
+	if(pos < value.size() && value[pos] == '-')
+	{
+		negative = true;
+		++pos;
+	}
+
+	// Up to 19 significant digits in mantissa, the number is mantissa * 10^exponent.
+	uint64_t mantissa = 0;
+	int significant = 0, exponent = 0;
+	bool digits = false, truncated = false, fraction = false;
+	for(; pos < value.size(); ++pos)
+	{
+		char c = value[pos];
+		if(c == '.' && !fraction)
+		{
+			fraction = true;
+			continue;
+		}
+		if(c < '0' || c > '9')
+		{
+			break;
+		}
+		digits = true;
+		if(significant < 19)
+		{
+			mantissa = mantissa * 10 + (c - '0');
+			significant += mantissa != 0;
+			exponent -= fraction;
+		}
+		else
+		{
+			truncated = truncated || c != '0';
+			exponent += !fraction;
+		}
+	}
+	if(!digits)
+	{
+		return false;
+	}
+	if(pos < value.size() && (value[pos] == 'e' || value[pos] == 'E'))
+	{
+		++pos;
+		bool negativeExp = false;
+		if(pos < value.size() && (value[pos] == '-' || value[pos] == '+'))
+		{
+			negativeExp = value[pos++] == '-';
+		}
+		if(pos == value.size())
+		{
+			return false;
+		}
+		int exp = 0;
+		for(; pos < value.size() && value[pos] >= '0' && value[pos] <= '9'; ++pos)
+		{
+			exp = std::min(exp * 10 + (value[pos] - '0'), 100000);
+		}
+		exponent += negativeExp ? -exp : exp;
+	}
+	if(pos != value.size())
+	{
+		return false;
+	}
+
+	// Exact operands give a correctly rounded result (Clinger's fast path).
+	if(mantissa == 0)
+	{
+		res = negative ? -0.0 : 0.0;
+		return true;
+	}
+	if(!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double num = static_cast<double>(mantissa);
+		num = exponent < 0 ? num / POW10[-exponent] : num * POW10[exponent];
+		res = negative ? -num : num;
+		return true;
+	}
+	// Long or huge numbers, rare in NUT values.
+	std::istringstream stream(value.str());
+	stream.imbue(std::locale::classic());
+	double num;
+	stream >> num;
+	if(stream.fail())
+	{
+		return false;
+	}
+	res = num;
+	return true;
+}
+
+unsigned int ValueParser::parseStatusFlags(const LineView& value)
+{
+	static const struct
+	{
+		const char* name;
+		StatusFlag flag;
+	} FLAGS[] = {
+		{"OL", STATUS_OL}, {"OB", STATUS_OB}, {"LB", STATUS_LB}, {"HB", STATUS_HB},
+		{"RB", STATUS_RB}, {"CHRG", STATUS_CHRG}, {"DISCHRG", STATUS_DISCHRG}, {"BYPASS", STATUS_BYPASS},
+		{"CAL", STATUS_CAL}, {"OFF", STATUS_OFF}, {"OVER", STATUS_OVER}, {"TRIM", STATUS_TRIM},
+		{"BOOST", STATUS_BOOST}, {"FSD", STATUS_FSD}, {"ALARM", STATUS_ALARM}, {"TEST", STATUS_TEST},
+	};
+	unsigned int flags = 0;
+	size_t pos = 0;
+	while(pos < value.size())
+	{
+		size_t end = pos;
+		while(end < value.size() && value[end] != ' ')
+		{
+			++end;
+		}
+		for(size_t n=0; n<sizeof(FLAGS)/sizeof(FLAGS[0]); ++n)
+		{
+			if(LineView(value.data() + pos, end - pos).equals(FLAGS[n].name, strlen(FLAGS[n].name)))
+			{
+				flags |= FLAGS[n].flag;
+				break;
+			}
+		}
+		pos = end + 1;
+	}
+	return flags;
+}
+
+namespace internal
+{
+
+static const std::string& firstValue(const std::vector<std::string>& values, const std::string& name)
+{
+	if(values.empty())
+	{
+		throw NutException("No value for " + name);
+	}
+	return values[0];
+}
+
+static double toDouble(const std::vector<std::string>& values, const std::string& name)
+{
+	double res;
+	if(!ValueParser::parseDouble(firstValue(values, name), res))
+	{
+		throw NutException("Not a number: " + name);
+	}
+	return res;
+}
+
+static int64_t toInt(const std::vector<std::string>& values, const std::string& name)
+{
+	int64_t res;
+	if(!ValueParser::parseInt(firstValue(values, name), res))
+	{
+		throw NutException("Not an integer: " + name);
+	}
+	return res;
+}
+
+}/* namespace internal */
+
 /*
  *
  * TCP Client implementation
@@ -241,17 +560,29 @@ TcpClient::TcpClient():
 Client(),
 _host("localhost"),
 _port(3493),
-_timeout(0),
-_socket(internal::socketFactory())
+_timeout(-1),
+_socket(internal::socketFactory()),
+_resilient(false)
 {
 	// Do not connect now
 }
 
 TcpClient::TcpClient(const std::string& host, int port):
 Client(),
-_timeout(0),
-_socket(internal::socketFactory())
+_timeout(-1),
+_socket(internal::socketFactory()),
+_resilient(false)
+{
+	connect(host, port);
+}
+
+TcpClient::TcpClient(const std::string& host, int port, const SocketOptions& options):
+Client(),
+_timeout(-1),
+_socket(internal::socketFactory()),
+_resilient(false)
 {
+	_socket->setOptions(options);
 	connect(host, port);
 }
 
@@ -263,11 +594,19 @@ void TcpClient::connect(const std::string& host, int port)
 {
 	_host = host;
 	_port = port;
+	// A new server, the recorded session state does not apply.
+	_user.clear();
+	_passwd.clear();
+	_logins.clear();
+	_masters.clear();
+	_features.clear();
+	invalidateMetadata();
 	connect();
 }
 
 void TcpClient::connect()
 {
+	drainAsync();
 	_socket->connect(_host, _port);
 }
 
@@ -288,12 +627,14 @@ bool TcpClient::isConnected()const
 
 void TcpClient::disconnect()
 {
+	drainAsync();
 	_socket->disconnect();
 }
 
 void TcpClient::setTimeout(long timeout)
 {
 	_timeout = timeout;
+	_socket->setTimeout(timeout);
 }
 
 long TcpClient::getTimeout()const
@@ -301,16 +642,176 @@ long TcpClient::getTimeout()const
 	return _timeout;
 }
 
+void TcpClient::setSocketOptions(const SocketOptions& options)
+{
+	_socket->setOptions(options);
+}
+
+SocketOptions TcpClient::getSocketOptions()const
+{
+	return _socket->getOptions();
+}
+
+void TcpClient::setMultiplexed(bool multiplexed)
+{
+	if(multiplexed && !_pipeline)
+	{
+		drainAsync();
+		_pipeline = std::make_shared<internal::Pipeline>(_socket);
+	}
+	else if(!multiplexed && _pipeline)
+	{
+		_pipeline.reset();
+		_socket->setDisconnectOnError(true);
+	}
+}
+
+bool TcpClient::isMultiplexed()const
+{
+	return _pipeline != nullptr;
+}
+
+void TcpClient::setResilient(bool resilient, const ReconnectPolicy& policy)
+{
+	_resilient = resilient;
+	_reconnectPolicy = policy;
+}
+
+bool TcpClient::isResilient()const
+{
+	return _resilient;
+}
+
+void TcpClient::setMetadataCache(bool enabled, const MetadataCacheOptions& options)
+{
+	_metadata = enabled ? std::make_shared<internal::MetadataCache>(options) : nullptr;
+}
+
+void TcpClient::invalidateMetadata(const std::string& dev)
+{
+	if(_metadata)
+	{
+		_metadata->invalidate(dev);
+	}
+}
+
+MetadataCacheStats TcpClient::getMetadataCacheStats()const
+{
+	return _metadata ? _metadata->stats() : MetadataCacheStats();
+}
+
+void TcpClient::reconnect()
+{
+	// Full jitter: spreads the reconnections of the clients that lost the same server.
+	// The first attempt is immediate, a one-off failure is recovered at once.
+	static thread_local std::mt19937 random(std::random_device{}());
+	drainAsync();
+	for(int attempt = 0; ; ++attempt)
+	{
+		if(attempt > 0)
+		{
+			double uniform = std::uniform_real_distribution<double>(0, 1)(random);
+			std::this_thread::sleep_for(std::chrono::milliseconds(reconnectDelay(_reconnectPolicy, attempt, uniform)));
+		}
+		try
+		{
+			_socket->disconnect();
+			_socket->connect(_host, _port);
+			replaySession();
+			return;
+		}
+		catch(IOException&)
+		{
+			if(_reconnectPolicy.maxAttempts >= 0 && attempt + 1 >= _reconnectPolicy.maxAttempts)
+			{
+				throw;
+			}
+		}
+	}
+}
+
+/*
+ * Returns the delay before the attempt following the given failed ones, uniform being the draw in [0, 1).
+ */
+long TcpClient::reconnectDelay(const ReconnectPolicy& policy, int failures, double uniform)
+{
+	// pow() overflows to infinity, capped by maxDelay.
+	double bound = std::min(static_cast<double>(policy.initialDelay) * std::pow(policy.multiplier, failures - 1),
+		static_cast<double>(policy.maxDelay));
+	return static_cast<long>(uniform * bound);
+}
+
+/*
+ * Reconnects after a failed query in resilient mode. Returns false if the client does not recover by itself.
+ */
+bool TcpClient::recover()
+{
+	if(!_resilient || _pipeline)
+	{
+		return false;
+	}
+	reconnect();
+	return true;
+}
+
+void TcpClient::replaySession()
+{
+	if(!_user.empty())
+	{
+		detectError(sendQuery("USERNAME " + _user));
+		detectError(sendQuery("PASSWORD " + _passwd));
+	}
+	for(std::set<std::string>::const_iterator it=_logins.begin(); it!=_logins.end(); ++it)
+	{
+		detectError(sendQuery("LOGIN " + *it));
+	}
+	for(std::set<std::string>::const_iterator it=_masters.begin(); it!=_masters.end(); ++it)
+	{
+		detectError(sendQuery("MASTER " + *it));
+	}
+	for(std::map<Feature, bool>::const_iterator it=_features.begin(); it!=_features.end(); ++it)
+	{
+		detectError(sendQuery("SET " + it->first + " " + (it->second ? "ON" : "OFF")));
+	}
+}
+
+/*
+ * Runs a query which can safely be sent again, retrying it once after a reconnection in resilient mode.
+ */
+template<typename T>
+T TcpClient::idempotent(const std::function<T()>& query)
+{
+	try
+	{
+		return query();
+	}
+	catch(IOException&)
+	{
+		if(!recover())
+		{
+			throw;
+		}
+	}
+	return query();
+}
+
 void TcpClient::authenticate(const std::string& user, const std::string& passwd)
 {
 	detectError(sendQuery("USERNAME " + user));
 	detectError(sendQuery("PASSWORD " + passwd));
+	_user = user;
+	_passwd = passwd;
 }
 
 void TcpClient::logout()
 {
 	detectError(sendQuery("LOGOUT"));
 	_socket->disconnect();
+	_user.clear();
+	_passwd.clear();
+	_logins.clear();
+	_masters.clear();
+	_features.clear();
 }
 
 Device TcpClient::getDevice(const std::string& name)
@@ -352,60 +853,124 @@ std::string TcpClient::getDeviceDescription(const std::string& name)
 
 std::set<std::string> TcpClient::getDeviceVariableNames(const std::string& dev)
 {
-	std::set<std::string> set;
-
-	std::vector<std::vector<std::string> > res = list("VAR", dev);
-	for(size_t n=0; n<res.size(); ++n)
-	{
-		set.insert(res[n][0]);
-	}
-
-	return set;
+	return names("VAR", dev);
 }
 
 std::set<std::string> TcpClient::getDeviceRWVariableNames(const std::string& dev)
 {
-	std::set<std::string> set;
-
-	std::vector<std::vector<std::string> > res = list("RW", dev);
-	for(size_t n=0; n<res.size(); ++n)
-	{
-		set.insert(res[n][0]);
-	}
-
-	return set;
-}
+	return names("RW", dev);
+}
 
 std::string TcpClient::getDeviceVariableDescription(const std::string& dev, const std::string& name)
 {
-	return get("DESC", dev + " " + name)[0];
+	checkName("VAR", dev, name);
+	return description("DESC", dev, name);
 }
 
 std::vector<std::string> TcpClient::getDeviceVariableValue(const std::string& dev, const std::string& name)
 {
+	checkName("VAR", dev, name);
 	return get("VAR", dev + " " + name);
 }
 
-std::map<std::string,std::vector<std::string> > TcpClient::getDeviceVariableValues(const std::string& dev)
+/*
+ * Maps the rows of a LIST VAR reply by variable name.
+ */
+static std::map<std::string,std::vector<std::string> > variableValues(std::vector<std::vector<std::string> > res)
 {
-
 	std::map<std::string,std::vector<std::string> >  map;
 
-	std::vector<std::vector<std::string> > res = list("VAR", dev);
 	for(size_t n=0; n<res.size(); ++n)
 	{
-		std::vector<std::string>& vals = res[n];
-		std::string var = vals[0];
-		vals.erase(vals.begin());
-		map[var] = vals;
+		std::vector<std::string>& row = res[n];
+		map[std::move(row[0])].assign(std::make_move_iterator(row.begin() + 1), std::make_move_iterator(row.end()));
 	}
 
 	return map;
 }
 
+std::map<std::string,std::vector<std::string> > TcpClient::getDeviceVariableValues(const std::string& dev)
+{
+	return variableValues(list("VAR", dev));
+}
+
 std::map<std::string,std::map<std::string,std::vector<std::string> > > TcpClient::getDevicesVariableValues(const std::set<std::string>& devs)
 {
-	std::map<std::string,std::map<std::string,std::vector<std::string> > > map;
+	typedef std::map<std::string,std::map<std::string,std::vector<std::string> > > DevicesValues;
+	return listDevicesVariables<DevicesValues>(devs, [this](DevicesValues& map, const std::string& dev, const std::string& req, const std::vector<std::string>* lines)
+	{
+		std::map<std::string,std::vector<std::string> > vars;
+		forEachListRow(req, lines, [&vars, &req](const LineView& row)
+		{
+			std::vector<std::string> vals = explode(row, req.size());
+			std::string var = vals[0];
+			vals.erase(vals.begin());
+			vars[var].swap(vals);
+		});
+		map[dev].swap(vars);
+	});
+}
+
+DeviceSnapshot TcpClient::getDeviceVariableSnapshot(const std::string& dev)
+{
+	const std::string req = "VAR " + dev;
+	return idempotent<DeviceSnapshot>([this, &req]()
+	{
+		std::vector<std::string> query(1, "LIST " + req);
+		std::vector<std::vector<std::string> > replies;
+		if(_pipeline)
+		{
+			_pipeline->execute(query, replies);
+		}
+		else
+		{
+			sendAsyncQueries(query);
+		}
+		return parseSnapshot(req, _pipeline ? &replies[0] : nullptr);
+	});
+}
+
+void TcpClient::getDeviceVariableTable(const std::string& dev, ListTable& table)
+{
+	list("VAR", dev, table);
+}
+
+std::map<std::string,DeviceSnapshot> TcpClient::getDevicesVariableSnapshots(const std::set<std::string>& devs)
+{
+	typedef std::map<std::string,DeviceSnapshot> Snapshots;
+	return listDevicesVariables<Snapshots>(devs, [this](Snapshots& map, const std::string& dev, const std::string& req, const std::vector<std::string>* lines)
+	{
+		DeviceSnapshot snapshot = parseSnapshot(req, lines);
+		std::swap(map[dev], snapshot);
+	});
+}
+
+/*
+ * Decodes a LIST VAR reply into a scratch snapshot kept by the thread, then copies it at its exact size: once
+ * the scratch has grown to the size of the replies, a snapshot costs its three allocations.
+ */
+DeviceSnapshot TcpClient::parseSnapshot(const std::string& req, const std::vector<std::string>* lines)
+{
+	static thread_local DeviceSnapshot scratch;
+	scratch.clear();
+	forEachListRow(req, lines, [&req](const LineView& row)
+	{
+		appendSnapshotRow(scratch, row, req.size());
+	});
+	DeviceSnapshot snapshot(scratch);
+	snapshot.seal();
+	return snapshot;
+}
+
+/*
+ * Sends LIST VAR for every device in one batch, and hands the reply of each device to add(), which parses it
+ * with forEachListRow() and adds it to the map. Throws if no device replied.
+ */
+template<typename Map>
+Map TcpClient::listDevicesVariables(const std::set<std::string>& devs,
+	const std::function<void(Map&, const std::string&, const std::string&, const std::vector<std::string>*)>& add)
+{
+	Map map;
 
 	if (devs.empty())
 	{
@@ -415,33 +980,44 @@ std::map<std::string,std::map<std::string,std::vector<std::string> > > TcpClient
 		return map;
 	}
 
-	std::vector<std::string> queries;
-	for (std::set<std::string>::const_iterator it=devs.cbegin(); it!=devs.cend(); ++it)
+	map = idempotent<Map>([this, &devs, &add]()
 	{
-		queries.push_back("LIST VAR " + *it);
-	}
-	sendAsyncQueries(queries);
+		Map map;
+		std::vector<std::string> queries;
+		for (std::set<std::string>::const_iterator it=devs.cbegin(); it!=devs.cend(); ++it)
+		{
+			queries.push_back("LIST VAR " + *it);
+		}
+		// In multiplexed mode, the replies are all gathered before being parsed.
+		std::vector<std::vector<std::string> > replies;
+		if(_pipeline)
+		{
+			_pipeline->execute(queries, replies);
+		}
+		else
+		{
+			sendAsyncQueries(queries);
+		}
 
-	for (std::set<std::string>::const_iterator it=devs.cbegin(); it!=devs.cend(); ++it)
-	{
-		try
+		size_t n = 0;
+		for (std::set<std::string>::const_iterator it=devs.cbegin(); it!=devs.cend(); ++it, ++n)
 		{
-			std::map<std::string,std::vector<std::string> > map2;
-			std::vector<std::vector<std::string> > res = parseList("VAR " + *it);
-			for (std::vector<std::vector<std::string> >::iterator it2=res.begin(); it2!=res.end(); ++it2)
+			try
 			{
-				std::vector<std::string>& vals = *it2;
-				std::string var = vals[0];
-				vals.erase(vals.begin());
-				map2[var] = vals;
+				add(map, *it, "VAR " + *it, _pipeline ? &replies[n] : nullptr);
+			}
+			catch (IOException&)
+			{
+				// The connection is lost, the replies left will not come.
+				throw;
+			}
+			catch (NutException&)
+			{
+				// We sent a bunch of queries, we need to process them all to clear up the backlog.
 			}
-			map[*it] = map2;
-		}
-		catch (NutException&)
-		{
-			// We sent a bunch of queries, we need to process them all to clear up the backlog.
 		}
-	}
+		return map;
+	});
 
 	if (map.empty())
 	{
@@ -470,30 +1046,25 @@ TrackingID TcpClient::setDeviceVariable(const std::string& dev, const std::strin
 
 std::set<std::string> TcpClient::getDeviceCommandNames(const std::string& dev)
 {
-	std::set<std::string> cmds;
-
-	std::vector<std::vector<std::string> > res = list("CMD", dev);
-	for(size_t n=0; n<res.size(); ++n)
-	{
-		cmds.insert(res[n][0]);
-	}
-
-	return cmds;
+	return names("CMD", dev);
 }
 
 std::string TcpClient::getDeviceCommandDescription(const std::string& dev, const std::string& name)
 {
-	return get("CMDDESC", dev + " " + name)[0];
+	checkName("CMD", dev, name);
+	return description("CMDDESC", dev, name);
 }
 
 TrackingID TcpClient::executeDeviceCommand(const std::string& dev, const std::string& name, const std::string& param)
 {
+	checkName("CMD", dev, name);
 	return sendTrackingQuery("INSTCMD " + dev + " " + name + " " + param);
 }
 
 void TcpClient::deviceLogin(const std::string& dev)
 {
 	detectError(sendQuery("LOGIN " + dev));
+	_logins.insert(dev);
 }
 
 /* FIXME: Protocol update needed to handle master/primary alias
@@ -502,6 +1073,7 @@ void TcpClient::deviceLogin(const std::string& dev)
 void TcpClient::deviceMaster(const std::string& dev)
 {
 	detectError(sendQuery("MASTER " + dev));
+	_masters.insert(dev);
 }
 
 void TcpClient::deviceForcedShutdown(const std::string& dev)
@@ -511,8 +1083,7 @@ void TcpClient::deviceForcedShutdown(const std::string& dev)
 
 int TcpClient::deviceGetNumLogins(const std::string& dev)
 {
-	std::string num = get("NUMLOGINS", dev)[0];
-	return atoi(num.c_str());
+	return static_cast<int>(internal::toInt(get("NUMLOGINS", dev), "NUMLOGINS"));
 }
 
 TrackingResult TcpClient::getTrackingResult(const TrackingID& id)
@@ -522,8 +1093,11 @@ TrackingResult TcpClient::getTrackingResult(const TrackingID& id)
 		return TrackingResult::SUCCESS;
 	}
 
-	std::string result = sendQuery("GET TRACKING " + id);
+	return idempotent<TrackingResult>([this, &id]() { return parseTrackingResult(sendQuery("GET TRACKING " + id)); });
+}
 
+TrackingResult TcpClient::parseTrackingResult(const LineView& result)
+{
 	if (result == "PENDING")
 	{
 		return TrackingResult::PENDING;
@@ -548,8 +1122,12 @@ TrackingResult TcpClient::getTrackingResult(const TrackingID& id)
 
 bool TcpClient::isFeatureEnabled(const Feature& feature)
 {
-	std::string result = sendQuery("GET " + feature);
-	detectError(result);
+	std::string result = idempotent<std::string>([this, &feature]()
+	{
+		LineView res = sendQuery("GET " + feature);
+		detectError(res);
+		return res.str();
+	});
 
 	if (result == "ON")
 	{
@@ -566,8 +1144,371 @@ bool TcpClient::isFeatureEnabled(const Feature& feature)
 }
 void TcpClient::setFeature(const Feature& feature, bool status)
 {
-	std::string result = sendQuery("SET " + feature + " " + (status ? "ON" : "OFF"));
-	detectError(result);
+	detectError(sendQuery("SET " + feature + " " + (status ? "ON" : "OFF")));
+	_features[feature] = status;
+}
+
+/*
+ * Returns a future holding an answer known without querying the server.
+ */
+template<typename T>
+static std::future<T> readyAsync(const T& value)
+{
+	std::promise<T> done;
+	done.set_value(value);
+	return done.get_future();
+}
+
+template<typename T>
+static std::future<T> failedAsync(std::exception_ptr error)
+{
+	std::promise<T> done;
+	done.set_exception(error);
+	return done.get_future();
+}
+
+/*
+ * Returns the pipeline carrying the asynchronous queries: the multiplexed one, or else the queue of the
+ * connection, created by the first query sent since the socket was last used directly.
+ */
+std::shared_ptr<internal::Pipeline> TcpClient::asyncPipeline()
+{
+	if(_pipeline)
+	{
+		return _pipeline;
+	}
+	if(_resilient && !_socket->isConnected())
+	{
+		// Lost by an earlier query. Reconnecting drains the queue, it is created again below.
+		reconnect();
+	}
+	std::lock_guard<std::mutex> lock(_asyncMutex);
+	if(!_asyncPipeline)
+	{
+		_asyncPipeline = std::make_shared<internal::Pipeline>(_socket);
+	}
+	return _asyncPipeline;
+}
+
+/*
+ * Hands the socket back to the blocking queries: reads the replies owed to the asynchronous queries sent
+ * without multiplexing, which keep them for their futures.
+ */
+void TcpClient::drainAsync()
+{
+	std::shared_ptr<internal::Pipeline> pipeline;
+	{
+		std::lock_guard<std::mutex> lock(_asyncMutex);
+		if(!_asyncPipeline)
+		{
+			return;
+		}
+		pipeline.swap(_asyncPipeline);
+	}
+	pipeline->drain();
+	_socket->setDisconnectOnError(true);
+}
+
+/*
+ * Sends a query at once, and returns a deferred future decoding its reply. The future keeps the pipeline, and
+ * so the socket, alive.
+ * In resilient mode without multiplexing, retry, given for the idempotent queries, runs the query again with
+ * its blocking method if the connection was lost, which reconnects.
+ */
+template<typename T, typename Decode>
+std::future<T> TcpClient::queryAsync(const std::string& req, Decode decode, const std::function<T()>& retry)
+{
+	std::function<T()> again = _resilient && !_pipeline ? retry : std::function<T()>();
+	std::shared_ptr<internal::Pipeline> pipeline;
+	try
+	{
+		pipeline = asyncPipeline();
+	}
+	catch(...)
+	{
+		return failedAsync<T>(std::current_exception());
+	}
+	internal::Pipeline::Ticket ticket = pipeline->submit(std::vector<std::string>(1, req))[0];
+	return std::async(std::launch::deferred, [pipeline, ticket, decode, again]() -> T
+	{
+		std::vector<std::string> lines;
+		try
+		{
+			pipeline->wait(ticket, lines);
+		}
+		catch(IOException&)
+		{
+			if(!again)
+			{
+				throw;
+			}
+			return again();
+		}
+		return decode(lines);
+	});
+}
+
+static std::set<std::string> firstColumn(const std::vector<std::vector<std::string> >& rows)
+{
+	std::set<std::string> res;
+	for(size_t n=0; n<rows.size(); ++n)
+	{
+		if(!rows[n].empty() && !rows[n][0].empty())
+			res.insert(rows[n][0]);
+	}
+	return res;
+}
+
+std::future<std::set<std::string> > TcpClient::getDeviceNamesAsync()
+{
+	return queryAsync<std::set<std::string> >("LIST UPS", [](const std::vector<std::string>& lines)
+	{
+		return firstColumn(parseList("UPS", lines));
+	}, [this]() { return getDeviceNames(); });
+}
+
+std::future<std::string> TcpClient::getDeviceDescriptionAsync(const std::string& name)
+{
+	std::string req = "UPSDESC " + name;
+	return queryAsync<std::string>("GET " + req, [req](const std::vector<std::string>& lines)
+	{
+		return parseGet(req, lines[0])[0];
+	}, [this, name]() { return getDeviceDescription(name); });
+}
+
+std::future<std::set<std::string> > TcpClient::getDeviceVariableNamesAsync(const std::string& dev)
+{
+	return namesAsync("VAR", dev);
+}
+
+std::future<std::set<std::string> > TcpClient::getDeviceRWVariableNamesAsync(const std::string& dev)
+{
+	return namesAsync("RW", dev);
+}
+
+std::future<std::string> TcpClient::getDeviceVariableDescriptionAsync(const std::string& dev, const std::string& name)
+{
+	try
+	{
+		checkName("VAR", dev, name);
+	}
+	catch(...)
+	{
+		return failedAsync<std::string>(std::current_exception());
+	}
+	return descriptionAsync("DESC", dev, name);
+}
+
+std::future<std::vector<std::string> > TcpClient::getDeviceVariableValueAsync(const std::string& dev, const std::string& name)
+{
+	try
+	{
+		checkName("VAR", dev, name);
+	}
+	catch(...)
+	{
+		return failedAsync<std::vector<std::string> >(std::current_exception());
+	}
+	std::string req = "VAR " + dev + " " + name;
+	return queryAsync<std::vector<std::string> >("GET " + req, [req](const std::vector<std::string>& lines)
+	{
+		return parseGet(req, lines[0]);
+	}, [this, dev, name]() { return getDeviceVariableValue(dev, name); });
+}
+
+std::future<std::map<std::string,std::vector<std::string> > > TcpClient::getDeviceVariableValuesAsync(const std::string& dev)
+{
+	std::string req = "VAR " + dev;
+	return queryAsync<std::map<std::string,std::vector<std::string> > >("LIST " + req, [req](const std::vector<std::string>& lines)
+	{
+		return variableValues(parseList(req, lines));
+	}, [this, dev]() { return getDeviceVariableValues(dev); });
+}
+
+std::future<TrackingID> TcpClient::setDeviceVariableAsync(const std::string& dev, const std::string& name, const std::string& value)
+{
+	return queryAsync<TrackingID>("SET VAR " + dev + " " + name + " " + escape(value), [](const std::vector<std::string>& lines)
+	{
+		return parseTrackingID(lines[0]);
+	});
+}
+
+std::future<TrackingID> TcpClient::setDeviceVariableAsync(const std::string& dev, const std::string& name, const std::vector<std::string>& values)
+{
+	std::string query = "SET VAR " + dev + " " + name;
+	for(size_t n=0; n<values.size(); ++n)
+	{
+		query += " " + escape(values[n]);
+	}
+	return queryAsync<TrackingID>(query, [](const std::vector<std::string>& lines)
+	{
+		return parseTrackingID(lines[0]);
+	});
+}
+
+std::future<std::set<std::string> > TcpClient::getDeviceCommandNamesAsync(const std::string& dev)
+{
+	return namesAsync("CMD", dev);
+}
+
+std::future<std::string> TcpClient::getDeviceCommandDescriptionAsync(const std::string& dev, const std::string& name)
+{
+	try
+	{
+		checkName("CMD", dev, name);
+	}
+	catch(...)
+	{
+		return failedAsync<std::string>(std::current_exception());
+	}
+	return descriptionAsync("CMDDESC", dev, name);
+}
+
+std::future<TrackingID> TcpClient::executeDeviceCommandAsync(const std::string& dev, const std::string& name, const std::string& param)
+{
+	try
+	{
+		checkName("CMD", dev, name);
+	}
+	catch(...)
+	{
+		return failedAsync<TrackingID>(std::current_exception());
+	}
+	return queryAsync<TrackingID>("INSTCMD " + dev + " " + name + " " + param, [](const std::vector<std::string>& lines)
+	{
+		return parseTrackingID(lines[0]);
+	});
+}
+
+std::future<void> TcpClient::deviceLoginAsync(const std::string& dev)
+{
+	return queryAsync<void>("LOGIN " + dev, [](const std::vector<std::string>& lines)
+	{
+		detectError(lines[0]);
+	});
+}
+
+std::future<int> TcpClient::deviceGetNumLoginsAsync(const std::string& dev)
+{
+	std::string req = "NUMLOGINS " + dev;
+	return queryAsync<int>("GET " + req, [req](const std::vector<std::string>& lines)
+	{
+		return static_cast<int>(internal::toInt(parseGet(req, lines[0]), "NUMLOGINS"));
+	}, [this, dev]() { return deviceGetNumLogins(dev); });
+}
+
+std::future<TrackingResult> TcpClient::getTrackingResultAsync(const TrackingID& id)
+{
+	if (id.empty())
+	{
+		return readyAsync(TrackingResult::SUCCESS);
+	}
+	return queryAsync<TrackingResult>("GET TRACKING " + id, [](const std::vector<std::string>& lines)
+	{
+		return parseTrackingResult(lines[0]);
+	}, [this, id]() { return getTrackingResult(id); });
+}
+
+/*
+ * Returns the names listed by LIST <subcmd> <dev>, from the metadata cache if possible.
+ */
+std::set<std::string> TcpClient::names(const std::string& subcmd, const std::string& dev)
+{
+	std::set<std::string> set;
+	const std::string key = subcmd + " " + dev;
+	if(_metadata && _metadata->getNames(key, set))
+	{
+		return set;
+	}
+
+	std::vector<std::vector<std::string> > res = list(subcmd, dev);
+	for(size_t n=0; n<res.size(); ++n)
+	{
+		set.insert(res[n][0]);
+	}
+
+	if(_metadata)
+	{
+		_metadata->putNames(key, set);
+	}
+	return set;
+}
+
+/*
+ * Returns the description given by GET <subcmd> <dev> <name>, from the metadata cache if possible.
+ */
+std::string TcpClient::description(const std::string& subcmd, const std::string& dev, const std::string& name)
+{
+	std::string desc;
+	const std::string key = subcmd + " " + dev + " " + name;
+	if(_metadata && _metadata->getText(key, desc))
+	{
+		return desc;
+	}
+	desc = get(subcmd, dev + " " + name)[0];
+	if(_metadata)
+	{
+		_metadata->putText(key, desc);
+	}
+	return desc;
+}
+
+/*
+ * Asynchronous names(): a cached list is returned at once, a fetched one is cached when decoded.
+ */
+std::future<std::set<std::string> > TcpClient::namesAsync(const std::string& subcmd, const std::string& dev)
+{
+	std::set<std::string> set;
+	const std::string key = subcmd + " " + dev;
+	if(_metadata && _metadata->getNames(key, set))
+	{
+		return readyAsync(set);
+	}
+	std::shared_ptr<internal::MetadataCache> metadata = _metadata;
+	return queryAsync<std::set<std::string> >("LIST " + key, [key, metadata](const std::vector<std::string>& lines)
+	{
+		std::set<std::string> set = firstColumn(parseList(key, lines));
+		if(metadata)
+		{
+			metadata->putNames(key, set);
+		}
+		return set;
+	}, [this, subcmd, dev]() { return names(subcmd, dev); });
+}
+
+/*
+ * Asynchronous description(): a cached description is returned at once, a fetched one is cached when decoded.
+ */
+std::future<std::string> TcpClient::descriptionAsync(const std::string& subcmd, const std::string& dev, const std::string& name)
+{
+	std::string desc;
+	const std::string key = subcmd + " " + dev + " " + name;
+	if(_metadata && _metadata->getText(key, desc))
+	{
+		return readyAsync(desc);
+	}
+	std::shared_ptr<internal::MetadataCache> metadata = _metadata;
+	return queryAsync<std::string>("GET " + key, [key, metadata](const std::vector<std::string>& lines)
+	{
+		std::string desc = parseGet(key, lines[0])[0];
+		if(metadata)
+		{
+			metadata->putText(key, desc);
+		}
+		return desc;
+	}, [this, subcmd, dev, name]() { return description(subcmd, dev, name); });
+}
+
+/*
+ * Rejects a variable or command name missing from the cached names of the device, as upsd would.
+ */
+void TcpClient::checkName(const std::string& subcmd, const std::string& dev, const std::string& name)
+{
+	bool known;
+	if(_metadata && _metadata->knows(subcmd + " " + dev, name, known) && !known)
+	{
+		throw NutException(subcmd + "-NOT-SUPPORTED");
+	}
 }
 
 std::vector<std::string> TcpClient::get
@@ -578,9 +1519,13 @@ std::vector<std::string> TcpClient::get
 	{
 		req += " " + params;
 	}
-	std::string res = sendQuery("GET " + req);
+	return idempotent<std::vector<std::string> >([this, &req]() { return parseGet(req, sendQuery("GET " + req)); });
+}
+
+std::vector<std::string> TcpClient::parseGet(const std::string& req, const LineView& res)
+{
 	detectError(res);
-	if(res.substr(0, req.size()) != req)
+	if(!res.startsWith(req))
 	{
 		throw NutException("Invalid response");
 	}
@@ -596,67 +1541,382 @@ std::vector<std::vector<std::string> > TcpClient::list
 	{
 		req += " " + params;
 	}
-	std::vector<std::string> query;
-	query.push_back("LIST " + req);
-	sendAsyncQueries(query);
-	return parseList(req);
+	return idempotent<std::vector<std::vector<std::string> > >([this, &req]()
+	{
+		std::vector<std::string> query;
+		query.push_back("LIST " + req);
+		if(_pipeline)
+		{
+			std::vector<std::vector<std::string> > replies;
+			_pipeline->execute(query, replies);
+			return parseList(req, replies[0]);
+		}
+		sendAsyncQueries(query);
+		return parseList(req);
+	});
+}
+
+void TcpClient::list(const std::string& subcmd, const std::string& params, ListTable& table)
+{
+	std::string& query = table._query;
+	query.assign("LIST ");
+	query += subcmd;
+	if(!params.empty())
+	{
+		query += ' ';
+		query += params;
+	}
+	LineView req = LineView(query).substr(5);
+	// As idempotent(), whose std::function would allocate.
+	for(int attempt = 0; ; ++attempt)
+	{
+		try
+		{
+			if(_pipeline)
+			{
+				std::vector<std::vector<std::string> > replies;
+				_pipeline->execute(std::vector<std::string>(1, query), replies);
+				parseList(req, replies[0], table);
+				return;
+			}
+			drainAsync();
+			if(_resilient && !_socket->isConnected())
+			{
+				reconnect();
+			}
+			_socket->write(query);
+			parseList(req, table);
+			return;
+		}
+		catch(IOException&)
+		{
+			if(attempt > 0 || !recover())
+			{
+				throw;
+			}
+		}
+	}
 }
 
 std::vector<std::vector<std::string> > TcpClient::parseList
 	(const std::string& req)
 {
-	std::string res = _socket->read();
+	std::vector<std::vector<std::string> > arr;
+	forEachListRow(req, nullptr, [&arr, &req](const LineView& res)
+	{
+		arr.push_back(explode(res, req.size()));
+	});
+	return arr;
+}
+
+std::vector<std::vector<std::string> > TcpClient::parseList
+	(const std::string& req, const std::vector<std::string>& lines)
+{
+	std::vector<std::vector<std::string> > arr;
+	arr.reserve(lines.size() > 2 ? lines.size() - 2 : 0);
+	forEachListRow(req, lines, [&arr, &req](const LineView& res)
+	{
+		arr.push_back(explode(res, req.size()));
+	});
+	return arr;
+}
+
+/*
+ * Tests if line is marker followed by req ("BEGIN LIST VAR ups"...), without building the expected line.
+ */
+static bool isListMarker(const LineView& line, const char* marker, const LineView& req)
+{
+	size_t size = strlen(marker);
+	return line.size() == size + req.size() && line.startsWith(marker, size)
+		&& memcmp(line.data() + size, req.data(), req.size()) == 0;
+}
+
+void TcpClient::parseList(const LineView& req, ListTable& table)
+{
+	table.clear();
+	forEachListRow(req, nullptr, [&table, &req](const LineView& res)
+	{
+		appendListRow(table, res, req.size());
+	});
+}
+
+void TcpClient::parseList(const LineView& req, const std::vector<std::string>& lines, ListTable& table)
+{
+	table.clear();
+	forEachListRow(req, lines, [&table, &req](const LineView& res)
+	{
+		appendListRow(table, res, req.size());
+	});
+}
+
+void TcpClient::forEachListRow
+	(const LineView& req, const std::vector<std::string>* lines, const std::function<void(const LineView&)>& row)
+{
+	if(lines)
+	{
+		forEachListRow(req, *lines, row);
+		return;
+	}
+
+	LineView res = _socket->readLine();
 	detectError(res);
-	if(res != ("BEGIN LIST " + req))
+	if(!isListMarker(res, "BEGIN LIST ", req))
 	{
 		throw NutException("Invalid response");
 	}
 
-	std::vector<std::vector<std::string> > arr;
 	while(true)
 	{
-		res = _socket->read();
+		res = _socket->readLine();
+		detectError(res);
+		if(isListMarker(res, "END LIST ", req))
+		{
+			return;
+		}
+		if(res.startsWith(req.data(), req.size()))
+		{
+			row(res);
+		}
+		else
+		{
+			throw NutException("Invalid response");
+		}
+	}
+}
+
+void TcpClient::forEachListRow
+	(const LineView& req, const std::vector<std::string>& lines, const std::function<void(const LineView&)>& row)
+{
+	if(lines.empty())
+	{
+		throw NutException("Invalid response");
+	}
+	detectError(lines.front());
+	if(!isListMarker(lines.front(), "BEGIN LIST ", req) || !isListMarker(lines.back(), "END LIST ", req))
+	{
+		throw NutException("Invalid response");
+	}
+
+	for(size_t n = 1; n + 1 < lines.size(); ++n)
+	{
+		LineView res(lines[n]);
 		detectError(res);
-		if(res == ("END LIST " + req))
+		if(!res.startsWith(req.data(), req.size()))
+		{
+			throw NutException("Invalid response");
+		}
+		row(res);
+	}
+}
+
+LineView TcpClient::sendQuery(const std::string& req)
+{
+	if(_pipeline)
+	{
+		// The reply stays valid until the next query of the calling thread.
+		static thread_local std::string reply;
+		std::vector<std::vector<std::string> > replies;
+		_pipeline->execute(std::vector<std::string>(1, req), replies);
+		reply.swap(replies[0][0]);
+		return LineView(reply);
+	}
+	drainAsync();
+	if(_resilient && !_socket->isConnected())
+	{
+		// The connection was lost by an earlier query.
+		reconnect();
+	}
+	_socket->write(req);
+	return _socket->readLine();
+}
+
+void TcpClient::sendAsyncQueries(const std::vector<std::string>& req)
+{
+	if(!_pipeline)
+	{
+		drainAsync();
+		if(_resilient && !_socket->isConnected())
+		{
+			reconnect();
+		}
+	}
+	_socket->writeLines(req);
+}
+
+void TcpClient::detectError(const LineView& req)
+{
+	if(req.startsWith("ERR"))
+	{
+		throw NutException(req.substr(4).str());
+	}
+}
+
+namespace internal
+{
+
+/*
+ * Position of the first of the characters c1, c2, c3 in [pos, size), size if none.
+ * Scans 16 bytes at a time where SSE2 is available.
+ */
+static size_t findAny(const char* str, size_t pos, size_t size, char c1, char c2, char c3)
+{
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	const __m128i v1 = _mm_set1_epi8(c1), v2 = _mm_set1_epi8(c2), v3 = _mm_set1_epi8(c3);
+	for(; pos + 16 <= size; pos += 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + pos));
+		__m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, v1), _mm_cmpeq_epi8(block, v2)),
+			_mm_cmpeq_epi8(block, v3));
+		unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(found));
+		if(mask != 0)
+		{
+#ifdef _MSC_VER
+			unsigned long first;
+			_BitScanForward(&first, mask);
+			return pos + first;
+#else
+			return pos + __builtin_ctz(mask);
+#endif
+		}
+	}
+#endif
+	for(; pos < size; ++pos)
+	{
+		char c = str[pos];
+		if(c == c1 || c == c2 || c == c3)
+		{
+			return pos;
+		}
+	}
+	return size;
+}
+
+}/* namespace internal */
+
+namespace internal
+{
+
+/*
+ * Hands the tokens of str from pos to token(data, size) as long as they have no escape: they are found with
+ * a block scan for the delimiters. Returns the position of the first token with a backslash, to be left to
+ * TcpClient::explodeEscaped(), or the size of str.
+ */
+template<typename Token>
+static size_t scanTokens(const LineView& str, size_t pos, Token token)
+{
+	const char* data = str.data();
+	size_t size = str.size();
+	while(pos < size)
+	{
+		char c = data[pos];
+		if(c == ' ')
 		{
-			return arr;
+			++pos;
 		}
-		if(res.substr(0, req.size()) == req)
+		else if(c == '"')
 		{
-			arr.push_back(explode(res, req.size()));
+			size_t end = findAny(data, pos + 1, size, '"', '\\', '"');
+			if(end == size || data[end] == '\\')
+			{
+				return pos;
+			}
+			token(data + pos + 1, end - pos - 1);
+			pos = end + 1;
+		}
+		else if(c == '\\')
+		{
+			return pos;
 		}
 		else
 		{
-			throw NutException("Invalid response");
+			size_t end = findAny(data, pos, size, ' ', '"', '\\');
+			if(end < size && data[end] == '\\')
+			{
+				return pos;
+			}
+			token(data + pos, end - pos);
+			// A quote right after the token opens the next one.
+			pos = end;
 		}
 	}
+	return size;
 }
 
-std::string TcpClient::sendQuery(const std::string& req)
+}/* namespace internal */
+
+std::vector<std::string> TcpClient::explode(const LineView& str, size_t begin)
 {
-	_socket->write(req);
-	return _socket->read();
+	std::vector<std::string> res;
+	size_t pos = internal::scanTokens(str, begin, [&res](const char* data, size_t size)
+	{
+		res.emplace_back(data, size);
+	});
+	if(pos < str.size())
+	{
+		explodeEscaped(str, pos, res);
+	}
+	return res;
 }
 
-void TcpClient::sendAsyncQueries(const std::vector<std::string>& req)
+/*
+ * Appends a LIST row to a table, the tokens are copied straight from the line into the arena.
+ */
+void TcpClient::appendListRow(ListTable& table, const LineView& row, size_t begin)
 {
-	for (std::vector<std::string>::const_iterator it = req.cbegin(); it != req.cend(); ++it)
+	table.beginRow();
+	size_t pos = internal::scanTokens(row, begin, [&table](const char* data, size_t size)
 	{
-		_socket->write(*it);
+		table.append(data, size);
+	});
+	if(pos < row.size())
+	{
+		table._escaped.clear();
+		explodeEscaped(row, pos, table._escaped);
+		for(size_t n=0; n<table._escaped.size(); ++n)
+		{
+			table.append(table._escaped[n].data(), table._escaped[n].size());
+		}
 	}
 }
 
-void TcpClient::detectError(const std::string& req)
+/*
+ * Appends a LIST VAR row to a snapshot: the tokens go straight from the line into the snapshot, the first one
+ * interned as the name of the variable.
+ */
+void TcpClient::appendSnapshotRow(DeviceSnapshot& snapshot, const LineView& row, size_t begin)
 {
-	if(req.substr(0,3)=="ERR")
+	bool named = false;
+	auto token = [&snapshot, &named](const char* data, size_t size)
 	{
-		throw NutException(req.substr(4));
+		if(named)
+		{
+			snapshot.appendValue(data, size);
+		}
+		else
+		{
+			snapshot.beginVar(NameTable::intern(LineView(data, size)));
+			named = true;
+		}
+	};
+	size_t pos = internal::scanTokens(row, begin, token);
+	if(pos < row.size())
+	{
+		// Rows with escapes are rare: they go through the tokenizer and a scratch kept by the thread.
+		static thread_local std::vector<std::string> escaped;
+		escaped.clear();
+		explodeEscaped(row, pos, escaped);
+		for(size_t n=0; n<escaped.size(); ++n)
+		{
+			token(escaped[n].data(), escaped[n].size());
+		}
 	}
 }
 
-std::vector<std::string> TcpClient::explode(const std::string& str, size_t begin)
+/*
+ * Character by character tokenizer, handling the escapes. Appends the tokens of str from begin to res.
+ */
+void TcpClient::explodeEscaped(const LineView& str, size_t begin, std::vector<std::string>& res)
 {
-	std::vector<std::string> res;
 	std::string temp;
 
 	enum STATE {
@@ -761,8 +2021,6 @@ std::vector<std::string> TcpClient::explode(const std::string& str, size_t begin
 	{
 		res.push_back(temp);
 	}
-
-	return res;
 }
 
 std::string TcpClient::escape(const std::string& str)
@@ -786,7 +2044,11 @@ std::string TcpClient::escape(const std::string& str)
 
 TrackingID TcpClient::sendTrackingQuery(const std::string& req)
 {
-	std::string reply = sendQuery(req);
+	return parseTrackingID(sendQuery(req));
+}
+
+TrackingID TcpClient::parseTrackingID(const LineView& reply)
+{
 	detectError(reply);
 	std::vector<std::string> res = explode(reply);
 
@@ -804,6 +2066,403 @@ TrackingID TcpClient::sendTrackingQuery(const std::string& req)
 	}
 }
 
+/*
+ *
+ * NameTable implementation
+ *
+ */
+
+namespace internal
+{
+
+/*
+ * Storage of the interned names. The names live in chunks which never move, so the views handed out and the
+ * keys of the index stay valid; ids are resolved without locking through the chunk array.
+ */
+class Names
+{
+public:
+	static const size_t CHUNK_BITS = 10;
+	static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+	static const size_t MAX_CHUNKS = 4096;
+
+	Names():_size(0)
+	{
+		for(size_t n=0; n<MAX_CHUNKS; ++n)
+		{
+			_chunks[n] = nullptr;
+		}
+		// The standard names come first, their ids are their StandardName.
+		for(size_t n=0; n<STANDARD_NAME_COUNT; ++n)
+		{
+			intern(StandardNames::name(static_cast<StandardName>(n)));
+		}
+	}
+
+	NameId find(const LineView& name)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Index::const_iterator it = _ids.find(name);
+		return it == _ids.end() ? NameTable::npos : it->second;
+	}
+
+	NameId intern(const LineView& name)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Index::const_iterator it = _ids.find(name);
+		if(it != _ids.end())
+		{
+			return it->second;
+		}
+		if(_size == MAX_CHUNKS * CHUNK_SIZE)
+		{
+			throw NutException("Too many names");
+		}
+		NameId id = static_cast<NameId>(_size);
+		std::string* chunk = _chunks[id >> CHUNK_BITS];
+		if(chunk == nullptr)
+		{
+			chunk = new std::string[CHUNK_SIZE];
+			_chunks[id >> CHUNK_BITS] = chunk;
+		}
+		std::string& stored = chunk[id & (CHUNK_SIZE - 1)];
+		stored.assign(name.data(), name.size());
+		_ids[LineView(stored)] = id;
+		_size.store(_size + 1);
+		return id;
+	}
+
+	LineView name(NameId id)const
+	{
+		if(id >= _size.load())
+		{
+			throw NutException("Unknown name id");
+		}
+		return LineView(_chunks[id >> CHUNK_BITS].load()[id & (CHUNK_SIZE - 1)]);
+	}
+
+	size_t size()const
+	{
+		return _size.load();
+	}
+
+private:
+	struct Hash
+	{
+		size_t operator()(const LineView& s)const
+		{
+			// FNV-1a
+			size_t h = 2166136261u;
+			for(size_t n=0; n<s.size(); ++n)
+			{
+				h = (h ^ static_cast<unsigned char>(s[n])) * 16777619u;
+			}
+			return h;
+		}
+	};
+	struct Equal
+	{
+		bool operator()(const LineView& a, const LineView& b)const
+		{
+			return a.equals(b.data(), b.size());
+		}
+	};
+	typedef std::unordered_map<LineView, NameId, Hash, Equal> Index;
+
+	std::mutex _mutex;            /* Guards _ids and the interning */
+	Index _ids;
+	std::atomic<std::string*> _chunks[MAX_CHUNKS];
+	std::atomic<size_t> _size;
+};
+
+/* Never destroyed: the views handed out must outlive every static object. */
+static Names& names()
+{
+	static Names* table = new Names();
+	return *table;
+}
+
+}/* namespace internal */
+
+NameId NameTable::intern(const LineView& name)
+{
+	// The standard names are resolved without locking.
+	StandardName id = StandardNames::lookup(name);
+	return id != UNKNOWN_NAME ? static_cast<NameId>(id) : internal::names().intern(name);
+}
+
+NameId NameTable::find(const LineView& name)
+{
+	StandardName id = StandardNames::lookup(name);
+	return id != UNKNOWN_NAME ? static_cast<NameId>(id) : internal::names().find(name);
+}
+
+LineView NameTable::name(NameId id)
+{
+	return internal::names().name(id);
+}
+
+size_t NameTable::size()
+{
+	return internal::names().size();
+}
+
+/*
+ *
+ * DeviceSnapshot implementation
+ *
+ */
+
+DeviceSnapshot::DeviceSnapshot()
+{
+}
+
+DeviceSnapshot::DeviceSnapshot(const std::map<std::string,std::vector<std::string> >& variables)
+{
+	size_t bytes = 0, values = 0;
+	for(std::map<std::string,std::vector<std::string> >::const_iterator it=variables.begin(); it!=variables.end(); ++it)
+	{
+		values += it->second.size();
+		for(size_t n=0; n<it->second.size(); ++n)
+		{
+			bytes += it->second[n].size();
+		}
+	}
+	_data.reserve(bytes);
+	_vars.reserve(variables.size());
+	_values.reserve(values);
+	for(std::map<std::string,std::vector<std::string> >::const_iterator it=variables.begin(); it!=variables.end(); ++it)
+	{
+		beginVar(NameTable::intern(it->first));
+		for(size_t n=0; n<it->second.size(); ++n)
+		{
+			appendValue(it->second[n].data(), it->second[n].size());
+		}
+	}
+	seal();
+}
+
+size_t DeviceSnapshot::find(NameId id)const
+{
+	size_t low = 0, high = _vars.size();
+	while(low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+		if(_vars[mid].name < id)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low < _vars.size() && _vars[low].name == id ? low : npos;
+}
+
+size_t DeviceSnapshot::find(const LineView& name)const
+{
+	NameId id = NameTable::find(name);
+	return id == NameTable::npos ? npos : find(id);
+}
+
+LineView DeviceSnapshot::value(size_t idx, size_t n)const
+{
+	const Span& span = _values[_vars[idx].firstValue + n];
+	return LineView(_data.data() + span.offset, span.size);
+}
+
+bool DeviceSnapshot::sameValues(size_t idx, const DeviceSnapshot& other, size_t otherIdx)const
+{
+	if(valueCount(idx) != other.valueCount(otherIdx))
+	{
+		return false;
+	}
+	for(size_t n=0; n<valueCount(idx); ++n)
+	{
+		LineView a = value(idx, n), b = other.value(otherIdx, n);
+		if(!a.equals(b.data(), b.size()))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+std::vector<std::string> DeviceSnapshot::values(const LineView& name)const
+{
+	std::vector<std::string> res;
+	size_t idx = find(name);
+	if(idx != npos)
+	{
+		res.reserve(valueCount(idx));
+		for(size_t n=0; n<valueCount(idx); ++n)
+		{
+			res.push_back(value(idx, n).str());
+		}
+	}
+	return res;
+}
+
+bool DeviceSnapshot::getDouble(NameId id, double& res)const
+{
+	size_t idx = find(id);
+	return idx != npos && valueCount(idx) > 0 && ValueParser::parseDouble(value(idx), res);
+}
+
+bool DeviceSnapshot::getDouble(const LineView& name, double& res)const
+{
+	NameId id = NameTable::find(name);
+	return id != NameTable::npos && getDouble(id, res);
+}
+
+bool DeviceSnapshot::getInt(NameId id, int64_t& res)const
+{
+	size_t idx = find(id);
+	return idx != npos && valueCount(idx) > 0 && ValueParser::parseInt(value(idx), res);
+}
+
+bool DeviceSnapshot::getInt(const LineView& name, int64_t& res)const
+{
+	NameId id = NameTable::find(name);
+	return id != NameTable::npos && getInt(id, res);
+}
+
+unsigned int DeviceSnapshot::getStatusFlags()const
+{
+	size_t idx = find(static_cast<NameId>(VAR_UPS_STATUS));
+	return idx != npos && valueCount(idx) > 0 ? ValueParser::parseStatusFlags(value(idx)) : 0;
+}
+
+std::vector<double> DeviceSnapshot::numericValues()const
+{
+	std::vector<double> res(_vars.size(), std::numeric_limits<double>::quiet_NaN());
+	for(size_t idx=0; idx<_vars.size(); ++idx)
+	{
+		if(_vars[idx].valueCount > 0)
+		{
+			ValueParser::parseDouble(value(idx), res[idx]);
+		}
+	}
+	return res;
+}
+
+std::map<std::string,std::vector<std::string> > DeviceSnapshot::toMap()const
+{
+	std::map<std::string,std::vector<std::string> > map;
+	for(size_t idx=0; idx<_vars.size(); ++idx)
+	{
+		std::vector<std::string>& vals = map[name(idx).str()];
+		for(size_t n=0; n<valueCount(idx); ++n)
+		{
+			vals.push_back(value(idx, n).str());
+		}
+	}
+	return map;
+}
+
+size_t DeviceSnapshot::memoryUsage()const
+{
+	return sizeof(*this) + _data.capacity() + _vars.capacity() * sizeof(Var) + _values.capacity() * sizeof(Span);
+}
+
+void DeviceSnapshot::beginVar(NameId name)
+{
+	Var var;
+	var.name = name;
+	var.firstValue = static_cast<uint32_t>(_values.size());
+	var.valueCount = 0;
+	_vars.push_back(var);
+}
+
+void DeviceSnapshot::appendValue(const char* data, size_t size)
+{
+	Span span;
+	span.offset = static_cast<uint32_t>(_data.size());
+	span.size = static_cast<uint32_t>(size);
+	_data.append(data, size);
+	_values.push_back(span);
+	++_vars.back().valueCount;
+}
+
+void DeviceSnapshot::clear()
+{
+	_data.clear();
+	_vars.clear();
+	_values.clear();
+}
+
+/*
+ * Sorts the variables by name id and releases the spare capacity.
+ */
+void DeviceSnapshot::seal()
+{
+	std::sort(_vars.begin(), _vars.end(), [](const Var& a, const Var& b)
+	{
+		return a.name < b.name;
+	});
+	_data.shrink_to_fit();
+	_vars.shrink_to_fit();
+	_values.shrink_to_fit();
+}
+
+/*
+ *
+ * ListTable implementation
+ *
+ */
+
+ListTable::ListTable()
+{
+}
+
+LineView ListTable::cell(size_t row, size_t col)const
+{
+	const Span& span = _cells[_rows[row] + col];
+	return LineView(_data.data() + span.offset, span.size);
+}
+
+void ListTable::clear()
+{
+	_data.clear();
+	_cells.clear();
+	_rows.clear();
+}
+
+std::vector<std::vector<std::string> > ListTable::toRows()const
+{
+	std::vector<std::vector<std::string> > res(rows());
+	for(size_t row=0; row<rows(); ++row)
+	{
+		res[row].reserve(columns(row));
+		for(size_t col=0; col<columns(row); ++col)
+		{
+			res[row].push_back(cell(row, col).str());
+		}
+	}
+	return res;
+}
+
+size_t ListTable::memoryUsage()const
+{
+	return sizeof(*this) + _data.capacity() + _cells.capacity() * sizeof(Span) + _rows.capacity() * sizeof(uint32_t)
+		+ _query.capacity();
+}
+
+void ListTable::beginRow()
+{
+	_rows.push_back(static_cast<uint32_t>(_cells.size()));
+}
+
+void ListTable::append(const char* data, size_t size)
+{
+	Span span;
+	span.offset = static_cast<uint32_t>(_data.size());
+	span.size = static_cast<uint32_t>(size);
+	_data.append(data, size);
+	_cells.push_back(span);
+}
+
 /*
  *
  * Device implementation
@@ -1017,6 +2676,21 @@ int Device::getNumLogins()
 	return getClient()->deviceGetNumLogins(getName());
 }
 
+double Device::getDouble(const std::string& name)
+{
+	return internal::toDouble(getVariableValue(name), name);
+}
+
+int64_t Device::getInt(const std::string& name)
+{
+	return internal::toInt(getVariableValue(name), name);
+}
+
+unsigned int Device::getStatusFlags()
+{
+	return ValueParser::parseStatusFlags(internal::firstValue(getVariableValue("ups.status"), "ups.status"));
+}
+
 /*
  *
  * Variable implementation
@@ -1111,6 +2785,21 @@ void Variable::setValues(const std::vector<std::string>& values)
 	getDevice()->setVariable(getName(), values);
 }
 
+double Variable::getDouble()
+{
+	return internal::toDouble(getValue(), getName());
+}
+
+int64_t Variable::getInt()
+{
+	return internal::toInt(getValue(), getName());
+}
+
+unsigned int Variable::getStatusFlags()
+{
+	return ValueParser::parseStatusFlags(internal::firstValue(getValue(), getName()));
+}
+
 
 /*
  *
@@ -26,12 +26,16 @@
 #ifdef __cplusplus
 
 #include <string>
+#include <cstring>
 #include <vector>
 #include <map>
 #include <set>
 #include <exception>
 #include <functional>
 #include <memory>
+#include <future>
+#include <mutex>
+#include <stdint.h>
 
 /* See include/common.h for details behind this */
 #ifndef NUT_UNUSED_VARIABLE
@@ -57,6 +61,7 @@
 namespace nut
 {
 
+    class LineView;
     class LIB_API AbstractSocket;
     class LIB_API Client;
     class LIB_API TcpClient;
@@ -69,6 +74,18 @@ namespace nut
     class LIB_API UnknownHostException;
     class LIB_API NotConnectedException;
     class LIB_API TimeoutException;
+    class LIB_API AsyncClient;
+    class LIB_API ConnectionPool;
+    class LIB_API DeviceSnapshot;
+    class LIB_API ListTable;
+    class LIB_API NameTable;
+    class LIB_API ValueParser;
+
+    namespace internal
+    {
+        class Pipeline;
+        class MetadataCache;
+    }
 
     /*
      * If you are going to use your own AbstractSocket implementation, you should register a factory for it.
@@ -78,6 +95,37 @@ namespace nut
 
     LIB_API void registerSocketFactory(const std::function<std::shared_ptr<AbstractSocket>()> & factory);
 
+    /*
+     * Counters of the resolved address cache.
+     *     hits - connections served from the cache, including those that waited for a lookup of the same host
+     *     misses - lookups sent to the resolver
+     *     entries - host:port entries currently held
+     */
+    struct ResolverCacheStats {
+        unsigned long long hits;
+        unsigned long long misses;
+        size_t entries;
+    };
+
+    /*
+     * The default sockets (and the other transports built on them) keep the resolved addresses of each host:port
+     * for a while, so that many clients reconnecting at once do not flood the resolver. Concurrent lookups of the
+     * same host are merged into one. Unknown hosts are remembered too (negative caching).
+     * These functions are only available if the lib is built with the BUILD_WITH_DEFAULT_SOCKET option.
+     *     ttl - seconds resolved addresses are reused, 0 disables the cache (default 30)
+     *     negativeTtl - seconds an unknown host is remembered, 0 to not remember them (default 5)
+     */
+    LIB_API void setResolverCacheTtl(long ttl, long negativeTtl);
+    /*
+     * Forgets all the cached addresses, or those of host:port.
+     */
+    LIB_API void invalidateResolverCache();
+    LIB_API void invalidateResolverCache(const std::string & host, int port);
+    /*
+     * Returns the cache counters.
+     */
+    LIB_API ResolverCacheStats getResolverCacheStats();
+
 /**
  * Basic nut exception.
  */
@@ -147,6 +195,7 @@ public:
 
 /**
  * IO oriented nut exception when there is no response.
+ * The connection is closed, as the state of the protocol stream is unknown after it.
  */
 class TimeoutException : public IOException
 {
@@ -157,6 +206,78 @@ public:
 	virtual ~TimeoutException();
 };
 
+    /*
+     * LineView is a read-only view of a protocol line, usually pointing into the receive buffer of a socket.
+     * It does not own the data: a view returned by AbstractSocket::readLine() is valid until the next read
+     * from the same socket, a view built from a std::string is valid as long as the string is unchanged.
+     */
+    class LineView
+    {
+    public:
+        LineView():_data(""),_size(0){}
+        LineView(const char* data, size_t size):_data(data),_size(size){}
+        LineView(const std::string& s):_data(s.data()),_size(s.size()){}
+        LineView(const char* s):_data(s),_size(strlen(s)){}
+
+        const char* data()const{return _data;}
+        size_t size()const{return _size;}
+        bool empty()const{return _size==0;}
+        char operator[](size_t idx)const{return _data[idx];}
+
+        /*
+         * Returns the part of the line starting at pos (an empty view if pos is past the end).
+         */
+        LineView substr(size_t pos)const{return pos<_size ? LineView(_data+pos, _size-pos) : LineView();}
+        /*
+         * Returns true if the line begins with prefix.
+         */
+        bool startsWith(const char* prefix, size_t sz)const{return sz<=_size && memcmp(_data, prefix, sz)==0;}
+        bool startsWith(const std::string& prefix)const{return startsWith(prefix.data(), prefix.size());}
+        bool startsWith(const char* prefix)const{return startsWith(prefix, strlen(prefix));}
+
+        bool equals(const char* s, size_t sz)const{return sz==_size && memcmp(_data, s, sz)==0;}
+        bool operator==(const std::string& s)const{return equals(s.data(), s.size());}
+        bool operator==(const char* s)const{return equals(s, strlen(s));}
+        bool operator!=(const std::string& s)const{return !(*this==s);}
+        bool operator!=(const char* s)const{return !(*this==s);}
+
+        /*
+         * Returns an owning copy of the line.
+         */
+        std::string str()const{return std::string(_data, _size);}
+
+    private:
+        const char* _data;
+        size_t _size;
+    };
+
+    /*
+     * SocketOptions tunes the TCP sockets. The options are applied when the socket connects.
+     * Zero values keep the system default. Options the platform does not support are ignored.
+     */
+    struct SocketOptions
+    {
+        SocketOptions():noDelay(false),receiveBufferSize(0),sendBufferSize(0),keepAlive(false),
+                keepAliveIdle(0),keepAliveInterval(0),keepAliveCount(0),userTimeout(0){}
+
+        /* Disables the Nagle algorithm (TCP_NODELAY). Off by default, as the sockets always were; the queries
+         * of a batch are written in one call, so Nagle mostly delays the overlapping writes of a multiplexed
+         * client, which may turn it on. */
+        bool noDelay;
+        /* SO_RCVBUF and SO_SNDBUF, in bytes */
+        int receiveBufferSize;
+        int sendBufferSize;
+        /* SO_KEEPALIVE, and its idle time and probe interval in seconds (TCP_KEEPIDLE, TCP_KEEPINTVL),
+         * and the count of unanswered probes before the connection is dropped (TCP_KEEPCNT) */
+        bool keepAlive;
+        int keepAliveIdle;
+        int keepAliveInterval;
+        int keepAliveCount;
+        /* TCP_USER_TIMEOUT, in milliseconds: how long written data may stay unacknowledged before the
+         * connection is dropped. Linux only. */
+        unsigned int userTimeout;
+    };
+
     /*
      * AbstractSocket is the interface for TCP socket classes used by other classes in this library.
      * By default, the DefaultSocket internal implementation is used. You may want to replace the default
@@ -187,13 +308,30 @@ public:
          */
         virtual bool isConnected()const = 0;
         /*
-         * Don't touch this.
+         * Sets the timeout of the socket operations.
+         *     timeout - timeout in seconds, negative to block
+         *     The timeout bounds each whole operation: a connection, the read of a line or the write of a batch,
+         *     however many system calls it needs. An expired operation throws TimeoutException.
+         *     Override it if your implementation has to be notified, but call this base implementation.
+         */
+        virtual void setTimeout(long timeout){_timeout = timeout;}
+        /*
+         * Returns the timeout in seconds, negative if operations block.
+         */
+        long getTimeout()const{return _timeout;}
+        /*
+         * Returns true if a timeout is set.
+         */
+        bool hasTimeout()const{return _timeout >= 0;}
+        /*
+         * Sets the options of the TCP socket, used by the next connect().
+         *     Override it if your implementation supports them, and call this base implementation.
          */
-        void setTimeout(long timeout) {};
+        virtual void setOptions(const SocketOptions& options){_options = options;}
         /*
-         * Don't touch this.
+         * Returns the options of the TCP socket.
          */
-        bool hasTimeout()const{return false;}
+        const SocketOptions& getOptions()const{return _options;}
         /*
          * Reads data from a socket in the blocking mode.
          *     buf - buffer
@@ -217,12 +355,50 @@ public:
          * but the string returned should not contain it.
          */
         virtual std::string read() = 0;
+        /*
+         * Reads a line from the socket without copying it. The line returned does not contain the \n separator,
+         * and stays valid until the next read from this socket.
+         * The default implementation keeps a copy of the string returned by read(). Override it to return a view
+         * into the receive buffer of your implementation and save a heap allocation per protocol line.
+         */
+        virtual LineView readLine();
         /*
          * Writes a string to the socket. The NUT protocol separates the strings with \n symbol,
          * but the string s should not contain it.
          */
         virtual void write(const std::string & s) = 0;
+        /*
+         * Writes a batch of strings to the socket, each one followed by the \n separator.
+         * Used to pipeline several queries at once. The default implementation calls write(s) for each string,
+         * override it if your implementation can gather the whole batch into fewer system calls.
+         */
+        virtual void writeLines(const std::vector<std::string> & lines);
+        /*
+         * Stops the transfers in progress on the other threads, which fail at once, but keeps the socket
+         * open: disconnect() releases it once nobody uses it anymore. The default implementation does nothing,
+         * override it if your implementation supports a read and a write from two threads at the same time.
+         */
+        virtual void shutdown(){}
+        /*
+         * Sets whether a transport error or a timeout closes the connection, which is the default.
+         * A user sharing the socket between threads turns it off, and closes the connection itself once
+         * every thread is done with it.
+         */
+        void setDisconnectOnError(bool disconnect){_disconnectOnError = disconnect;}
+        /*
+         * Returns true if a transport error or a timeout closes the connection.
+         */
+        bool disconnectsOnError()const{return _disconnectOnError;}
         virtual ~AbstractSocket() = default;
+
+    protected:
+        AbstractSocket():_timeout(-1),_disconnectOnError(true){}
+
+    private:
+        long _timeout;
+        bool _disconnectOnError;
+        SocketOptions _options;
+        std::string _line; /* Line kept alive by the default readLine() implementation. */
     };
 
 /**
@@ -244,6 +420,54 @@ typedef enum
 
 typedef std::string Feature;
 
+/**
+ * Flags of the ups.status variable, as returned by ValueParser::parseStatusFlags().
+ */
+typedef enum
+{
+	STATUS_OL      = 1 << 0,   /**< On line */
+	STATUS_OB      = 1 << 1,   /**< On battery */
+	STATUS_LB      = 1 << 2,   /**< Low battery */
+	STATUS_HB      = 1 << 3,   /**< High battery */
+	STATUS_RB      = 1 << 4,   /**< Replace battery */
+	STATUS_CHRG    = 1 << 5,   /**< Charging */
+	STATUS_DISCHRG = 1 << 6,   /**< Discharging */
+	STATUS_BYPASS  = 1 << 7,   /**< On bypass */
+	STATUS_CAL     = 1 << 8,   /**< Calibrating */
+	STATUS_OFF     = 1 << 9,   /**< Output off */
+	STATUS_OVER    = 1 << 10,  /**< Overloaded */
+	STATUS_TRIM    = 1 << 11,  /**< Trimming the input voltage */
+	STATUS_BOOST   = 1 << 12,  /**< Boosting the input voltage */
+	STATUS_FSD     = 1 << 13,  /**< Forced shutdown */
+	STATUS_ALARM   = 1 << 14,  /**< Alarm, see ups.alarm */
+	STATUS_TEST    = 1 << 15,  /**< Testing */
+} StatusFlag;
+
+/**
+ * Conversion of variable values, which upsd sends as text.
+ * The parsing is locale independent (the decimal separator is always '.') and allocation free,
+ * like C++17 std::from_chars: the whole value must be a number, a leading '+' is rejected. Unlike
+ * from_chars, "inf", "nan" and hexadecimal values are rejected too.
+ */
+class ValueParser
+{
+public:
+	/**
+	 * Parse an integer value.
+	 * \return false if value is not an integer or overflows.
+	 */
+	static bool parseInt(const LineView& value, int64_t& res);
+	/**
+	 * Parse a decimal value ("230", "-12.5", "1.5e3").
+	 * \return false if value is not a number, or is out of the range of double.
+	 */
+	static bool parseDouble(const LineView& value, double& res);
+	/**
+	 * Parse a ups.status value ("OL CHRG"...) into a combination of StatusFlag, ignoring the unknown flags.
+	 */
+	static unsigned int parseStatusFlags(const LineView& value);
+};
+
 /**
  * A nut client is the starting point to dialog to NUTD.
  * It can connect to an NUTD then retrieve its device list.
@@ -440,18 +664,264 @@ public:
 	virtual bool isFeatureEnabled(const Feature& feature) = 0;
 	virtual void setFeature(const Feature& feature, bool status) = 0;
 
+	/**
+	 * Asynchronous queries.
+	 * Each method is the asynchronous counterpart of the method of the same name without the Async suffix,
+	 * the future returns its result or throws its exception.
+	 * The default implementations run the blocking method when the future is waited for. TcpClient sends
+	 * the query at once instead, and reads its reply when the future is waited for.
+	 * \{
+	 */
+	virtual std::future<std::set<std::string> > getDeviceNamesAsync();
+	virtual std::future<std::string> getDeviceDescriptionAsync(const std::string& name);
+	virtual std::future<std::set<std::string> > getDeviceVariableNamesAsync(const std::string& dev);
+	virtual std::future<std::set<std::string> > getDeviceRWVariableNamesAsync(const std::string& dev);
+	virtual std::future<std::string> getDeviceVariableDescriptionAsync(const std::string& dev, const std::string& name);
+	virtual std::future<std::vector<std::string> > getDeviceVariableValueAsync(const std::string& dev, const std::string& name);
+	virtual std::future<std::map<std::string,std::vector<std::string> > > getDeviceVariableValuesAsync(const std::string& dev);
+	virtual std::future<TrackingID> setDeviceVariableAsync(const std::string& dev, const std::string& name, const std::string& value);
+	virtual std::future<TrackingID> setDeviceVariableAsync(const std::string& dev, const std::string& name, const std::vector<std::string>& values);
+	virtual std::future<std::set<std::string> > getDeviceCommandNamesAsync(const std::string& dev);
+	virtual std::future<std::string> getDeviceCommandDescriptionAsync(const std::string& dev, const std::string& name);
+	virtual std::future<TrackingID> executeDeviceCommandAsync(const std::string& dev, const std::string& name, const std::string& param="");
+	virtual std::future<void> deviceLoginAsync(const std::string& dev);
+	virtual std::future<int> deviceGetNumLoginsAsync(const std::string& dev);
+	virtual std::future<TrackingResult> getTrackingResultAsync(const TrackingID& id);
+	/** \} */
+
 	static const Feature TRACKING;
 
 protected:
 	Client();
 };
 
+/**
+ * Reconnection policy of a resilient TcpClient.
+ * The first attempt is immediate. After n failed attempts (counted from 1), the delay before the next one
+ * is drawn uniformly between 0 and min(maxDelay, initialDelay * multiplier^(n-1)) milliseconds
+ * ("full jitter"), so that clients losing the same server do not reconnect in lockstep.
+ */
+struct ReconnectPolicy
+{
+	ReconnectPolicy():maxAttempts(5),initialDelay(100),maxDelay(30000),multiplier(2.0){}
+
+	/** Attempts before giving up and throwing the last error, negative for no limit. */
+	int maxAttempts;
+	/** Delay bounds, in milliseconds. */
+	long initialDelay;
+	long maxDelay;
+	/** Growth of the delay bound from one attempt to the next. */
+	double multiplier;
+};
+
+/**
+ * Settings of the metadata cache of a TcpClient.
+ */
+struct MetadataCacheOptions
+{
+	MetadataCacheOptions():ttl(300),maxBytes(1024*1024){}
+
+	/** Seconds an entry stays valid. */
+	long ttl;
+	/** Bound of the estimated memory used by the entries, in bytes. */
+	size_t maxBytes;
+};
+
+/**
+ * Statistics of the metadata cache of a TcpClient.
+ */
+struct MetadataCacheStats
+{
+	MetadataCacheStats():hits(0),misses(0),expirations(0),evictions(0),rejected(0),entries(0),bytes(0){}
+
+	size_t hits;
+	size_t misses;
+	/** Entries dropped because their TTL passed. */
+	size_t expirations;
+	/** Entries dropped to keep within maxBytes. */
+	size_t evictions;
+	/** Queries rejected without a round trip because the name is not in the cached names. */
+	size_t rejected;
+	/** Entries cached and their estimated memory size. */
+	size_t entries;
+	size_t bytes;
+};
+
+/**
+ * Process wide table of interned names (variable names...), mapping each name to a small integer id.
+ * Devices report the same few hundred names, interning them lets snapshots store and compare ids
+ * instead of strings. Ids are never reused, and the names they refer to stay valid until the process exits.
+ * All the methods are thread safe.
+ */
+class NameTable
+{
+public:
+	typedef uint32_t NameId;
+	static const NameId npos = static_cast<NameId>(-1);
+
+	/**
+	 * Retrieve the id of a name, interning it if needed.
+	 * Allocates only the first time a name is seen.
+	 */
+	static NameId intern(const LineView& name);
+	/**
+	 * Retrieve the id of a name without interning it.
+	 * \return Its id, or npos if it has never been interned.
+	 */
+	static NameId find(const LineView& name);
+	/**
+	 * Retrieve the name of an id returned by intern().
+	 */
+	static LineView name(NameId id);
+	/** Number of names interned. */
+	static size_t size();
+};
+
+typedef NameTable::NameId NameId;
+
+/**
+ * Immutable set of the variables of a device, as returned by LIST VAR.
+ * A compact alternative to std::map<std::string,std::vector<std::string> >: the variables are kept as
+ * interned name ids (see NameTable) sorted by id, with all the values in one buffer, so a snapshot costs
+ * three allocations whatever its size. Names and values are returned as views.
+ */
+class DeviceSnapshot
+{
+	friend class TcpClient;
+public:
+	static const size_t npos = static_cast<size_t>(-1);
+
+	DeviceSnapshot();
+	explicit DeviceSnapshot(const std::map<std::string,std::vector<std::string> >& variables);
+
+	/** Number of variables. */
+	size_t size()const{return _vars.size();}
+	bool empty()const{return _vars.empty();}
+
+	/**
+	 * Find a variable.
+	 * \return Its index, in name id order, or npos.
+	 */
+	size_t find(NameId id)const;
+	size_t find(const LineView& name)const;
+	bool contains(const LineView& name)const{return find(name)!=npos;}
+
+	/** Name id, name, number of values and values of the variable at index idx. */
+	NameId nameId(size_t idx)const{return _vars[idx].name;}
+	LineView name(size_t idx)const{return NameTable::name(_vars[idx].name);}
+	size_t valueCount(size_t idx)const{return _vars[idx].valueCount;}
+	LineView value(size_t idx, size_t n = 0)const;
+
+	/**
+	 * Test if the variable at index idx has the same values as the variable at index otherIdx of other.
+	 */
+	bool sameValues(size_t idx, const DeviceSnapshot& other, size_t otherIdx)const;
+
+	/**
+	 * Retrieve the values of a variable.
+	 * \return Its values, empty if the device does not have it.
+	 */
+	std::vector<std::string> values(const LineView& name)const;
+
+	/**
+	 * Retrieve the first value of a variable as a number (see ValueParser).
+	 * \return false if the device does not have the variable or if it is not a number.
+	 */
+	bool getDouble(NameId id, double& res)const;
+	bool getDouble(const LineView& name, double& res)const;
+	bool getInt(NameId id, int64_t& res)const;
+	bool getInt(const LineView& name, int64_t& res)const;
+	/**
+	 * Retrieve the ups.status flags, 0 if the device does not report them.
+	 */
+	unsigned int getStatusFlags()const;
+
+	/**
+	 * Convert the first value of all the variables to numbers in one pass.
+	 * \return The numbers, by variable index, NaN for the values that are not numbers.
+	 */
+	std::vector<double> numericValues()const;
+
+	/** Convert to the map returned by Client::getDeviceVariableValues(). */
+	std::map<std::string,std::vector<std::string> > toMap()const;
+
+	/** Estimated memory used, in bytes (the interned names are shared, not counted). */
+	size_t memoryUsage()const;
+
+private:
+	struct Span
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+	struct Var
+	{
+		NameId name;
+		uint32_t firstValue;  /* Index of its first value in _values */
+		uint32_t valueCount;
+	};
+
+	void beginVar(NameId name);
+	void appendValue(const char* data, size_t size);
+	void clear();
+	void seal();
+
+	std::string _data;          /* The values */
+	std::vector<Var> _vars;     /* Sorted by name id once sealed */
+	std::vector<Span> _values;
+};
+
+/**
+ * Rows of a LIST reply as a flat table: all the tokens are stored in one arena, indexed by a table of
+ * offsets. Clearing a table keeps its memory, so a table reused from poll to poll stops allocating once
+ * it has grown to the size of the replies. Cells are returned as views into the table.
+ */
+class ListTable
+{
+	friend class TcpClient;
+public:
+	ListTable();
+
+	/** Number of rows, and number of cells of a row. */
+	size_t rows()const{return _rows.size();}
+	size_t columns(size_t row)const{return (row + 1 < _rows.size() ? _rows[row + 1] : _cells.size()) - _rows[row];}
+	/** Cell col of row row. */
+	LineView cell(size_t row, size_t col)const;
+
+	/** Remove all the rows, keeping the memory. */
+	void clear();
+
+	/** Convert to the rows returned by list(). */
+	std::vector<std::vector<std::string> > toRows()const;
+
+	/** Estimated memory used, in bytes. */
+	size_t memoryUsage()const;
+
+private:
+	struct Span
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	void beginRow();
+	void append(const char* data, size_t size);
+
+	std::string _data;                 /* Arena of the cells */
+	std::vector<Span> _cells;
+	std::vector<uint32_t> _rows;       /* Index of the first cell of each row */
+	std::string _query;                /* Scratch of the query */
+	std::vector<std::string> _escaped; /* Scratch of the cells with escapes */
+};
+
 /**
  * TCP NUTD client.
  * It connect to NUTD with a TCP socket.
  */
 class TcpClient : public Client
 {
+	friend class AsyncClient;
+	friend class ConnectionPool;
 public:
 	/**
 	 * Construct a nut TcpClient object.
@@ -465,12 +935,20 @@ public:
 	 * \param port Server port.
 	 */
 	TcpClient(const std::string& host, int port = 3493);
+	/**
+	 * Construct a nut TcpClient object with socket options then connect it to the specified server.
+	 * \param host Server host name.
+	 * \param port Server port.
+	 * \param options Options of the TCP socket.
+	 */
+	TcpClient(const std::string& host, int port, const SocketOptions& options);
 	~TcpClient();
 
 	/**
 	 * Connect it to the specified server.
-	 * \param host Server host name.
-	 * \param port Server port.
+	 * \param host Server host name, or unix:/path/to/socket to connect to a server on this host through a
+	 * unix domain socket (with the default socket implementation, not under Windows).
+	 * \param port Server port, ignored for a unix domain socket.
 	 */
 	void connect(const std::string& host, int port = 3493);
 
@@ -502,6 +980,77 @@ public:
 	 */
 	long getTimeout()const;
 
+	/**
+	 * Set the options of the TCP socket, applied at the next connection.
+	 * \param options Socket options.
+	 */
+	void setSocketOptions(const SocketOptions& options);
+
+	/**
+	 * Retrieve the options of the TCP socket.
+	 * \returns Current socket options.
+	 */
+	SocketOptions getSocketOptions()const;
+
+	/**
+	 * Let several threads use this client at the same time.
+	 * In multiplexed mode, queries from concurrent threads are written as soon as they are issued, and the
+	 * replies, which the server sends in order, are matched back to their threads. Set it before sharing the
+	 * client between threads. It requires a socket supporting a concurrent read and write, as the default ones do.
+	 * \param multiplexed true to enable the multiplexed mode.
+	 */
+	void setMultiplexed(bool multiplexed);
+
+	/**
+	 * Test if the client is in multiplexed mode.
+	 * \return true if several threads can use it at the same time.
+	 */
+	bool isMultiplexed()const;
+
+	/**
+	 * Let the client recover from a lost connection, like a restart of upsd.
+	 * When a query fails with an IOException, the client reconnects following the policy, then replays the
+	 * session state: credentials, device logins, MASTER and features set. Idempotent queries (GET, LIST) are
+	 * then retried once, the others throw their IOException as they may have been executed.
+	 * The multiplexed mode does not reconnect: the queries of the other threads are in flight.
+	 * \param resilient true to enable the resilient mode.
+	 * \param policy Reconnection policy.
+	 */
+	void setResilient(bool resilient, const ReconnectPolicy& policy = ReconnectPolicy());
+
+	/**
+	 * Test if the client is in resilient mode.
+	 * \return true if the client reconnects by itself.
+	 */
+	bool isResilient()const;
+
+	/**
+	 * Reconnect following the reconnection policy and replay the session state.
+	 * Throws the error of the last attempt if all failed.
+	 */
+	void reconnect();
+
+	/**
+	 * Cache the replies which hardly ever change: the names of the variables, read/write variables and commands
+	 * of the devices, and their descriptions. Once the names of a device are cached, queries for a variable or
+	 * a command it does not have are rejected without a round trip (VAR-NOT-SUPPORTED, CMD-NOT-SUPPORTED).
+	 * \param enabled true to enable the cache, false to disable and drop it.
+	 * \param options TTL and memory bound of the cache.
+	 */
+	void setMetadataCache(bool enabled, const MetadataCacheOptions& options = MetadataCacheOptions());
+
+	/**
+	 * Drop the cached metadata of a device, after an update of its driver for instance.
+	 * \param dev Device name, empty to drop all.
+	 */
+	void invalidateMetadata(const std::string& dev = "");
+
+	/**
+	 * Retrieve the statistics of the metadata cache.
+	 * \return Hits, misses and size of the cache, zeros if it is disabled.
+	 */
+	MetadataCacheStats getMetadataCacheStats()const;
+
 	/**
 	 * Retriueve the host name of the server the client is connected to.
 	 * \return Server host name
@@ -529,6 +1078,18 @@ public:
 	virtual TrackingID setDeviceVariable(const std::string& dev, const std::string& name, const std::string& value);
 	virtual TrackingID setDeviceVariable(const std::string& dev, const std::string& name, const std::vector<std::string>& values);
 
+	/**
+	 * Retrieve the variables of devices as compact snapshots, see getDeviceVariableValues().
+	 */
+	DeviceSnapshot getDeviceVariableSnapshot(const std::string& dev);
+	std::map<std::string,DeviceSnapshot> getDevicesVariableSnapshots(const std::set<std::string>& devs);
+	/**
+	 * Retrieve the variables of a device into a table, one row per variable: its name then its values.
+	 * Reusing the same table, repeated calls do not allocate once it is large enough (except in multiplexed
+	 * mode and for values with escapes).
+	 */
+	void getDeviceVariableTable(const std::string& dev, ListTable& table);
+
 	virtual std::set<std::string> getDeviceCommandNames(const std::string& dev);
 	virtual std::string getDeviceCommandDescription(const std::string& dev, const std::string& name);
 	virtual TrackingID executeDeviceCommand(const std::string& dev, const std::string& name, const std::string& param="");
@@ -546,26 +1107,105 @@ public:
 	virtual bool isFeatureEnabled(const Feature& feature);
 	virtual void setFeature(const Feature& feature, bool status);
 
+	/**
+	 * Asynchronous queries, see Client.
+	 * The query is sent at once and pipelined with the other outstanding ones, its reply is read when the
+	 * future is waited for (the futures are deferred ones), so fanning out many queries costs about one
+	 * round trip. In multiplexed mode the queries go through the shared pipeline. Otherwise they are queued
+	 * on the connection, in order, and a blocking query first reads the replies they are owed; the client must
+	 * outlive their futures. In resilient mode, a read (GET, LIST) lost with the connection is sent again by
+	 * its blocking method when its future is waited for, which reconnects; other queries throw their error.
+	 * \{
+	 */
+	virtual std::future<std::set<std::string> > getDeviceNamesAsync();
+	virtual std::future<std::string> getDeviceDescriptionAsync(const std::string& name);
+	virtual std::future<std::set<std::string> > getDeviceVariableNamesAsync(const std::string& dev);
+	virtual std::future<std::set<std::string> > getDeviceRWVariableNamesAsync(const std::string& dev);
+	virtual std::future<std::string> getDeviceVariableDescriptionAsync(const std::string& dev, const std::string& name);
+	virtual std::future<std::vector<std::string> > getDeviceVariableValueAsync(const std::string& dev, const std::string& name);
+	virtual std::future<std::map<std::string,std::vector<std::string> > > getDeviceVariableValuesAsync(const std::string& dev);
+	virtual std::future<TrackingID> setDeviceVariableAsync(const std::string& dev, const std::string& name, const std::string& value);
+	virtual std::future<TrackingID> setDeviceVariableAsync(const std::string& dev, const std::string& name, const std::vector<std::string>& values);
+	virtual std::future<std::set<std::string> > getDeviceCommandNamesAsync(const std::string& dev);
+	virtual std::future<std::string> getDeviceCommandDescriptionAsync(const std::string& dev, const std::string& name);
+	virtual std::future<TrackingID> executeDeviceCommandAsync(const std::string& dev, const std::string& name, const std::string& param="");
+	virtual std::future<void> deviceLoginAsync(const std::string& dev);
+	virtual std::future<int> deviceGetNumLoginsAsync(const std::string& dev);
+	virtual std::future<TrackingResult> getTrackingResultAsync(const TrackingID& id);
+	/** \} */
+
 protected:
-	std::string sendQuery(const std::string& req);
+	LineView sendQuery(const std::string& req);
 	void sendAsyncQueries(const std::vector<std::string>& req);
-	static void detectError(const std::string& req);
+	static void detectError(const LineView& req);
 	TrackingID sendTrackingQuery(const std::string& req);
 
 	std::vector<std::string> get(const std::string& subcmd, const std::string& params = "");
 
 	std::vector<std::vector<std::string> > list(const std::string& subcmd, const std::string& params = "");
+	void list(const std::string& subcmd, const std::string& params, ListTable& table);
 
 	std::vector<std::vector<std::string> > parseList(const std::string& req);
-
-	static std::vector<std::string> explode(const std::string& str, size_t begin=0);
+	static std::vector<std::vector<std::string> > parseList(const std::string& req, const std::vector<std::string>& lines);
+	/*
+	 * Parse a LIST reply into a table, read from the socket or gathered in lines.
+	 */
+	void parseList(const LineView& req, ListTable& table);
+	static void parseList(const LineView& req, const std::vector<std::string>& lines, ListTable& table);
+	static void appendListRow(ListTable& table, const LineView& row, size_t begin);
+	/*
+	 * Check a LIST reply gathered in lines, or read from the socket if lines is null, and hands each of its
+	 * rows to row().
+	 */
+	void forEachListRow(const LineView& req, const std::vector<std::string>* lines, const std::function<void(const LineView&)>& row);
+	static void forEachListRow(const LineView& req, const std::vector<std::string>& lines, const std::function<void(const LineView&)>& row);
+	DeviceSnapshot parseSnapshot(const std::string& req, const std::vector<std::string>* lines);
+	static void appendSnapshotRow(DeviceSnapshot& snapshot, const LineView& row, size_t begin);
+	static std::vector<std::string> parseGet(const std::string& req, const LineView& res);
+	static TrackingID parseTrackingID(const LineView& res);
+	static TrackingResult parseTrackingResult(const LineView& res);
+	/*
+	 * Delay in milliseconds before a reconnection attempt, after failures failed ones (counted from 1), for a
+	 * uniform draw in [0, 1): see ReconnectPolicy.
+	 */
+	static long reconnectDelay(const ReconnectPolicy& policy, int failures, double uniform);
+
+	static std::vector<std::string> explode(const LineView& str, size_t begin=0);
+	static void explodeEscaped(const LineView& str, size_t begin, std::vector<std::string>& res);
 	static std::string escape(const std::string& str);
 
 private:
+	template<typename T> T idempotent(const std::function<T()>& query);
+	template<typename Map> Map listDevicesVariables(const std::set<std::string>& devs,
+		const std::function<void(Map&, const std::string&, const std::string&, const std::vector<std::string>*)>& add);
+	std::set<std::string> names(const std::string& subcmd, const std::string& dev);
+	std::string description(const std::string& subcmd, const std::string& dev, const std::string& name);
+	std::future<std::set<std::string> > namesAsync(const std::string& subcmd, const std::string& dev);
+	std::future<std::string> descriptionAsync(const std::string& subcmd, const std::string& dev, const std::string& name);
+	void checkName(const std::string& subcmd, const std::string& dev, const std::string& name);
+	template<typename T, typename Decode> std::future<T> queryAsync(const std::string& req, Decode decode,
+		const std::function<T()>& retry = std::function<T()>());
+	std::shared_ptr<internal::Pipeline> asyncPipeline();
+	void drainAsync();
+	bool recover();
+	void replaySession();
+
 	std::string _host;
 	int _port;
 	long _timeout;
 	std::shared_ptr<AbstractSocket> _socket;
+	std::shared_ptr<internal::Pipeline> _pipeline; /* Set in multiplexed mode */
+	/* Otherwise, carries the asynchronous queries until a blocking one needs the socket */
+	std::shared_ptr<internal::Pipeline> _asyncPipeline;
+	std::mutex _asyncMutex;
+	std::shared_ptr<internal::MetadataCache> _metadata; /* Set if the metadata cache is enabled */
+
+	/* Resilient mode, and the session state it replays */
+	bool _resilient;
+	ReconnectPolicy _reconnectPolicy;
+	std::string _user, _passwd;
+	std::set<std::string> _logins, _masters;
+	std::map<Feature, bool> _features;
 };
 
 /**
@@ -716,6 +1356,19 @@ public:
 	 */
 	int getNumLogins();
 
+	/**
+	 * Retrieve the value of a variable as a number (see ValueParser).
+	 * Throw NutException if the value is not a number.
+	 * \param name Variable name.
+	 */
+	double getDouble(const std::string& name);
+	int64_t getInt(const std::string& name);
+	/**
+	 * Retrieve the ups.status flags of the device.
+	 * \return Combination of StatusFlag.
+	 */
+	unsigned int getStatusFlags();
+
 protected:
 	Device(Client* client, const std::string& name);
 
@@ -800,6 +1453,18 @@ public:
 	 */
 	void setValues(const std::vector<std::string>& values);
 
+	/**
+	 * Intend to retrieve the variable value as a number (see ValueParser).
+	 * Throw NutException if the value is not a number.
+	 */
+	double getDouble();
+	int64_t getInt();
+	/**
+	 * Intend to retrieve the variable value as ups.status flags.
+	 * \return Combination of StatusFlag.
+	 */
+	unsigned int getStatusFlags();
+
 protected:
 	Variable(Device* dev, const std::string& name);
 
@@ -901,8 +1566,11 @@ extern "C" {
  * Array of string manipulation functions.
  * \{
  */
+#ifndef NUTCLIENT_STRARR_DEFINED
+#define NUTCLIENT_STRARR_DEFINED
 /** Array of string.*/
 typedef char** strarr;
+#endif /* NUTCLIENT_STRARR_DEFINED */
 /**
  * Alloc an array of string.
  */
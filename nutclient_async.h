@@ -0,0 +1,131 @@
+/*
+ * Non-blocking C API of the nutclient library, for C programs running their own event loop.
+ * Built with the reactor (NUTCLIENT_BUILD_WITH_REACTOR), Linux only. This header is valid C and C++.
+ */
+
+#ifndef NUTCLIENT_ASYNC_H_SEEN
+#define NUTCLIENT_ASYNC_H_SEEN
+
+#include <stddef.h>
+
+/* Begin of C nutclient asynchronous library declaration */
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifndef NUTCLIENT_STRARR_DEFINED
+#define NUTCLIENT_STRARR_DEFINED
+/** Array of string, as in nutclient.h. */
+typedef char** strarr;
+#endif /* NUTCLIENT_STRARR_DEFINED */
+/**
+ * Free an array of string.
+ */
+void strarr_free(strarr arr);
+
+/**
+ * Nut asynchronous client types and functions.
+ * The client never blocks: the queries take a completion callback, and the I/O is driven by the caller's
+ * event loop which watches nutclient_tcp_get_fd() and calls nutclient_process_events().
+ * All the functions and callbacks run on the thread of the event loop.
+ * \{
+ */
+/** Hidden structure representing an asynchronous connection to NUTD. */
+typedef void* NUTCLIENT_ASYNC_t;
+
+/** Error codes given to the completion callbacks. */
+typedef enum {
+	NUTCLIENT_OK = 0,                 /**< Success */
+	NUTCLIENT_ERR_PROTOCOL = 1,       /**< ERR reply or invalid reply of the server */
+	NUTCLIENT_ERR_IO = 2,             /**< Connection failure */
+	NUTCLIENT_ERR_UNKNOWN_HOST = 3,   /**< Host resolution failure */
+	NUTCLIENT_ERR_NOT_CONNECTED = 4,  /**< The client is not connected */
+	NUTCLIENT_ERR_TIMEOUT = 5,        /**< The connection or the reply timed out */
+	NUTCLIENT_ERR_OTHER = 6           /**< Any other failure */
+} NUTCLIENT_ERROR_t;
+
+/**
+ * Completion callbacks.
+ * \param userdata Pointer given with the query.
+ * \param error NUTCLIENT_OK or the error code.
+ * \param message Error message, valid during the call only. Empty on success.
+ * The results are null (-1 for an int) on error. Their ownership goes to the callback: a strarr must be
+ * freed with strarr_free(strarr), a string with free().
+ */
+typedef void (*nutclient_done_cb)(void* userdata, int error, const char* message);
+typedef void (*nutclient_string_cb)(void* userdata, int error, const char* message, char* value);
+typedef void (*nutclient_strarr_cb)(void* userdata, int error, const char* message, strarr values);
+typedef void (*nutclient_int_cb)(void* userdata, int error, const char* message, int value);
+
+/**
+ * Create an asynchronous client and start connecting to NUTD.
+ * \param host Host name to connect to.
+ * \param port Host port.
+ * \param cb Called once connected or once the connection failed, may be null.
+ * \param userdata Given to cb.
+ * \return New client, to be destroyed with nutclient_async_destroy(), or NULL on allocation failure.
+ * Host resolution is done at once, a failure is reported to cb before the function returns.
+ * Queries may be sent before the connection is established.
+ */
+NUTCLIENT_ASYNC_t nutclient_async_create_client(const char* host, unsigned short port, nutclient_done_cb cb, void* userdata);
+/**
+ * Destroy an asynchronous client. The callbacks of its pending queries are called with NUTCLIENT_ERR_NOT_CONNECTED.
+ * Must not be called from a callback of the same client.
+ */
+void nutclient_async_destroy(NUTCLIENT_ASYNC_t client);
+/**
+ * Set the timeout of the connection and of each reply.
+ * \param timeout Timeout in seconds, negative for none.
+ */
+void nutclient_async_set_timeout(NUTCLIENT_ASYNC_t client, long timeout);
+
+/**
+ * Retrieve the descriptor the event loop has to watch.
+ * \return The socket descriptor, -1 if not connected.
+ * The descriptor may change while connecting: query it again after each nutclient_process_events().
+ */
+int nutclient_tcp_get_fd(NUTCLIENT_ASYNC_t client);
+/**
+ * Test if the descriptor has to be watched for writability, besides readability.
+ * \return 1 if a connection is in progress or queries are not fully written, 0 otherwise.
+ */
+int nutclient_tcp_wants_write(NUTCLIENT_ASYNC_t client);
+/**
+ * Process the readiness events of the descriptor and fail what timed out, calling the completion callbacks.
+ * Call it when the descriptor is ready, and periodically (with 0, 0) for the timeouts to fire.
+ * \param readable Nonzero if the descriptor is readable (or in error).
+ * \param writable Nonzero if the descriptor is writable.
+ */
+void nutclient_process_events(NUTCLIENT_ASYNC_t client, int readable, int writable);
+
+/**
+ * Asynchronous counterparts of the blocking queries of the same name.
+ * \{
+ */
+void nutclient_authenticate_async(NUTCLIENT_ASYNC_t client, const char* login, const char* passwd, nutclient_done_cb cb, void* userdata);
+void nutclient_logout_async(NUTCLIENT_ASYNC_t client, nutclient_done_cb cb, void* userdata);
+void nutclient_device_login_async(NUTCLIENT_ASYNC_t client, const char* dev, nutclient_done_cb cb, void* userdata);
+void nutclient_device_master_async(NUTCLIENT_ASYNC_t client, const char* dev, nutclient_done_cb cb, void* userdata);
+void nutclient_device_forced_shutdown_async(NUTCLIENT_ASYNC_t client, const char* dev, nutclient_done_cb cb, void* userdata);
+void nutclient_get_device_num_logins_async(NUTCLIENT_ASYNC_t client, const char* dev, nutclient_int_cb cb, void* userdata);
+void nutclient_get_devices_async(NUTCLIENT_ASYNC_t client, nutclient_strarr_cb cb, void* userdata);
+void nutclient_get_device_description_async(NUTCLIENT_ASYNC_t client, const char* dev, nutclient_string_cb cb, void* userdata);
+void nutclient_get_device_variables_async(NUTCLIENT_ASYNC_t client, const char* dev, nutclient_strarr_cb cb, void* userdata);
+void nutclient_get_device_rw_variables_async(NUTCLIENT_ASYNC_t client, const char* dev, nutclient_strarr_cb cb, void* userdata);
+void nutclient_get_device_variable_description_async(NUTCLIENT_ASYNC_t client, const char* dev, const char* var, nutclient_string_cb cb, void* userdata);
+void nutclient_get_device_variable_values_async(NUTCLIENT_ASYNC_t client, const char* dev, const char* var, nutclient_strarr_cb cb, void* userdata);
+void nutclient_set_device_variable_value_async(NUTCLIENT_ASYNC_t client, const char* dev, const char* var, const char* value, nutclient_done_cb cb, void* userdata);
+void nutclient_set_device_variable_values_async(NUTCLIENT_ASYNC_t client, const char* dev, const char* var, const strarr values, nutclient_done_cb cb, void* userdata);
+void nutclient_get_device_commands_async(NUTCLIENT_ASYNC_t client, const char* dev, nutclient_strarr_cb cb, void* userdata);
+void nutclient_get_device_command_description_async(NUTCLIENT_ASYNC_t client, const char* dev, const char* cmd, nutclient_string_cb cb, void* userdata);
+void nutclient_execute_device_command_async(NUTCLIENT_ASYNC_t client, const char* dev, const char* cmd, const char* param, nutclient_done_cb cb, void* userdata);
+/** \} */
+
+/** \} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/* End of C nutclient asynchronous library declaration */
+
+#endif /* NUTCLIENT_ASYNC_H_SEEN */
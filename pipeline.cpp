@@ -0,0 +1,180 @@
+//
+// Request multiplexing over one connection, used by TcpClient in multiplexed mode and for its asynchronous queries.
+//
+
+#include "pipeline.h"
+
+namespace nut {
+    namespace internal {
+
+        Pipeline::Request::Request(const std::string & req) :
+                list(req.compare(0, 5, "LIST ") == 0),
+                end(list ? "END " + req : std::string()),
+                done(false) {
+        }
+
+        Pipeline::Pipeline(const std::shared_ptr<AbstractSocket> & socket) :
+                _socket(socket),
+                _reading(false),
+                _transfers(0),
+                _broken(false) {
+            // Closing the connection from one thread would pull the socket from under the other one.
+            _socket->setDisconnectOnError(false);
+        }
+
+        std::vector<Pipeline::Ticket> Pipeline::submit(const std::vector<std::string> & reqs) {
+            std::vector<Ticket> tickets;
+            tickets.reserve(reqs.size());
+            for (const std::string & req : reqs) {
+                tickets.push_back(std::make_shared<Request>(req));
+            }
+            if (tickets.empty()) {
+                return tickets;
+            }
+
+            std::lock_guard<std::mutex> sendLock(_sendMutex);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_broken) {
+                    // The connection is being closed, nothing will answer.
+                    std::exception_ptr error = std::make_exception_ptr(NotConnectedException());
+                    for (const Ticket & request : tickets) {
+                        request->error = error;
+                        request->done = true;
+                    }
+                    return tickets;
+                }
+                _pending.insert(_pending.end(), tickets.begin(), tickets.end());
+                ++_transfers;
+            }
+            try {
+                _socket->writeLines(reqs);
+            }
+            catch (...) {
+                // The stream is broken, and the requests queued after ours would wait forever.
+                std::lock_guard<std::mutex> lock(_mutex);
+                fail(std::current_exception());
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            leave();
+            return tickets;
+        }
+
+        void Pipeline::wait(const Ticket & ticket, std::vector<std::string> & lines) {
+            complete(*ticket);
+            if (ticket->error) {
+                std::rethrow_exception(ticket->error);
+            }
+            lines.swap(ticket->lines);
+        }
+
+        void Pipeline::execute(const std::vector<std::string> & reqs, std::vector<std::vector<std::string> > & replies) {
+            std::vector<Ticket> tickets = submit(reqs);
+            replies.resize(tickets.size());
+            for (size_t n = 0; n < tickets.size(); ++n) {
+                wait(tickets[n], replies[n]);
+            }
+        }
+
+        void Pipeline::drain() {
+            Ticket last;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_pending.empty()) {
+                    return;
+                }
+                last = _pending.back();
+            }
+            // The replies come in order: the others are complete once the last one is.
+            complete(*last);
+        }
+
+        /*
+         * Waits until a request is done, reading for the other threads meanwhile.
+         */
+        void Pipeline::complete(Request & request) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (!request.done) {
+                if (_reading) {
+                    _replied.wait(lock);
+                    continue;
+                }
+
+                // Read for everyone until our reply is complete.
+                _reading = true;
+                ++_transfers;
+                while (!request.done) {
+                    lock.unlock();
+                    try {
+                        LineView line = _socket->readLine();
+                        lock.lock();
+                        dispatch(line);
+                    }
+                    catch (...) {
+                        lock.lock();
+                        fail(std::current_exception());
+                    }
+                }
+                leave();
+                _reading = false;
+                _replied.notify_all();
+            }
+        }
+
+        /*
+         * Gives a line to the oldest pending request. The caller holds _mutex.
+         */
+        void Pipeline::dispatch(const LineView & line) {
+            if (_pending.empty()) {
+                return;  // Nothing was asked, nothing to match it with
+            }
+
+            Request & request = *_pending.front();
+            request.lines.push_back(line.str());
+            bool complete = !request.list || line == request.end ||
+                    (request.lines.size() == 1 && line.startsWith("ERR"));
+            if (complete) {
+                request.done = true;
+                _pending.pop_front();
+                _replied.notify_all();
+            }
+        }
+
+        /*
+         * Handles a transport error or a timeout. The caller holds _mutex.
+         * The first failure shuts the socket down, which stops the transfer of the other thread, and fails
+         * every pending request; the connection is closed by the last transfer leaving.
+         */
+        void Pipeline::fail(std::exception_ptr error) {
+            if (!_broken) {
+                _broken = true;
+                _socket->shutdown();
+            }
+            failAll(error);
+        }
+
+        /*
+         * Ends a read or a write on the socket, closes the connection if it failed and nobody else uses it.
+         * The caller holds _mutex.
+         */
+        void Pipeline::leave() {
+            if (--_transfers == 0 && _broken) {
+                _socket->disconnect();
+                _broken = false;
+            }
+        }
+
+        /*
+         * Fails every pending request. The caller holds _mutex.
+         */
+        void Pipeline::failAll(std::exception_ptr error) {
+            for (const Ticket & request : _pending) {
+                request->error = error;
+                request->done = true;
+            }
+            _pending.clear();
+            _replied.notify_all();
+        }
+
+    }
+}
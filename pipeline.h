@@ -0,0 +1,88 @@
+//
+// Request multiplexing over one connection, used by TcpClient in multiplexed mode and for its asynchronous queries.
+//
+
+#ifndef NUTCLIENT_PIPELINE_H
+#define NUTCLIENT_PIPELINE_H
+#include "nutclient.h"
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace nut {
+    namespace internal {
+
+        /*
+         * Pipeline lets many threads share one connection. NUT replies come in request order, so each
+         * thread writes its queries at once and queues them, and the replies are matched in FIFO order.
+         * There is no reader thread: one of the threads waiting for a reply reads for all of them, and hands
+         * over to another waiting thread once its own reply is complete.
+         * A LIST reply is gathered whole (BEGIN LIST to END LIST, or a single ERR line) before being returned,
+         * so a reply the caller fails to parse cannot leave lines behind it. A transport error or a timeout
+         * fails every pending query and shuts the socket down, so that the transfer of the other thread stops
+         * too; the connection is closed once both are over, the socket never closes it by itself meanwhile.
+         * The socket must accept a write and a read from two threads at the same time, as the default ones do.
+         */
+        class Pipeline {
+        public:
+            struct Request {
+                explicit Request(const std::string & req);
+
+                bool list;             /* LIST replies span several lines */
+                std::string end;       /* last line of a LIST reply */
+                std::vector<std::string> lines;
+                bool done;
+                std::exception_ptr error;
+            };
+            /* Handle of a query sent, to wait for its reply. */
+            typedef std::shared_ptr<Request> Ticket;
+
+            explicit Pipeline(const std::shared_ptr<AbstractSocket> & socket);
+
+            /*
+             * Sends the queries in one batch and returns their tickets, without waiting for the replies.
+             * The replies arriving before a ticket is waited for are kept in the ticket.
+             *     reqs - the queries, without the \n separator
+             */
+            std::vector<Ticket> submit(const std::vector<std::string> & reqs);
+            /*
+             * Waits for the reply of a query sent with submit(), reading for the other threads meanwhile.
+             *     lines - receives the lines of the reply
+             *  Throws the exception of the socket if the connection failed.
+             */
+            void wait(const Ticket & ticket, std::vector<std::string> & lines);
+            /*
+             * Sends the queries in one batch and waits for their replies.
+             *     reqs - the queries, without the \n separator
+             *     replies - receives the lines of each reply
+             *  Throws the exception of the socket if the connection failed.
+             */
+            void execute(const std::vector<std::string> & reqs, std::vector<std::vector<std::string> > & replies);
+            /*
+             * Reads the replies of all the queries sent, keeping them in their tickets, so that the socket can
+             * be used directly afterwards. A transport error is kept in the tickets too, it is not thrown.
+             */
+            void drain();
+
+        private:
+            void complete(Request & request);
+            void dispatch(const LineView & line);
+            void fail(std::exception_ptr error);
+            void failAll(std::exception_ptr error);
+            void leave();
+
+            std::shared_ptr<AbstractSocket> _socket;
+            std::mutex _sendMutex;           /* Keeps the queue in the order of the writes */
+            std::mutex _mutex;               /* Guards the fields below */
+            std::condition_variable _replied;
+            std::deque<Ticket> _pending;     /* Requests waiting for their reply, in sending order */
+            bool _reading;                   /* A thread is reading for all the others */
+            unsigned _transfers;             /* Threads reading or writing on the socket */
+            bool _broken;                    /* The connection failed, it is closed once the transfers are over */
+        };
+
+    }
+}
+
+#endif //NUTCLIENT_PIPELINE_H
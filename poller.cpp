@@ -0,0 +1,287 @@
+//
+// Polls devices and delivers the changes of their variables.
+//
+
+#include "poller.h"
+#include <algorithm>
+
+namespace nut {
+
+    DevicePoller::DevicePoller(TcpClient & client) :
+            _client(client),
+            _nextId(1),
+            _running(false),
+            _selfStopped(false),
+            _rescheduled(false) {
+    }
+
+    DevicePoller::~DevicePoller() {
+        stop();
+    }
+
+    DevicePoller::SubscriptionId DevicePoller::subscribe(const std::string & device, std::chrono::milliseconds interval,
+                                                         const DeltaHandler & handler) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Watched & dev = _devices[device];
+        Subscriber subscriber;
+        subscriber.id = _nextId++;
+        subscriber.interval = interval;
+        subscriber.handler = handler;
+        subscriber.primed = false;
+        dev.subscribers.push_back(subscriber);
+        // The new subscriber gets its first delta at the next poll.
+        dev.due = std::chrono::steady_clock::now();
+        _rescheduled = true;
+        _wakeup.notify_all();
+        return subscriber.id;
+    }
+
+    void DevicePoller::unsubscribe(SubscriptionId id) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (std::map<std::string, Watched>::iterator it = _devices.begin(); it != _devices.end(); ++it) {
+            std::vector<Subscriber> & subscribers = it->second.subscribers;
+            for (std::vector<Subscriber>::iterator sub = subscribers.begin(); sub != subscribers.end(); ++sub) {
+                if (sub->id == id) {
+                    subscribers.erase(sub);
+                    if (subscribers.empty()) {
+                        _devices.erase(it);
+                    }
+                    return;
+                }
+            }
+        }
+    }
+
+    void DevicePoller::setErrorHandler(const ErrorHandler & handler) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _onError = handler;
+    }
+
+    std::chrono::milliseconds DevicePoller::poll() {
+        std::lock_guard<std::mutex> pollLock(_pollMutex);
+
+        std::set<std::string> due;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            for (std::map<std::string, Watched>::const_iterator it = _devices.begin(); it != _devices.end(); ++it) {
+                if (it->second.due <= now) {
+                    due.insert(it->first);
+                }
+            }
+        }
+
+        if (!due.empty()) {
+            std::map<std::string, DeviceSnapshot> values;
+            std::exception_ptr error;
+            try {
+                values = _client.getDevicesVariableSnapshots(due);
+            }
+            catch (IOException &) {
+                error = std::current_exception();
+            }
+            catch (NutException &) {
+                // Every device replied ERR: each is reported below.
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+
+            // Handlers are called once the lock is released, they may subscribe or unsubscribe.
+            std::vector<std::pair<DeltaHandler, DeviceDelta> > deliveries;
+            std::vector<std::string> failed;
+            ErrorHandler onError;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                for (std::set<std::string>::const_iterator name = due.begin(); name != due.end(); ++name) {
+                    std::map<std::string, Watched>::iterator it = _devices.find(*name);
+                    if (it == _devices.end()) {
+                        // Unsubscribed meanwhile.
+                        continue;
+                    }
+                    Watched & dev = it->second;
+                    dev.due = now + interval(dev);
+
+                    std::map<std::string, DeviceSnapshot>::iterator polled = values.find(*name);
+                    if (polled == values.end()) {
+                        if (!error) {
+                            // Replied ERR (unknown device, stale data...) while the others replied.
+                            failed.push_back(*name);
+                        }
+                        continue;
+                    }
+                    DeviceDelta delta;
+                    delta.device = *name;
+                    diff(dev.snapshot, polled->second, delta.changes);
+                    DeviceDelta full;
+                    for (std::vector<Subscriber>::iterator sub = dev.subscribers.begin(); sub != dev.subscribers.end(); ++sub) {
+                        if (!sub->primed) {
+                            if (full.device.empty()) {
+                                full.device = *name;
+                                diff(DeviceSnapshot(), polled->second, full.changes);
+                            }
+                            deliveries.push_back(std::make_pair(sub->handler, full));
+                            sub->primed = true;
+                        }
+                        else if (!delta.changes.empty()) {
+                            deliveries.push_back(std::make_pair(sub->handler, delta));
+                        }
+                    }
+                    dev.snapshot = std::move(polled->second);
+                }
+                onError = _onError;
+            }
+
+            if (onError) {
+                if (error) {
+                    onError(error);
+                }
+                for (size_t n = 0; n < failed.size(); ++n) {
+                    onError(std::make_exception_ptr(NutException("Cannot poll device " + failed[n])));
+                }
+            }
+            for (size_t n = 0; n < deliveries.size(); ++n) {
+                deliveries[n].first(deliveries[n].second);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_devices.empty()) {
+            return std::chrono::milliseconds::max();
+        }
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+        for (std::map<std::string, Watched>::const_iterator it = _devices.begin(); it != _devices.end(); ++it) {
+            next = std::min(next, it->second.due);
+        }
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (next <= now) {
+            return std::chrono::milliseconds(0);
+        }
+        // Rounded up, so that the device is due when the caller wakes up.
+        return std::chrono::duration_cast<std::chrono::milliseconds>(next - now) + std::chrono::milliseconds(1);
+    }
+
+    void DevicePoller::start() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_running) {
+                return;
+            }
+            if (_threadId == std::this_thread::get_id()) {
+                // A handler restarting the poller it stopped: the thread goes on.
+                if (_selfStopped) {
+                    _running = true;
+                    _selfStopped = false;
+                }
+                return;
+            }
+            // A thread stopped by its handler can no longer be restarted by them, it is joined below.
+            _selfStopped = false;
+        }
+        std::lock_guard<std::mutex> threadLock(_threadMutex);
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_running) {
+            return;
+        }
+        _running = true;
+        _thread = std::thread(&DevicePoller::run, this);
+        _threadId = _thread.get_id();
+    }
+
+    void DevicePoller::stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_threadId == std::this_thread::get_id()) {
+                // Called by a handler: the thread ends after this poll, and is joined by start() or the destructor.
+                // Not resumable if another thread is already stopping it.
+                _selfStopped = _running;
+                _running = false;
+                return;
+            }
+            _running = false;
+            _selfStopped = false;
+            _wakeup.notify_all();
+        }
+        std::lock_guard<std::mutex> threadLock(_threadMutex);
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    DeviceSnapshot DevicePoller::snapshot(const std::string & device) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::map<std::string, Watched>::const_iterator it = _devices.find(device);
+        return it == _devices.end() ? DeviceSnapshot() : it->second.snapshot;
+    }
+
+    /*
+     * Appends the changes from before to after, both sorted by name id.
+     */
+    void DevicePoller::diff(const DeviceSnapshot & before, const DeviceSnapshot & after, std::vector<VariableChange> & changes) {
+        size_t b = 0, a = 0;
+        while (b < before.size() || a < after.size()) {
+            if (a == after.size() || (b < before.size() && before.nameId(b) < after.nameId(a))) {
+                changes.push_back(change(VariableChange::REMOVED, before, b++));
+            }
+            else if (b == before.size() || after.nameId(a) < before.nameId(b)) {
+                changes.push_back(change(VariableChange::ADDED, after, a++));
+            }
+            else {
+                if (!after.sameValues(a, before, b)) {
+                    changes.push_back(change(VariableChange::CHANGED, after, a));
+                }
+                ++a;
+                ++b;
+            }
+        }
+    }
+
+    /*
+     * Returns the change of the variable at idx in snapshot, with its values unless removed.
+     */
+    VariableChange DevicePoller::change(VariableChange::Kind kind, const DeviceSnapshot & snapshot, size_t idx) {
+        VariableChange res;
+        res.kind = kind;
+        res.id = snapshot.nameId(idx);
+        res.name = snapshot.name(idx).str();
+        if (kind != VariableChange::REMOVED) {
+            for (size_t n = 0; n < snapshot.valueCount(idx); ++n) {
+                res.value.push_back(snapshot.value(idx, n).str());
+            }
+        }
+        return res;
+    }
+
+    /*
+     * Returns the shortest interval of the subscribers of a device.
+     */
+    std::chrono::milliseconds DevicePoller::interval(const Watched & device) {
+        std::chrono::milliseconds res = std::chrono::milliseconds::max();
+        for (std::vector<Subscriber>::const_iterator sub = device.subscribers.begin(); sub != device.subscribers.end(); ++sub) {
+            res = std::min(res, sub->interval);
+        }
+        return res;
+    }
+
+    void DevicePoller::run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_running) {
+            _rescheduled = false;
+            lock.unlock();
+            std::chrono::milliseconds next = poll();
+            lock.lock();
+            if (next == std::chrono::milliseconds::max()) {
+                _wakeup.wait(lock, [this]() { return !_running || _rescheduled; });
+            }
+            else {
+                _wakeup.wait_for(lock, next, [this]() { return !_running || _rescheduled; });
+            }
+        }
+        _threadId = std::thread::id();
+    }
+
+}
@@ -0,0 +1,132 @@
+//
+// Polls devices and delivers the changes of their variables.
+//
+
+#ifndef NUTCLIENT_POLLER_H
+#define NUTCLIENT_POLLER_H
+#include "nutclient.h"
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+namespace nut {
+
+    class LIB_API DevicePoller;
+
+    /*
+     * Change of one variable between two polls.
+     */
+    struct VariableChange {
+        enum Kind {
+            ADDED,
+            CHANGED,
+            REMOVED
+        };
+
+        Kind kind;
+        NameId id;                       /* Interned name, see NameTable */
+        std::string name;
+        std::vector<std::string> value;  /* new value, empty if REMOVED */
+    };
+
+    /*
+     * Changes of the variables of a device. The first delta a subscriber receives lists every variable as ADDED.
+     */
+    struct DeviceDelta {
+        std::string device;
+        std::vector<VariableChange> changes;
+    };
+
+    /*
+     * DevicePoller polls the variables of the subscribed devices with LIST VAR, each device at the shortest
+     * interval of its subscribers, and hands each subscriber only the variables that changed since the
+     * previous poll. The devices due together are fetched in one pipelined batch
+     * (TcpClient::getDevicesVariableSnapshots()), and compared by interned name id.
+     * The polls run on a thread of the poller once start() is called, or on the caller's thread with poll().
+     * The client must not be used by anyone else meanwhile, unless it is in multiplexed mode.
+     * Handlers are called on the polling thread, without any lock held: they may subscribe, unsubscribe, stop
+     * and start the poller, but must not call poll(), which would wait for the poll in progress forever, nor
+     * destroy the poller.
+     * All the methods are thread safe.
+     */
+    class DevicePoller {
+    public:
+        typedef std::function<void(const DeviceDelta & delta)> DeltaHandler;
+        typedef std::function<void(std::exception_ptr error)> ErrorHandler;
+        typedef size_t SubscriptionId;
+
+        explicit DevicePoller(TcpClient & client);
+
+        ~DevicePoller();
+
+        /*
+         * Subscribes to the changes of a device, polled at most interval apart.
+         * Returns the id to unsubscribe with.
+         */
+        SubscriptionId subscribe(const std::string & device, std::chrono::milliseconds interval, const DeltaHandler & handler);
+        /*
+         * Cancels a subscription. The device is no longer polled once it has no subscriber.
+         * A poll in progress may still call the handler once.
+         */
+        void unsubscribe(SubscriptionId id);
+        /*
+         * Sets the handler of the errors of the polls. A lost connection is reported once; a device that
+         * replied ERR (unknown device, stale data...) is reported by a NutException naming it.
+         * The devices that failed keep their last snapshot and are polled again at their next interval.
+         */
+        void setErrorHandler(const ErrorHandler & handler);
+
+        /*
+         * Polls the devices that are due now, on the caller's thread.
+         * Returns the time until the next device is due, std::chrono::milliseconds::max() if none is subscribed.
+         */
+        std::chrono::milliseconds poll();
+        /*
+         * Starts and stops the polling thread. Stopped by a handler, the thread ends after the poll in progress.
+         */
+        void start();
+        void stop();
+
+        /*
+         * Returns the variables of a device as of its last poll, empty if it has not been polled yet.
+         */
+        DeviceSnapshot snapshot(const std::string & device) const;
+
+    private:
+        struct Subscriber {
+            SubscriptionId id;
+            std::chrono::milliseconds interval;
+            DeltaHandler handler;
+            bool primed;      /* Received its first delta */
+        };
+
+        struct Watched {
+            std::vector<Subscriber> subscribers;
+            std::chrono::steady_clock::time_point due;
+            DeviceSnapshot snapshot;
+        };
+
+        static void diff(const DeviceSnapshot & before, const DeviceSnapshot & after, std::vector<VariableChange> & changes);
+        static VariableChange change(VariableChange::Kind kind, const DeviceSnapshot & snapshot, size_t idx);
+        static std::chrono::milliseconds interval(const Watched & device);
+        void run();
+
+        TcpClient & _client;
+        std::mutex _pollMutex;             /* Serializes the polls, the client is used by one of them at a time */
+        mutable std::mutex _mutex;         /* Guards the fields below */
+        std::condition_variable _wakeup;
+        std::map<std::string, Watched> _devices;
+        SubscriptionId _nextId;
+        ErrorHandler _onError;
+        bool _running;
+        bool _selfStopped;                 /* stop() was called by a handler, start() from a handler resumes */
+        bool _rescheduled;                 /* A device became due earlier than the polling thread expects */
+        std::thread::id _threadId;         /* Polling thread, until it ends */
+        std::mutex _threadMutex;           /* Serializes the start and join of _thread by other threads */
+        std::thread _thread;
+    };
+
+}
+
+#endif //NUTCLIENT_POLLER_H
@@ -0,0 +1,1117 @@
+//
+// Event driven, non blocking transport: many NUTD connections served by one thread.
+//
+
+#include "reactor.h"
+#include "nutclient_async.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <cstring>
+#include <new>
+
+namespace nut {
+
+    /* Period of the reply deadline checks */
+    static const int TIMEOUT_CHECK_MS = 100;
+    /* Events fetched by one epoll_wait() call */
+    static const int MAX_EVENTS = 256;
+
+    /*
+     *
+     * NonBlockingSocket implementation
+     *
+     */
+
+    NonBlockingSocket::Query::Query(const std::string & req, const ReplyHandler & handler, long timeout) :
+            list(req.compare(0, 5, "LIST ") == 0),
+            end(list ? "END " + req : std::string()),
+            handler(handler),
+            reply(),
+            deadline(timeout) {
+    }
+
+    NonBlockingSocket::NonBlockingSocket() :
+            _sock(INVALID_SOCKET),
+            _state(DISCONNECTED),
+            _outPos(0),
+            _nextEndpoint(0),
+            _connectDeadline(-1),
+            _reactor(nullptr),
+            _registeredFd(INVALID_SOCKET),
+            _registeredEvents(0) {
+    }
+
+    NonBlockingSocket::~NonBlockingSocket() {
+        closeSocket();
+    }
+
+    void NonBlockingSocket::connect(const std::string & host, int port) {
+        internal::Deadline deadline(getTimeout());
+        disconnect();
+        _sock = internal::openConnection(host, port, deadline, getOptions());
+        _state = CONNECTED;
+        notifyReactor();
+    }
+
+    void NonBlockingSocket::disconnect() {
+        fail(std::make_exception_ptr(nut::NotConnectedException()));
+    }
+
+    bool NonBlockingSocket::isConnected() const {
+        return _state == CONNECTED;
+    }
+
+    size_t NonBlockingSocket::read(void * buf, size_t sz) {
+        if (!isConnected()) {
+            throw nut::NotConnectedException();
+        }
+
+        internal::Deadline deadline(getTimeout());
+        while (true) {
+            ssize_t res = ::recv(_sock, buf, sz, 0);
+            if (res >= 0) {
+                return static_cast<size_t>(res);
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                waitReady(false, deadline);
+            } else if (errno != EINTR) {
+                disconnect();
+                throw nut::IOException("Error while reading from socket");
+            }
+        }
+    }
+
+    size_t NonBlockingSocket::write(const void * buf, size_t sz) {
+        if (!isConnected()) {
+            throw nut::NotConnectedException();
+        }
+
+        internal::Deadline deadline(getTimeout());
+        while (true) {
+            ssize_t res = ::send(_sock, buf, sz, MSG_NOSIGNAL);
+            if (res >= 0) {
+                return static_cast<size_t>(res);
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                waitReady(true, deadline);
+            } else if (errno != EINTR) {
+                disconnect();
+                throw nut::IOException("Error while writing on socket");
+            }
+        }
+    }
+
+    std::string NonBlockingSocket::read() {
+        return readLine().str();
+    }
+
+    LineView NonBlockingSocket::readLine() {
+        if (!isConnected()) {
+            throw nut::NotConnectedException();
+        }
+
+        const char * line;
+        size_t len;
+        internal::Deadline deadline(getTimeout());
+
+        while (!_in.nextLine(line, len)) {
+            size_t room;
+            char * dst = _in.prepare(room);
+            ssize_t res = ::recv(_sock, dst, room, 0);
+            if (res > 0) {
+                _in.commit(static_cast<size_t>(res));
+            } else if (res == 0) {
+                disconnect();
+                throw nut::IOException("Server closed connection unexpectedly");
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                waitReady(false, deadline);
+            } else if (errno != EINTR) {
+                disconnect();
+                throw nut::IOException("Error while reading from socket");
+            }
+        }
+        return LineView(line, len);
+    }
+
+    void NonBlockingSocket::write(const std::string & s) {
+        writeLines(std::vector<std::string>(1, s));
+    }
+
+    void NonBlockingSocket::writeLines(const std::vector<std::string> & lines) {
+        if (!isConnected()) {
+            throw nut::NotConnectedException();
+        }
+
+        for (size_t n = 0; n < lines.size(); ++n) {
+            _out.append(lines[n]);
+            _out.push_back('\n');
+        }
+
+        internal::Deadline deadline(getTimeout());
+        try {
+            while (!flush()) {
+                waitReady(true, deadline);
+            }
+        }
+        catch (nut::TimeoutException &) {
+            throw;
+        }
+        catch (...) {
+            disconnect();
+            throw;
+        }
+    }
+
+    void NonBlockingSocket::connect(const std::string & host, int port, const ConnectHandler & handler) {
+        if (_state != DISCONNECTED) {
+            disconnect();
+        }
+
+        _onConnect = handler;
+        _connectDeadline = internal::Deadline(getTimeout());
+        try {
+            _endpoints = internal::resolve(host, port, _connectDeadline);
+            _nextEndpoint = 0;
+            connectNext();
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+        notifyReactor();
+    }
+
+    void NonBlockingSocket::query(const std::string & req, const ReplyHandler & handler) {
+        if (_state == DISCONNECTED) {
+            // Nothing would ever write the query nor fail it.
+            std::vector<std::string> reply;
+            handler(reply, std::make_exception_ptr(NotConnectedException()));
+            return;
+        }
+        _queries.push_back(Query(req, handler, getTimeout()));
+        _out.append(req);
+        _out.push_back('\n');
+        notifyReactor();
+    }
+
+    size_t NonBlockingSocket::pending() const {
+        return _queries.size();
+    }
+
+    SOCKET NonBlockingSocket::fd() const {
+        return _sock;
+    }
+
+    bool NonBlockingSocket::wantsWrite() const {
+        return _state == CONNECTING || (_state == CONNECTED && _outPos < _out.size());
+    }
+
+    void NonBlockingSocket::handleEvents(bool readable, bool writable) {
+        try {
+            if (_state == CONNECTING && (readable || writable)) {
+                if (internal::connectSucceeded(_sock)) {
+                    _state = CONNECTED;
+                    _endpoints.clear();
+                    ConnectHandler handler;
+                    handler.swap(_onConnect);
+                    if (handler) {
+                        handler(nullptr);
+                    }
+                } else {
+                    closeSocket();
+                    connectNext();
+                }
+            }
+            if (_state == CONNECTED && readable) {
+                receive();
+            }
+            // Queries queued by the handlers go out without waiting for the next loop turn.
+            if (_state == CONNECTED && _outPos < _out.size()) {
+                flush();
+            }
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+        notifyReactor();
+    }
+
+    void NonBlockingSocket::checkTimeouts() {
+        bool expired = false;
+        if (_state == CONNECTING) {
+            expired = _connectDeadline.isSet() && _connectDeadline.remainingMs() == 0;
+        } else if (!_queries.empty()) {
+            // Replies come in order, the first query is the one to expire first.
+            const internal::Deadline & deadline = _queries.front().deadline;
+            expired = deadline.isSet() && deadline.remainingMs() == 0;
+        }
+        if (expired) {
+            fail(std::make_exception_ptr(nut::TimeoutException()));
+        }
+    }
+
+    /*
+     * Starts connecting to the next resolved address.
+     */
+    void NonBlockingSocket::connectNext() {
+        while (_nextEndpoint < _endpoints.size()) {
+            bool pending;
+            SOCKET sock = internal::startConnect(_endpoints[_nextEndpoint++], pending, getOptions());
+            if (sock != INVALID_SOCKET) {
+                // Even an immediate success is reported by the first writable event.
+                _sock = sock;
+                _state = CONNECTING;
+                return;
+            }
+        }
+        throw nut::IOException("Cannot connect to host");
+    }
+
+    /*
+     * Writes as much of the queued data as possible, returns true if everything has been written.
+     */
+    bool NonBlockingSocket::flush() {
+        while (_outPos < _out.size()) {
+            ssize_t res = ::send(_sock, _out.data() + _outPos, _out.size() - _outPos, MSG_NOSIGNAL);
+            if (res >= 0) {
+                _outPos += static_cast<size_t>(res);
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return false;
+            } else if (errno != EINTR) {
+                throw nut::IOException("Error while writing on socket");
+            }
+        }
+        _out.clear();
+        _outPos = 0;
+        return true;
+    }
+
+    /*
+     * Reads the available data and dispatches every complete line.
+     */
+    void NonBlockingSocket::receive() {
+        while (_state == CONNECTED) {
+            size_t room;
+            char * dst = _in.prepare(room);
+            ssize_t res = ::recv(_sock, dst, room, 0);
+            if (res > 0) {
+                _in.commit(static_cast<size_t>(res));
+                const char * line;
+                size_t len;
+                while (_state == CONNECTED && _in.nextLine(line, len)) {
+                    dispatch(LineView(line, len));
+                }
+                if (static_cast<size_t>(res) < room) {
+                    // Drained, the level triggered reactor reports what may arrive meanwhile.
+                    return;
+                }
+            } else if (res == 0) {
+                throw nut::IOException("Server closed connection unexpectedly");
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            } else if (errno != EINTR) {
+                throw nut::IOException("Error while reading from socket");
+            }
+        }
+    }
+
+    /*
+     * Appends a line to the reply of the oldest query, and completes it if the reply is whole.
+     */
+    void NonBlockingSocket::dispatch(const LineView & line) {
+        if (_queries.empty()) {
+            throw nut::NutException("Unexpected reply");
+        }
+
+        Query & query = _queries.front();
+        query.reply.push_back(line.str());
+        if (query.list && !(query.reply.size() == 1 && line.startsWith("ERR")) && line != query.end) {
+            return;
+        }
+
+        Query done(std::move(query));
+        _queries.pop_front();
+        done.handler(done.reply, nullptr);
+    }
+
+    /*
+     * Closes the connection and reports the error to every waiting handler.
+     */
+    void NonBlockingSocket::fail(std::exception_ptr error) {
+        closeSocket();
+        _state = DISCONNECTED;
+        _in.clear();
+        _out.clear();
+        _outPos = 0;
+        _endpoints.clear();
+
+        // Handlers may start over on this socket, so it must be in a clean state before they run.
+        ConnectHandler onConnect;
+        onConnect.swap(_onConnect);
+        std::deque<Query> queries;
+        queries.swap(_queries);
+        notifyReactor();
+
+        if (onConnect) {
+            onConnect(error);
+        }
+        for (std::deque<Query>::iterator it = queries.begin(); it != queries.end(); ++it) {
+            it->handler(it->reply, error);
+        }
+    }
+
+    void NonBlockingSocket::closeSocket() {
+        if (_sock != INVALID_SOCKET) {
+            // Unregister first, the descriptor number may be reused as soon as it is closed.
+            if (_reactor != nullptr) {
+                _reactor->unregister(*this);
+            }
+            ::close(_sock);
+            _sock = INVALID_SOCKET;
+        }
+    }
+
+    void NonBlockingSocket::waitReady(bool forWrite, const internal::Deadline & deadline) {
+        if (!internal::waitSocket(_sock, forWrite, deadline)) {
+            // Whatever answer comes later would be taken for the reply of the next query.
+            disconnect();
+            throw nut::TimeoutException();
+        }
+    }
+
+    void NonBlockingSocket::notifyReactor() {
+        if (_reactor != nullptr) {
+            _reactor->update(*this);
+        }
+    }
+
+    /*
+     *
+     * Reactor implementation
+     *
+     */
+
+    Reactor::Reactor() :
+            _epoll(epoll_create1(EPOLL_CLOEXEC)),
+            _wakeup(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+            _stopped(false),
+            _lastTimeoutCheck(std::chrono::steady_clock::now()) {
+        if (_epoll < 0 || _wakeup < 0) {
+            nut::SystemException error;
+            if (_epoll >= 0) {
+                ::close(_epoll);
+            }
+            if (_wakeup >= 0) {
+                ::close(_wakeup);
+            }
+            throw error;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakeup, &ev);
+    }
+
+    Reactor::~Reactor() {
+        for (auto it = _sockets.begin(); it != _sockets.end(); ++it) {
+            it->second->_reactor = nullptr;
+            it->second->_registeredFd = INVALID_SOCKET;
+            it->second->_registeredEvents = 0;
+        }
+        ::close(_wakeup);
+        ::close(_epoll);
+    }
+
+    void Reactor::add(const std::shared_ptr<NonBlockingSocket> & socket) {
+        _sockets[socket.get()] = socket;
+        socket->_reactor = this;
+        update(*socket);
+    }
+
+    void Reactor::remove(const std::shared_ptr<NonBlockingSocket> & socket) {
+        if (_sockets.erase(socket.get()) > 0) {
+            unregister(*socket);
+            socket->_reactor = nullptr;
+        }
+    }
+
+    size_t Reactor::size() const {
+        return _sockets.size();
+    }
+
+    void Reactor::post(const std::function<void()> & task) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.push_back(task);
+        }
+        uint64_t one = 1;
+        ssize_t res = ::write(_wakeup, &one, sizeof(one));
+        NUT_UNUSED_VARIABLE(res);
+    }
+
+    void Reactor::run() {
+        while (runOnce(-1)) {
+        }
+    }
+
+    bool Reactor::runOnce(int timeoutMs) {
+        if (_stopped) {
+            return false;
+        }
+
+        int wait = timeoutMs;
+        if (!_sockets.empty() && (wait < 0 || wait > TIMEOUT_CHECK_MS)) {
+            wait = TIMEOUT_CHECK_MS;
+        }
+
+        struct epoll_event events[MAX_EVENTS];
+        int count = epoll_wait(_epoll, events, MAX_EVENTS, wait);
+        if (count < 0) {
+            if (errno != EINTR) {
+                throw nut::SystemException();
+            }
+            count = 0;
+        }
+
+        bool wakeup = false;
+        for (int n = 0; n < count; ++n) {
+            if (events[n].data.ptr == nullptr) {
+                wakeup = true;
+                continue;
+            }
+            auto it = _sockets.find(static_cast<NonBlockingSocket *>(events[n].data.ptr));
+            if (it == _sockets.end()) {
+                // Removed by a handler of a previous event.
+                continue;
+            }
+            std::shared_ptr<NonBlockingSocket> socket = it->second;
+            uint32_t ev = events[n].events;
+            socket->handleEvents((ev & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0,
+                                 (ev & (EPOLLOUT | EPOLLHUP | EPOLLERR)) != 0);
+        }
+
+        if (wakeup) {
+            uint64_t value;
+            ssize_t res = ::read(_wakeup, &value, sizeof(value));
+            NUT_UNUSED_VARIABLE(res);
+            runTasks();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - _lastTimeoutCheck >= std::chrono::milliseconds(TIMEOUT_CHECK_MS)) {
+            _lastTimeoutCheck = now;
+            // Expired handlers may add or remove sockets.
+            std::vector<std::shared_ptr<NonBlockingSocket> > sockets;
+            sockets.reserve(_sockets.size());
+            for (auto it = _sockets.begin(); it != _sockets.end(); ++it) {
+                sockets.push_back(it->second);
+            }
+            for (size_t n = 0; n < sockets.size(); ++n) {
+                sockets[n]->checkTimeouts();
+            }
+        }
+
+        return !_stopped;
+    }
+
+    void Reactor::stop() {
+        _stopped = true;
+        uint64_t one = 1;
+        ssize_t res = ::write(_wakeup, &one, sizeof(one));
+        NUT_UNUSED_VARIABLE(res);
+    }
+
+    void Reactor::update(NonBlockingSocket & socket) {
+        uint32_t events = EPOLLIN;
+        if (socket.wantsWrite()) {
+            events |= EPOLLOUT;
+        }
+
+        if (socket._registeredFd != socket._sock) {
+            unregister(socket);
+            if (socket._sock != INVALID_SOCKET) {
+                struct epoll_event ev;
+                ev.events = events;
+                ev.data.ptr = &socket;
+                if (epoll_ctl(_epoll, EPOLL_CTL_ADD, socket._sock, &ev) < 0) {
+                    throw nut::SystemException();
+                }
+                socket._registeredFd = socket._sock;
+                socket._registeredEvents = events;
+            }
+        } else if (socket._sock != INVALID_SOCKET && socket._registeredEvents != events) {
+            struct epoll_event ev;
+            ev.events = events;
+            ev.data.ptr = &socket;
+            epoll_ctl(_epoll, EPOLL_CTL_MOD, socket._sock, &ev);
+            socket._registeredEvents = events;
+        }
+    }
+
+    void Reactor::unregister(NonBlockingSocket & socket) {
+        if (socket._registeredFd != INVALID_SOCKET) {
+            epoll_ctl(_epoll, EPOLL_CTL_DEL, socket._registeredFd, nullptr);
+            socket._registeredFd = INVALID_SOCKET;
+            socket._registeredEvents = 0;
+        }
+    }
+
+    void Reactor::runTasks() {
+        std::vector<std::function<void()> > tasks;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            tasks.swap(_tasks);
+        }
+        for (size_t n = 0; n < tasks.size(); ++n) {
+            tasks[n]();
+        }
+    }
+
+    /*
+     *
+     * AsyncClient implementation
+     *
+     */
+
+    AsyncClient::AsyncClient(Reactor & reactor) :
+            _reactor(&reactor),
+            _socket(new NonBlockingSocket()) {
+        _reactor->add(_socket);
+    }
+
+    AsyncClient::AsyncClient() :
+            _reactor(nullptr),
+            _socket(new NonBlockingSocket()) {
+    }
+
+    AsyncClient::~AsyncClient() {
+        // Pending handlers are told, rather than left waiting forever.
+        _socket->disconnect();
+        if (_reactor != nullptr) {
+            _reactor->remove(_socket);
+        }
+    }
+
+    void AsyncClient::connect(const std::string & host, int port, const DoneHandler & handler) {
+        _socket->connect(host, port, handler);
+    }
+
+    void AsyncClient::disconnect() {
+        _socket->disconnect();
+    }
+
+    bool AsyncClient::isConnected() const {
+        return _socket->isConnected();
+    }
+
+    void AsyncClient::setTimeout(long timeout) {
+        _socket->setTimeout(timeout);
+    }
+
+    void AsyncClient::authenticate(const std::string & user, const std::string & passwd, const DoneHandler & handler) {
+        // Both queries are pipelined, the first error is reported.
+        std::shared_ptr<std::exception_ptr> first(new std::exception_ptr());
+        simple("USERNAME " + user, [first](std::exception_ptr error) {
+            *first = error;
+        });
+        simple("PASSWORD " + passwd, [first, handler](std::exception_ptr error) {
+            handler(*first ? *first : error);
+        });
+    }
+
+    void AsyncClient::logout(const DoneHandler & handler) {
+        std::shared_ptr<NonBlockingSocket> socket = _socket;
+        simple("LOGOUT", [socket, handler](std::exception_ptr error) {
+            socket->disconnect();
+            handler(error);
+        });
+    }
+
+    void AsyncClient::getDeviceNames(const NamesHandler & handler) {
+        list("UPS", "", [handler](const std::vector<std::vector<std::string> > & rows, std::exception_ptr error) {
+            std::set<std::string> res;
+            for (size_t n = 0; n < rows.size(); ++n) {
+                if (!rows[n].empty() && !rows[n][0].empty()) {
+                    res.insert(rows[n][0]);
+                }
+            }
+            handler(res, error);
+        });
+    }
+
+    void AsyncClient::getDeviceDescription(const std::string & name, const StringHandler & handler) {
+        get("UPSDESC", name, [handler](const std::vector<std::string> & values, std::exception_ptr error) {
+            handler(values.empty() ? std::string() : values[0], error);
+        });
+    }
+
+    void AsyncClient::getDeviceVariableNames(const std::string & dev, const NamesHandler & handler) {
+        names("VAR", dev, handler);
+    }
+
+    void AsyncClient::getDeviceRWVariableNames(const std::string & dev, const NamesHandler & handler) {
+        names("RW", dev, handler);
+    }
+
+    void AsyncClient::getDeviceVariableDescription(const std::string & dev, const std::string & name, const StringHandler & handler) {
+        get("DESC", dev + " " + name, [handler](const std::vector<std::string> & values, std::exception_ptr error) {
+            handler(values.empty() ? std::string() : values[0], error);
+        });
+    }
+
+    void AsyncClient::getDeviceVariableValue(const std::string & dev, const std::string & name, const ValuesHandler & handler) {
+        get("VAR", dev + " " + name, handler);
+    }
+
+    void AsyncClient::getDeviceVariableValues(const std::string & dev, const VariablesHandler & handler) {
+        list("VAR", dev, [handler](const std::vector<std::vector<std::string> > & rows, std::exception_ptr error) {
+            std::map<std::string, std::vector<std::string> > res;
+            for (size_t n = 0; n < rows.size(); ++n) {
+                if (!rows[n].empty()) {
+                    res[rows[n][0]].assign(rows[n].begin() + 1, rows[n].end());
+                }
+            }
+            handler(res, error);
+        });
+    }
+
+    void AsyncClient::setDeviceVariable(const std::string & dev, const std::string & name, const std::string & value, const TrackingHandler & handler) {
+        tracking("SET VAR " + dev + " " + name + " " + TcpClient::escape(value), handler);
+    }
+
+    void AsyncClient::setDeviceVariable(const std::string & dev, const std::string & name, const std::vector<std::string> & values, const TrackingHandler & handler) {
+        std::string query = "SET VAR " + dev + " " + name;
+        for (size_t n = 0; n < values.size(); ++n) {
+            query += " " + TcpClient::escape(values[n]);
+        }
+        tracking(query, handler);
+    }
+
+    void AsyncClient::getDeviceCommandNames(const std::string & dev, const NamesHandler & handler) {
+        names("CMD", dev, handler);
+    }
+
+    void AsyncClient::getDeviceCommandDescription(const std::string & dev, const std::string & name, const StringHandler & handler) {
+        get("CMDDESC", dev + " " + name, [handler](const std::vector<std::string> & values, std::exception_ptr error) {
+            handler(values.empty() ? std::string() : values[0], error);
+        });
+    }
+
+    void AsyncClient::executeDeviceCommand(const std::string & dev, const std::string & name, const std::string & param, const TrackingHandler & handler) {
+        tracking("INSTCMD " + dev + " " + name + " " + param, handler);
+    }
+
+    void AsyncClient::deviceLogin(const std::string & dev, const DoneHandler & handler) {
+        simple("LOGIN " + dev, handler);
+    }
+
+    void AsyncClient::deviceMaster(const std::string & dev, const DoneHandler & handler) {
+        simple("MASTER " + dev, handler);
+    }
+
+    void AsyncClient::deviceForcedShutdown(const std::string & dev, const DoneHandler & handler) {
+        simple("FSD " + dev, handler);
+    }
+
+    void AsyncClient::deviceGetNumLogins(const std::string & dev, const IntHandler & handler) {
+        get("NUMLOGINS", dev, [handler](const std::vector<std::string> & values, std::exception_ptr error) {
+            int64_t logins = -1;
+            if (!error && (values.empty() || !ValueParser::parseInt(values[0], logins))) {
+                error = std::make_exception_ptr(NutException("Not an integer: NUMLOGINS"));
+            }
+            handler(error ? -1 : static_cast<int>(logins), error);
+        });
+    }
+
+    void AsyncClient::get(const std::string & subcmd, const std::string & params, const ValuesHandler & handler) {
+        std::string req = subcmd;
+        if (!params.empty()) {
+            req += " " + params;
+        }
+        _socket->query("GET " + req, [req, handler](std::vector<std::string> & reply, std::exception_ptr error) {
+            std::vector<std::string> values;
+            if (!error) {
+                try {
+                    values = decodeGet(req, reply);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            handler(values, error);
+        });
+    }
+
+    void AsyncClient::list(const std::string & subcmd, const std::string & params, const RowsHandler & handler) {
+        std::string req = subcmd;
+        if (!params.empty()) {
+            req += " " + params;
+        }
+        _socket->query("LIST " + req, [req, handler](std::vector<std::string> & reply, std::exception_ptr error) {
+            std::vector<std::vector<std::string> > rows;
+            if (!error) {
+                try {
+                    rows = decodeList(req, reply);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            handler(rows, error);
+        });
+    }
+
+    std::shared_ptr<NonBlockingSocket> AsyncClient::socket() const {
+        return _socket;
+    }
+
+    std::vector<std::string> AsyncClient::decodeGet(const std::string & req, const std::vector<std::string> & reply) {
+        LineView res(reply.front());
+        TcpClient::detectError(res);
+        if (!res.startsWith(req)) {
+            throw nut::NutException("Invalid response");
+        }
+        return TcpClient::explode(res, req.size());
+    }
+
+    std::vector<std::vector<std::string> > AsyncClient::decodeList(const std::string & req, const std::vector<std::string> & reply) {
+        LineView res(reply.front());
+        TcpClient::detectError(res);
+        if (res != "BEGIN LIST " + req) {
+            throw nut::NutException("Invalid response");
+        }
+
+        // The last line is the END LIST marker the reply has been framed on.
+        std::vector<std::vector<std::string> > rows;
+        for (size_t n = 1; n + 1 < reply.size(); ++n) {
+            LineView line(reply[n]);
+            TcpClient::detectError(line);
+            if (!line.startsWith(req)) {
+                throw nut::NutException("Invalid response");
+            }
+            rows.push_back(TcpClient::explode(line, req.size()));
+        }
+        return rows;
+    }
+
+    TrackingID AsyncClient::decodeTracking(const std::vector<std::string> & reply) {
+        LineView res(reply.front());
+        TcpClient::detectError(res);
+        std::vector<std::string> words = TcpClient::explode(res);
+
+        if (words.size() == 1 && words[0] == "OK") {
+            return TrackingID("");
+        } else if (words.size() == 3 && words[0] == "OK" && words[1] == "TRACKING") {
+            return TrackingID(words[2]);
+        } else {
+            throw nut::NutException("Unknown query result");
+        }
+    }
+
+    void AsyncClient::simple(const std::string & req, const DoneHandler & handler) {
+        _socket->query(req, [handler](std::vector<std::string> & reply, std::exception_ptr error) {
+            if (!error) {
+                try {
+                    TcpClient::detectError(LineView(reply.front()));
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            handler(error);
+        });
+    }
+
+    void AsyncClient::tracking(const std::string & req, const TrackingHandler & handler) {
+        _socket->query(req, [handler](std::vector<std::string> & reply, std::exception_ptr error) {
+            TrackingID id;
+            if (!error) {
+                try {
+                    id = decodeTracking(reply);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            handler(id, error);
+        });
+    }
+
+    void AsyncClient::names(const std::string & subcmd, const std::string & dev, const NamesHandler & handler) {
+        list(subcmd, dev, [handler](const std::vector<std::vector<std::string> > & rows, std::exception_ptr error) {
+            std::set<std::string> res;
+            for (size_t n = 0; n < rows.size(); ++n) {
+                if (!rows[n].empty()) {
+                    res.insert(rows[n][0]);
+                }
+            }
+            handler(res, error);
+        });
+    }
+
+}
+
+/*
+ *
+ * C asynchronous API implementation
+ *
+ */
+
+namespace {
+
+    /*
+     * Maps the exception a handler received to a C error code and message.
+     */
+    int errorCode(std::exception_ptr error, std::string & message) {
+        if (!error) {
+            return NUTCLIENT_OK;
+        }
+        try {
+            std::rethrow_exception(error);
+        }
+        catch (nut::TimeoutException & ex) {
+            message = ex.what();
+            return NUTCLIENT_ERR_TIMEOUT;
+        }
+        catch (nut::UnknownHostException & ex) {
+            message = ex.what();
+            return NUTCLIENT_ERR_UNKNOWN_HOST;
+        }
+        catch (nut::NotConnectedException & ex) {
+            message = ex.what();
+            return NUTCLIENT_ERR_NOT_CONNECTED;
+        }
+        catch (nut::IOException & ex) {
+            message = ex.what();
+            return NUTCLIENT_ERR_IO;
+        }
+        catch (nut::NutException & ex) {
+            message = ex.what();
+            return NUTCLIENT_ERR_PROTOCOL;
+        }
+        catch (std::exception & ex) {
+            message = ex.what();
+        }
+        catch (...) {
+            message = "Unknown error";
+        }
+        return NUTCLIENT_ERR_OTHER;
+    }
+
+    nut::AsyncClient::DoneHandler doneHandler(nutclient_done_cb cb, void * userdata) {
+        return [cb, userdata](std::exception_ptr error) {
+            if (cb) {
+                std::string message;
+                int code = errorCode(error, message);
+                cb(userdata, code, message.c_str());
+            }
+        };
+    }
+
+    nut::AsyncClient::TrackingHandler trackingHandler(nutclient_done_cb cb, void * userdata) {
+        nut::AsyncClient::DoneHandler done = doneHandler(cb, userdata);
+        return [done](const nut::TrackingID &, std::exception_ptr error) {
+            done(error);
+        };
+    }
+
+    nut::AsyncClient::StringHandler stringHandler(nutclient_string_cb cb, void * userdata) {
+        return [cb, userdata](const std::string & value, std::exception_ptr error) {
+            if (cb) {
+                std::string message;
+                int code = errorCode(error, message);
+                cb(userdata, code, message.c_str(), error ? nullptr : strdup(value.c_str()));
+            }
+        };
+    }
+
+    nut::AsyncClient::NamesHandler namesHandler(nutclient_strarr_cb cb, void * userdata) {
+        return [cb, userdata](const std::set<std::string> & names, std::exception_ptr error) {
+            if (cb) {
+                std::string message;
+                int code = errorCode(error, message);
+                cb(userdata, code, message.c_str(), error ? nullptr : stringset_to_strarr(names));
+            }
+        };
+    }
+
+    nut::AsyncClient::ValuesHandler valuesHandler(nutclient_strarr_cb cb, void * userdata) {
+        return [cb, userdata](const std::vector<std::string> & values, std::exception_ptr error) {
+            if (cb) {
+                std::string message;
+                int code = errorCode(error, message);
+                cb(userdata, code, message.c_str(), error ? nullptr : stringvector_to_strarr(values));
+            }
+        };
+    }
+
+    nut::AsyncClient::IntHandler intHandler(nutclient_int_cb cb, void * userdata) {
+        return [cb, userdata](int value, std::exception_ptr error) {
+            if (cb) {
+                std::string message;
+                int code = errorCode(error, message);
+                cb(userdata, code, message.c_str(), error ? -1 : value);
+            }
+        };
+    }
+
+    nut::AsyncClient * asyncClient(NUTCLIENT_ASYNC_t client) {
+        return static_cast<nut::AsyncClient *>(client);
+    }
+
+}
+
+NUTCLIENT_ASYNC_t nutclient_async_create_client(const char * host, unsigned short port, nutclient_done_cb cb, void * userdata) {
+    nut::AsyncClient * client = new(std::nothrow) nut::AsyncClient();
+    if (client == nullptr) {
+        return nullptr;
+    }
+    nut::AsyncClient::DoneHandler handler = doneHandler(cb, userdata);
+    try {
+        client->connect(host, port, handler);
+    }
+    catch (...) {
+        handler(std::current_exception());
+    }
+    return static_cast<NUTCLIENT_ASYNC_t>(client);
+}
+
+void nutclient_async_destroy(NUTCLIENT_ASYNC_t client) {
+    delete asyncClient(client);
+}
+
+void nutclient_async_set_timeout(NUTCLIENT_ASYNC_t client, long timeout) {
+    if (client) {
+        asyncClient(client)->setTimeout(timeout);
+    }
+}
+
+int nutclient_tcp_get_fd(NUTCLIENT_ASYNC_t client) {
+    if (client) {
+        SOCKET fd = asyncClient(client)->socket()->fd();
+        return fd == INVALID_SOCKET ? -1 : static_cast<int>(fd);
+    }
+    return -1;
+}
+
+int nutclient_tcp_wants_write(NUTCLIENT_ASYNC_t client) {
+    if (client) {
+        return asyncClient(client)->socket()->wantsWrite() ? 1 : 0;
+    }
+    return 0;
+}
+
+void nutclient_process_events(NUTCLIENT_ASYNC_t client, int readable, int writable) {
+    if (client) {
+        std::shared_ptr<nut::NonBlockingSocket> socket = asyncClient(client)->socket();
+        if (readable || writable) {
+            socket->handleEvents(readable != 0, writable != 0);
+        }
+        socket->checkTimeouts();
+    }
+}
+
+void nutclient_authenticate_async(NUTCLIENT_ASYNC_t client, const char * login, const char * passwd, nutclient_done_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->authenticate(login, passwd, doneHandler(cb, userdata));
+    }
+}
+
+void nutclient_logout_async(NUTCLIENT_ASYNC_t client, nutclient_done_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->logout(doneHandler(cb, userdata));
+    }
+}
+
+void nutclient_device_login_async(NUTCLIENT_ASYNC_t client, const char * dev, nutclient_done_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->deviceLogin(dev, doneHandler(cb, userdata));
+    }
+}
+
+void nutclient_device_master_async(NUTCLIENT_ASYNC_t client, const char * dev, nutclient_done_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->deviceMaster(dev, doneHandler(cb, userdata));
+    }
+}
+
+void nutclient_device_forced_shutdown_async(NUTCLIENT_ASYNC_t client, const char * dev, nutclient_done_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->deviceForcedShutdown(dev, doneHandler(cb, userdata));
+    }
+}
+
+void nutclient_get_device_num_logins_async(NUTCLIENT_ASYNC_t client, const char * dev, nutclient_int_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->deviceGetNumLogins(dev, intHandler(cb, userdata));
+    }
+}
+
+void nutclient_get_devices_async(NUTCLIENT_ASYNC_t client, nutclient_strarr_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->getDeviceNames(namesHandler(cb, userdata));
+    }
+}
+
+void nutclient_get_device_description_async(NUTCLIENT_ASYNC_t client, const char * dev, nutclient_string_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->getDeviceDescription(dev, stringHandler(cb, userdata));
+    }
+}
+
+void nutclient_get_device_variables_async(NUTCLIENT_ASYNC_t client, const char * dev, nutclient_strarr_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->getDeviceVariableNames(dev, namesHandler(cb, userdata));
+    }
+}
+
+void nutclient_get_device_rw_variables_async(NUTCLIENT_ASYNC_t client, const char * dev, nutclient_strarr_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->getDeviceRWVariableNames(dev, namesHandler(cb, userdata));
+    }
+}
+
+void nutclient_get_device_variable_description_async(NUTCLIENT_ASYNC_t client, const char * dev, const char * var, nutclient_string_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->getDeviceVariableDescription(dev, var, stringHandler(cb, userdata));
+    }
+}
+
+void nutclient_get_device_variable_values_async(NUTCLIENT_ASYNC_t client, const char * dev, const char * var, nutclient_strarr_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->getDeviceVariableValue(dev, var, valuesHandler(cb, userdata));
+    }
+}
+
+void nutclient_set_device_variable_value_async(NUTCLIENT_ASYNC_t client, const char * dev, const char * var, const char * value, nutclient_done_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->setDeviceVariable(dev, var, value, trackingHandler(cb, userdata));
+    }
+}
+
+void nutclient_set_device_variable_values_async(NUTCLIENT_ASYNC_t client, const char * dev, const char * var, const strarr values, nutclient_done_cb cb, void * userdata) {
+    if (client) {
+        std::vector<std::string> vals;
+        for (strarr pstr = values; pstr && *pstr; ++pstr) {
+            vals.push_back(std::string(*pstr));
+        }
+        asyncClient(client)->setDeviceVariable(dev, var, vals, trackingHandler(cb, userdata));
+    }
+}
+
+void nutclient_get_device_commands_async(NUTCLIENT_ASYNC_t client, const char * dev, nutclient_strarr_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->getDeviceCommandNames(dev, namesHandler(cb, userdata));
+    }
+}
+
+void nutclient_get_device_command_description_async(NUTCLIENT_ASYNC_t client, const char * dev, const char * cmd, nutclient_string_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->getDeviceCommandDescription(dev, cmd, stringHandler(cb, userdata));
+    }
+}
+
+void nutclient_execute_device_command_async(NUTCLIENT_ASYNC_t client, const char * dev, const char * cmd, const char * param, nutclient_done_cb cb, void * userdata) {
+    if (client) {
+        asyncClient(client)->executeDeviceCommand(dev, cmd, param ? param : "", trackingHandler(cb, userdata));
+    }
+}
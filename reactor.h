@@ -0,0 +1,298 @@
+//
+// Event driven, non blocking transport: many NUTD connections served by one thread.
+// Linux only (epoll).
+//
+
+#ifndef NUTCLIENT_REACTOR_H
+#define NUTCLIENT_REACTOR_H
+#include "nutclient.h"
+#include "defaultsocket.h"
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <unordered_map>
+#include <stdint.h>
+
+namespace nut {
+
+    class LIB_API NonBlockingSocket;
+    class LIB_API Reactor;
+    class LIB_API AsyncClient;
+
+    /*
+     * Completion handler of a query sent with NonBlockingSocket::query().
+     *     reply - the reply lines: every line from BEGIN LIST to END LIST for a LIST query, a single line otherwise.
+     *     error - null on success, otherwise the transport error (IOException, TimeoutException...) that aborted the query.
+     *     A protocol error (ERR ...) is a normal reply, decoding it is up to the handler.
+     */
+    typedef std::function<void(std::vector<std::string> & reply, std::exception_ptr error)> ReplyHandler;
+    /*
+     * Completion handler of NonBlockingSocket::connect(host, port, handler), error is null on success.
+     */
+    typedef std::function<void(std::exception_ptr error)> ConnectHandler;
+
+    /*
+     * NonBlockingSocket is an AbstractSocket whose descriptor never blocks.
+     * It can be used as a regular blocking socket (the blocking calls wait for readiness with poll()), or
+     * be driven by a Reactor: queries are then queued with query(), written in batches when the socket is
+     * writable, and their replies are matched in order and delivered to their handlers.
+     * Do not mix both uses while queries are in flight.
+     * The event driven methods must be called from the thread running the reactor (see Reactor::post()).
+     */
+    class NonBlockingSocket : public AbstractSocket {
+        friend class Reactor;
+
+    public:
+        NonBlockingSocket();
+
+        ~NonBlockingSocket();
+
+        /* Blocking use, as an AbstractSocket */
+
+        void connect(const std::string & host, int port) override;
+
+        void disconnect() override;
+
+        bool isConnected() const override;
+
+        size_t read(void * buf, size_t sz) override;
+
+        size_t write(const void * buf, size_t sz) override;
+
+        std::string read() override;
+
+        LineView readLine() override;
+
+        void write(const std::string & s) override;
+
+        void writeLines(const std::vector<std::string> & lines) override;
+
+        /* Event driven use */
+
+        /*
+         * Starts connecting, the handler is called once the connection is established or has failed.
+         * Host resolution is done at once, the connection itself completes on reactor events.
+         * The timeout set with setTimeout() bounds the connection.
+         */
+        void connect(const std::string & host, int port, const ConnectHandler & handler);
+        /*
+         * Queues a query. It may be called before the connection is established, queries are sent once it is.
+         *     req - the query, without the \n separator
+         *     handler - called when the whole reply has been received, or the query has failed
+         * If the socket is neither connected nor connecting, the handler fails at once with NotConnectedException.
+         * The timeout set with setTimeout() bounds the wait for each reply.
+         */
+        void query(const std::string & req, const ReplyHandler & handler);
+        /*
+         * Returns the number of queries waiting for their reply.
+         */
+        size_t pending() const;
+        /*
+         * Returns the socket descriptor, INVALID_SOCKET if not connected.
+         */
+        SOCKET fd() const;
+        /*
+         * Returns true if the socket has to be watched for writability:
+         * a connection is in progress or queued queries are not fully written.
+         */
+        bool wantsWrite() const;
+        /*
+         * Processes readiness events: finishes a connection, writes queued queries, reads and dispatches replies.
+         * The Reactor calls it, call it yourself if you run your own event loop.
+         */
+        void handleEvents(bool readable, bool writable);
+        /*
+         * Fails the pending connection or queries whose deadline passed.
+         * The Reactor calls it periodically.
+         */
+        void checkTimeouts();
+
+    private:
+        enum State {
+            DISCONNECTED,
+            CONNECTING,
+            CONNECTED
+        };
+
+        struct Query {
+            Query(const std::string & req, const ReplyHandler & handler, long timeout);
+
+            bool list;             /* LIST replies span several lines */
+            std::string end;       /* last line of a LIST reply */
+            ReplyHandler handler;
+            std::vector<std::string> reply;
+            internal::Deadline deadline;
+        };
+
+        void connectNext();
+        bool flush();
+        void receive();
+        void dispatch(const LineView & line);
+        void fail(std::exception_ptr error);
+        void closeSocket();
+        void waitReady(bool forWrite, const internal::Deadline & deadline);
+        void notifyReactor();
+
+        SOCKET _sock;
+        State _state;
+        internal::LineBuffer _in;     /* Received data not consumed yet. */
+        std::string _out;             /* Queued queries */
+        size_t _outPos;               /* Part of _out already written */
+        std::deque<Query> _queries;   /* Queries waiting for their reply, in sending order */
+
+        std::vector<internal::Endpoint> _endpoints; /* Addresses left to try while connecting */
+        size_t _nextEndpoint;
+        ConnectHandler _onConnect;
+        internal::Deadline _connectDeadline;
+
+        Reactor * _reactor;           /* Reactor driving the socket, if any */
+        SOCKET _registeredFd;         /* Descriptor as registered in the reactor */
+        uint32_t _registeredEvents;
+    };
+
+    /*
+     * Reactor runs an epoll loop driving NonBlockingSocket objects, so one thread can serve thousands of
+     * NUTD connections, each one with its own pipelined query queue.
+     * Only post() and stop() may be called from other threads than the one running the loop.
+     */
+    class Reactor {
+        friend class NonBlockingSocket;
+
+    public:
+        Reactor();
+
+        ~Reactor();
+
+        /*
+         * Starts driving a socket. The reactor keeps a reference to it until remove() is called.
+         */
+        void add(const std::shared_ptr<NonBlockingSocket> & socket);
+        /*
+         * Stops driving a socket, its pending queries are left untouched.
+         */
+        void remove(const std::shared_ptr<NonBlockingSocket> & socket);
+        /*
+         * Returns the number of sockets driven.
+         */
+        size_t size() const;
+        /*
+         * Queues a task to be run on the reactor thread. Thread safe.
+         */
+        void post(const std::function<void()> & task);
+        /*
+         * Runs the loop until stop() is called.
+         */
+        void run();
+        /*
+         * Waits for events at most timeoutMs milliseconds (negative to wait forever) and processes them.
+         * Returns false if the reactor has been stopped.
+         */
+        bool runOnce(int timeoutMs);
+        /*
+         * Makes run() return. Thread safe.
+         */
+        void stop();
+
+    private:
+        void update(NonBlockingSocket & socket);
+        void unregister(NonBlockingSocket & socket);
+        void runTasks();
+
+        int _epoll;
+        int _wakeup;                  /* eventfd signaled by post() and stop() */
+        std::atomic<bool> _stopped;
+        std::unordered_map<NonBlockingSocket *, std::shared_ptr<NonBlockingSocket> > _sockets;
+        std::mutex _mutex;            /* Guards _tasks */
+        std::vector<std::function<void()> > _tasks;
+        std::chrono::steady_clock::time_point _lastTimeoutCheck;
+    };
+
+    /*
+     * AsyncClient is the asynchronous counterpart of TcpClient for use with a Reactor.
+     * All its queries are pipelined on one NonBlockingSocket, and their decoded results are delivered to
+     * handlers on the reactor thread. A handler receives a null error on success, otherwise the exception
+     * that a TcpClient call would have thrown.
+     * Like the NonBlockingSocket, it must be used from the reactor thread.
+     */
+    class AsyncClient {
+    public:
+        typedef std::function<void(std::exception_ptr error)> DoneHandler;
+        typedef std::function<void(const std::string & value, std::exception_ptr error)> StringHandler;
+        typedef std::function<void(const std::set<std::string> & names, std::exception_ptr error)> NamesHandler;
+        typedef std::function<void(const std::vector<std::string> & values, std::exception_ptr error)> ValuesHandler;
+        typedef std::function<void(const std::map<std::string, std::vector<std::string> > & values, std::exception_ptr error)> VariablesHandler;
+        typedef std::function<void(const TrackingID & id, std::exception_ptr error)> TrackingHandler;
+        typedef std::function<void(int value, std::exception_ptr error)> IntHandler;
+        typedef std::function<void(const std::vector<std::vector<std::string> > & rows, std::exception_ptr error)> RowsHandler;
+
+        /*
+         * Creates a client whose socket is driven by the reactor.
+         */
+        explicit AsyncClient(Reactor & reactor);
+        /*
+         * Creates a client whose socket is driven by the caller's own event loop:
+         * watch socket()->fd() and call socket()->handleEvents() and socket()->checkTimeouts().
+         */
+        AsyncClient();
+
+        ~AsyncClient();
+
+        void connect(const std::string & host, int port, const DoneHandler & handler);
+        void disconnect();
+        bool isConnected() const;
+        /*
+         * Sets the timeout in seconds of the connection and of each reply, negative to wait forever.
+         */
+        void setTimeout(long timeout);
+
+        void authenticate(const std::string & user, const std::string & passwd, const DoneHandler & handler);
+        void logout(const DoneHandler & handler);
+
+        void getDeviceNames(const NamesHandler & handler);
+        void getDeviceDescription(const std::string & name, const StringHandler & handler);
+
+        void getDeviceVariableNames(const std::string & dev, const NamesHandler & handler);
+        void getDeviceRWVariableNames(const std::string & dev, const NamesHandler & handler);
+        void getDeviceVariableDescription(const std::string & dev, const std::string & name, const StringHandler & handler);
+        void getDeviceVariableValue(const std::string & dev, const std::string & name, const ValuesHandler & handler);
+        void getDeviceVariableValues(const std::string & dev, const VariablesHandler & handler);
+        void setDeviceVariable(const std::string & dev, const std::string & name, const std::string & value, const TrackingHandler & handler);
+        void setDeviceVariable(const std::string & dev, const std::string & name, const std::vector<std::string> & values, const TrackingHandler & handler);
+
+        void getDeviceCommandNames(const std::string & dev, const NamesHandler & handler);
+        void getDeviceCommandDescription(const std::string & dev, const std::string & name, const StringHandler & handler);
+        void executeDeviceCommand(const std::string & dev, const std::string & name, const std::string & param, const TrackingHandler & handler);
+
+        void deviceLogin(const std::string & dev, const DoneHandler & handler);
+        void deviceMaster(const std::string & dev, const DoneHandler & handler);
+        void deviceForcedShutdown(const std::string & dev, const DoneHandler & handler);
+        void deviceGetNumLogins(const std::string & dev, const IntHandler & handler);
+
+        /*
+         * Generic GET and LIST queries, as TcpClient::get() and TcpClient::list().
+         */
+        void get(const std::string & subcmd, const std::string & params, const ValuesHandler & handler);
+        void list(const std::string & subcmd, const std::string & params, const RowsHandler & handler);
+
+        /*
+         * Returns the underlying socket.
+         */
+        std::shared_ptr<NonBlockingSocket> socket() const;
+
+    private:
+        static std::vector<std::string> decodeGet(const std::string & req, const std::vector<std::string> & reply);
+        static std::vector<std::vector<std::string> > decodeList(const std::string & req, const std::vector<std::string> & reply);
+        static TrackingID decodeTracking(const std::vector<std::string> & reply);
+
+        void simple(const std::string & req, const DoneHandler & handler);
+        void tracking(const std::string & req, const TrackingHandler & handler);
+        void names(const std::string & subcmd, const std::string & dev, const NamesHandler & handler);
+
+        Reactor * _reactor;           /* Reactor driving the socket, null if driven by the caller */
+        std::shared_ptr<NonBlockingSocket> _socket;
+    };
+
+}
+
+#endif //NUTCLIENT_REACTOR_H
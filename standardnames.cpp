@@ -0,0 +1,233 @@
+//
+// Compile-time perfect hash table of the standard NUT variable and command names.
+//
+
+#include "standardnames.h"
+
+namespace nut {
+
+    namespace internal {
+
+        /*
+         * The table is a two level (FKS) perfect hash, built by constexpr functions:
+         * - the names are spread over as many buckets as there are names by their FNV-1a hash,
+         * - each bucket of k names owns a region of k * k slots, and a seed chosen so that its names land in
+         *   distinct slots of the region.
+         * The regions are disjoint, so the table is collision free with about two slots per name. It is written
+         * in C++11 constexpr: one return statement per function, recursions split in halves to stay shallow.
+         */
+
+        struct StandardNameString {
+            const char * str;
+            size_t size;
+        };
+
+        static constexpr StandardNameString STANDARD_NAMES[] = {
+#define NUTCLIENT_STANDARD_NAME_STRING(id, name) { name, sizeof(name) - 1 },
+            NUTCLIENT_STANDARD_VARIABLES(NUTCLIENT_STANDARD_NAME_STRING)
+            NUTCLIENT_STANDARD_COMMANDS(NUTCLIENT_STANDARD_NAME_STRING)
+#undef NUTCLIENT_STANDARD_NAME_STRING
+        };
+
+#define NUTCLIENT_STANDARD_NAME_ONE(id, name) + 1
+        static const size_t VARIABLES = 0 NUTCLIENT_STANDARD_VARIABLES(NUTCLIENT_STANDARD_NAME_ONE);
+#undef NUTCLIENT_STANDARD_NAME_ONE
+        static const size_t NAMES = STANDARD_NAME_COUNT;
+        static const size_t BUCKETS = NAMES;
+        static const size_t NONE = NAMES;
+        static const uint32_t MAX_SEED = 256;
+
+        static constexpr uint32_t fnv(const char * s, size_t n, uint32_t h = 2166136261u) {
+            return n == 0 ? h : fnv(s + 1, n - 1, (h ^ static_cast<unsigned char>(*s)) * 16777619u);
+        }
+
+        static constexpr uint32_t xorShift(uint32_t h, unsigned shift) {
+            return h ^ (h >> shift);
+        }
+        /* Murmur3 finalizer of the hash xored with the seed of its bucket. */
+        static constexpr uint32_t mix(uint32_t h, uint32_t seed) {
+            return xorShift(xorShift(xorShift(h ^ (seed * 0x9E3779B9u), 16) * 0x85EBCA6Bu, 13) * 0xC2B2AE35u, 16);
+        }
+
+        template<typename T, size_t N>
+        struct Table {
+            T v[N];
+            constexpr const T & operator[](size_t idx) const { return v[idx]; }
+        };
+
+        template<size_t... I>
+        struct Indices {
+        };
+        template<typename A, typename B>
+        struct Concat;
+        template<size_t... I, size_t... J>
+        struct Concat<Indices<I...>, Indices<J...> > {
+            typedef Indices<I..., (sizeof...(I) + J)...> type;
+        };
+        /* 0 .. N-1, built in halves: a linear recursion would exceed the template depth. */
+        template<size_t N>
+        struct MakeIndices {
+            typedef typename Concat<typename MakeIndices<N / 2>::type, typename MakeIndices<N - N / 2>::type>::type type;
+        };
+        template<>
+        struct MakeIndices<0> {
+            typedef Indices<> type;
+        };
+        template<>
+        struct MakeIndices<1> {
+            typedef Indices<0> type;
+        };
+
+        /* Hash of each name. */
+        template<size_t... I>
+        static constexpr Table<uint32_t, sizeof...(I)> makeHashes(Indices<I...>) {
+            return {{ fnv(STANDARD_NAMES[I].str, STANDARD_NAMES[I].size)... }};
+        }
+        static constexpr Table<uint32_t, NAMES> HASHES = makeHashes(MakeIndices<NAMES>::type());
+
+        static constexpr size_t bucketOf(size_t name) {
+            return HASHES[name] % BUCKETS;
+        }
+
+        static constexpr size_t firstIn(size_t b, size_t lo, size_t hi);
+        static constexpr size_t firstOr(size_t first, size_t b, size_t lo, size_t hi) {
+            return first != NONE ? first : firstIn(b, lo, hi);
+        }
+        /* First name of bucket b in [lo, hi), NONE if none. */
+        static constexpr size_t firstIn(size_t b, size_t lo, size_t hi) {
+            return lo >= hi ? NONE
+                : hi - lo == 1 ? (bucketOf(lo) == b ? lo : NONE)
+                : firstOr(firstIn(b, lo, lo + (hi - lo) / 2), b, lo + (hi - lo) / 2, hi);
+        }
+
+        /* The names of a bucket are chained: FIRST[b], NEXT[FIRST[b]]... */
+        template<size_t... I>
+        static constexpr Table<size_t, sizeof...(I)> makeFirst(Indices<I...>) {
+            return {{ firstIn(I, 0, NAMES)... }};
+        }
+        static constexpr Table<size_t, BUCKETS> FIRST = makeFirst(MakeIndices<BUCKETS>::type());
+
+        template<size_t... I>
+        static constexpr Table<size_t, sizeof...(I)> makeNext(Indices<I...>) {
+            return {{ firstIn(bucketOf(I), I + 1, NAMES)... }};
+        }
+        static constexpr Table<size_t, NAMES> NEXT = makeNext(MakeIndices<NAMES>::type());
+
+        static constexpr size_t chainLength(size_t name) {
+            return name == NONE ? 0 : 1 + chainLength(NEXT[name]);
+        }
+
+        /* Size of the region of each bucket. */
+        template<size_t... I>
+        static constexpr Table<size_t, sizeof...(I)> makeRegions(Indices<I...>) {
+            return {{ (chainLength(FIRST[I]) * chainLength(FIRST[I]))... }};
+        }
+        static constexpr Table<size_t, BUCKETS> REGIONS = makeRegions(MakeIndices<BUCKETS>::type());
+
+        static constexpr size_t regionsIn(size_t lo, size_t hi) {
+            return lo >= hi ? 0
+                : hi - lo == 1 ? REGIONS[lo]
+                : regionsIn(lo, lo + (hi - lo) / 2) + regionsIn(lo + (hi - lo) / 2, hi);
+        }
+
+        template<size_t... I>
+        static constexpr Table<size_t, sizeof...(I)> makeOffsets(Indices<I...>) {
+            return {{ regionsIn(0, I)... }};
+        }
+        static constexpr Table<size_t, BUCKETS> OFFSETS = makeOffsets(MakeIndices<BUCKETS>::type());
+
+        static const size_t SLOTS = regionsIn(0, BUCKETS);
+
+        static constexpr size_t slotIn(uint32_t hash, uint32_t seed, size_t region) {
+            return mix(hash, seed) % region;
+        }
+
+        /* Tests that name and the names chained after it land in distinct slots. */
+        static constexpr bool distinctFrom(size_t name, size_t other, uint32_t seed, size_t region) {
+            return other == NONE ? true
+                : slotIn(HASHES[name], seed, region) != slotIn(HASHES[other], seed, region)
+                    && distinctFrom(name, NEXT[other], seed, region);
+        }
+        static constexpr bool distinct(size_t name, uint32_t seed, size_t region) {
+            return name == NONE ? true
+                : distinctFrom(name, NEXT[name], seed, region) && distinct(NEXT[name], seed, region);
+        }
+
+        /* First seed from seed on placing the names of bucket b in distinct slots, 0 if none. */
+        static constexpr uint32_t seedOf(size_t b, uint32_t seed) {
+            return seed > MAX_SEED ? 0
+                : distinct(FIRST[b], seed, REGIONS[b]) ? seed
+                : seedOf(b, seed + 1);
+        }
+
+        template<size_t... I>
+        static constexpr Table<uint32_t, sizeof...(I)> makeSeeds(Indices<I...>) {
+            return {{ seedOf(I, 1)... }};
+        }
+        static constexpr Table<uint32_t, BUCKETS> SEEDS = makeSeeds(MakeIndices<BUCKETS>::type());
+
+        static constexpr size_t slotOf(uint32_t hash) {
+            return OFFSETS[hash % BUCKETS] + slotIn(hash, SEEDS[hash % BUCKETS], REGIONS[hash % BUCKETS]);
+        }
+
+        /* Last bucket of [lo, hi) whose region starts at or before slot, i.e. the bucket owning slot. */
+        static constexpr size_t bucketAt(size_t slot, size_t lo, size_t hi) {
+            return hi - lo == 1 ? lo
+                : OFFSETS[lo + (hi - lo) / 2] <= slot ? bucketAt(slot, lo + (hi - lo) / 2, hi)
+                : bucketAt(slot, lo, lo + (hi - lo) / 2);
+        }
+
+        /* Name of the chain from name landing in slot, NONE if none. */
+        static constexpr size_t nameAt(size_t slot, size_t name) {
+            return name == NONE ? NONE
+                : slotOf(HASHES[name]) == slot ? name
+                : nameAt(slot, NEXT[name]);
+        }
+
+        template<size_t... I>
+        static constexpr Table<uint16_t, sizeof...(I)> makeSlots(Indices<I...>) {
+            return {{ static_cast<uint16_t>(nameAt(I, FIRST[bucketAt(I, 0, BUCKETS)]))... }};
+        }
+        static constexpr Table<uint16_t, SLOTS> TABLE = makeSlots(MakeIndices<SLOTS>::type());
+
+        /* Tests that every name of [lo, hi) is found in the table. */
+        static constexpr bool complete(size_t lo, size_t hi) {
+            return lo >= hi ? true
+                : hi - lo == 1 ? TABLE[slotOf(HASHES[lo])] == lo
+                : complete(lo, lo + (hi - lo) / 2) && complete(lo + (hi - lo) / 2, hi);
+        }
+
+        static_assert(complete(0, NAMES), "No perfect hash of the standard names, raise MAX_SEED or check for duplicates");
+        static_assert(NAMES < 0xFFFF, "Too many standard names for the table entries");
+
+    }/* namespace internal */
+
+    StandardName StandardNames::lookup(const LineView & name) {
+        using namespace internal;
+        uint32_t hash = fnv(name.data(), name.size());
+        if (REGIONS[hash % BUCKETS] == 0) {
+            return UNKNOWN_NAME;
+        }
+        size_t idx = TABLE[slotOf(hash)];
+        if (idx == NONE || !name.equals(STANDARD_NAMES[idx].str, STANDARD_NAMES[idx].size)) {
+            return UNKNOWN_NAME;
+        }
+        return static_cast<StandardName>(idx);
+    }
+
+    LineView StandardNames::name(StandardName id) {
+        if (id >= STANDARD_NAME_COUNT) {
+            return LineView();
+        }
+        return LineView(internal::STANDARD_NAMES[id].str, internal::STANDARD_NAMES[id].size);
+    }
+
+    bool StandardNames::isVariable(StandardName id) {
+        return id < internal::VARIABLES;
+    }
+
+    bool StandardNames::isCommand(StandardName id) {
+        return id >= internal::VARIABLES && id < STANDARD_NAME_COUNT;
+    }
+
+}
@@ -0,0 +1,266 @@
+//
+// Compile-time perfect hash table of the standard NUT variable and command names.
+//
+
+#ifndef NUTCLIENT_STANDARDNAMES_H
+#define NUTCLIENT_STANDARDNAMES_H
+#include "nutclient.h"
+
+/*
+ * The standard names, as X(id, name). Adding a name only takes a line here, the hash table is rebuilt by the
+ * compiler.
+ */
+#define NUTCLIENT_STANDARD_VARIABLES(X) \
+    X(VAR_DEVICE_MODEL,                  "device.model") \
+    X(VAR_DEVICE_MFR,                    "device.mfr") \
+    X(VAR_DEVICE_SERIAL,                 "device.serial") \
+    X(VAR_DEVICE_TYPE,                   "device.type") \
+    X(VAR_DEVICE_DESCRIPTION,            "device.description") \
+    X(VAR_DEVICE_CONTACT,                "device.contact") \
+    X(VAR_DEVICE_LOCATION,               "device.location") \
+    X(VAR_DEVICE_PART,                   "device.part") \
+    X(VAR_DEVICE_MACADDR,                "device.macaddr") \
+    X(VAR_DEVICE_UPTIME,                 "device.uptime") \
+    X(VAR_DEVICE_COUNT,                  "device.count") \
+    X(VAR_UPS_STATUS,                    "ups.status") \
+    X(VAR_UPS_ALARM,                     "ups.alarm") \
+    X(VAR_UPS_TIME,                      "ups.time") \
+    X(VAR_UPS_DATE,                      "ups.date") \
+    X(VAR_UPS_MODEL,                     "ups.model") \
+    X(VAR_UPS_MFR,                       "ups.mfr") \
+    X(VAR_UPS_MFR_DATE,                  "ups.mfr.date") \
+    X(VAR_UPS_SERIAL,                    "ups.serial") \
+    X(VAR_UPS_VENDORID,                  "ups.vendorid") \
+    X(VAR_UPS_PRODUCTID,                 "ups.productid") \
+    X(VAR_UPS_FIRMWARE,                  "ups.firmware") \
+    X(VAR_UPS_FIRMWARE_AUX,              "ups.firmware.aux") \
+    X(VAR_UPS_TEMPERATURE,               "ups.temperature") \
+    X(VAR_UPS_LOAD,                      "ups.load") \
+    X(VAR_UPS_LOAD_HIGH,                 "ups.load.high") \
+    X(VAR_UPS_ID,                        "ups.id") \
+    X(VAR_UPS_DELAY_START,               "ups.delay.start") \
+    X(VAR_UPS_DELAY_REBOOT,              "ups.delay.reboot") \
+    X(VAR_UPS_DELAY_SHUTDOWN,            "ups.delay.shutdown") \
+    X(VAR_UPS_TIMER_START,               "ups.timer.start") \
+    X(VAR_UPS_TIMER_REBOOT,              "ups.timer.reboot") \
+    X(VAR_UPS_TIMER_SHUTDOWN,            "ups.timer.shutdown") \
+    X(VAR_UPS_TEST_INTERVAL,             "ups.test.interval") \
+    X(VAR_UPS_TEST_RESULT,               "ups.test.result") \
+    X(VAR_UPS_TEST_DATE,                 "ups.test.date") \
+    X(VAR_UPS_DISPLAY_LANGUAGE,          "ups.display.language") \
+    X(VAR_UPS_CONTACTS,                  "ups.contacts") \
+    X(VAR_UPS_EFFICIENCY,                "ups.efficiency") \
+    X(VAR_UPS_POWER,                     "ups.power") \
+    X(VAR_UPS_POWER_NOMINAL,             "ups.power.nominal") \
+    X(VAR_UPS_REALPOWER,                 "ups.realpower") \
+    X(VAR_UPS_REALPOWER_NOMINAL,         "ups.realpower.nominal") \
+    X(VAR_UPS_BEEPER_STATUS,             "ups.beeper.status") \
+    X(VAR_UPS_TYPE,                      "ups.type") \
+    X(VAR_UPS_WATCHDOG_STATUS,           "ups.watchdog.status") \
+    X(VAR_UPS_START_AUTO,                "ups.start.auto") \
+    X(VAR_UPS_START_BATTERY,             "ups.start.battery") \
+    X(VAR_UPS_START_REBOOT,              "ups.start.reboot") \
+    X(VAR_UPS_SHUTDOWN,                  "ups.shutdown") \
+    X(VAR_INPUT_VOLTAGE,                 "input.voltage") \
+    X(VAR_INPUT_VOLTAGE_MAXIMUM,         "input.voltage.maximum") \
+    X(VAR_INPUT_VOLTAGE_MINIMUM,         "input.voltage.minimum") \
+    X(VAR_INPUT_VOLTAGE_STATUS,          "input.voltage.status") \
+    X(VAR_INPUT_VOLTAGE_LOW_WARNING,     "input.voltage.low.warning") \
+    X(VAR_INPUT_VOLTAGE_LOW_CRITICAL,    "input.voltage.low.critical") \
+    X(VAR_INPUT_VOLTAGE_HIGH_WARNING,    "input.voltage.high.warning") \
+    X(VAR_INPUT_VOLTAGE_HIGH_CRITICAL,   "input.voltage.high.critical") \
+    X(VAR_INPUT_VOLTAGE_NOMINAL,         "input.voltage.nominal") \
+    X(VAR_INPUT_VOLTAGE_EXTENDED,        "input.voltage.extended") \
+    X(VAR_INPUT_TRANSFER_DELAY,          "input.transfer.delay") \
+    X(VAR_INPUT_TRANSFER_REASON,         "input.transfer.reason") \
+    X(VAR_INPUT_TRANSFER_LOW,            "input.transfer.low") \
+    X(VAR_INPUT_TRANSFER_HIGH,           "input.transfer.high") \
+    X(VAR_INPUT_TRANSFER_LOW_MIN,        "input.transfer.low.min") \
+    X(VAR_INPUT_TRANSFER_LOW_MAX,        "input.transfer.low.max") \
+    X(VAR_INPUT_TRANSFER_HIGH_MIN,       "input.transfer.high.min") \
+    X(VAR_INPUT_TRANSFER_HIGH_MAX,       "input.transfer.high.max") \
+    X(VAR_INPUT_SENSITIVITY,             "input.sensitivity") \
+    X(VAR_INPUT_QUALITY,                 "input.quality") \
+    X(VAR_INPUT_CURRENT,                 "input.current") \
+    X(VAR_INPUT_CURRENT_NOMINAL,         "input.current.nominal") \
+    X(VAR_INPUT_CURRENT_STATUS,          "input.current.status") \
+    X(VAR_INPUT_CURRENT_LOW_WARNING,     "input.current.low.warning") \
+    X(VAR_INPUT_CURRENT_LOW_CRITICAL,    "input.current.low.critical") \
+    X(VAR_INPUT_CURRENT_HIGH_WARNING,    "input.current.high.warning") \
+    X(VAR_INPUT_CURRENT_HIGH_CRITICAL,   "input.current.high.critical") \
+    X(VAR_INPUT_FREQUENCY,               "input.frequency") \
+    X(VAR_INPUT_FREQUENCY_NOMINAL,       "input.frequency.nominal") \
+    X(VAR_INPUT_FREQUENCY_STATUS,        "input.frequency.status") \
+    X(VAR_INPUT_FREQUENCY_LOW,           "input.frequency.low") \
+    X(VAR_INPUT_FREQUENCY_HIGH,          "input.frequency.high") \
+    X(VAR_INPUT_FREQUENCY_EXTENDED,      "input.frequency.extended") \
+    X(VAR_INPUT_TRANSFER_BOOST_LOW,      "input.transfer.boost.low") \
+    X(VAR_INPUT_TRANSFER_BOOST_HIGH,     "input.transfer.boost.high") \
+    X(VAR_INPUT_TRANSFER_TRIM_LOW,       "input.transfer.trim.low") \
+    X(VAR_INPUT_TRANSFER_TRIM_HIGH,      "input.transfer.trim.high") \
+    X(VAR_INPUT_LOAD,                    "input.load") \
+    X(VAR_INPUT_REALPOWER,               "input.realpower") \
+    X(VAR_INPUT_POWER,                   "input.power") \
+    X(VAR_INPUT_SOURCE,                  "input.source") \
+    X(VAR_INPUT_SOURCE_PREFERRED,        "input.source.preferred") \
+    X(VAR_INPUT_PHASES,                  "input.phases") \
+    X(VAR_OUTPUT_VOLTAGE,                "output.voltage") \
+    X(VAR_OUTPUT_VOLTAGE_NOMINAL,        "output.voltage.nominal") \
+    X(VAR_OUTPUT_FREQUENCY,              "output.frequency") \
+    X(VAR_OUTPUT_FREQUENCY_NOMINAL,      "output.frequency.nominal") \
+    X(VAR_OUTPUT_CURRENT,                "output.current") \
+    X(VAR_OUTPUT_CURRENT_NOMINAL,        "output.current.nominal") \
+    X(VAR_OUTPUT_PHASES,                 "output.phases") \
+    X(VAR_OUTPUT_POWER,                  "output.power") \
+    X(VAR_OUTPUT_POWER_NOMINAL,          "output.power.nominal") \
+    X(VAR_OUTPUT_REALPOWER,              "output.realpower") \
+    X(VAR_OUTPUT_REALPOWER_NOMINAL,      "output.realpower.nominal") \
+    X(VAR_BATTERY_CHARGE,                "battery.charge") \
+    X(VAR_BATTERY_CHARGE_APPROX,         "battery.charge.approx") \
+    X(VAR_BATTERY_CHARGE_LOW,            "battery.charge.low") \
+    X(VAR_BATTERY_CHARGE_RESTART,        "battery.charge.restart") \
+    X(VAR_BATTERY_CHARGE_WARNING,        "battery.charge.warning") \
+    X(VAR_BATTERY_CHARGER_STATUS,        "battery.charger.status") \
+    X(VAR_BATTERY_VOLTAGE,               "battery.voltage") \
+    X(VAR_BATTERY_VOLTAGE_CELL_MAX,      "battery.voltage.cell.max") \
+    X(VAR_BATTERY_VOLTAGE_CELL_MIN,      "battery.voltage.cell.min") \
+    X(VAR_BATTERY_VOLTAGE_NOMINAL,       "battery.voltage.nominal") \
+    X(VAR_BATTERY_VOLTAGE_LOW,           "battery.voltage.low") \
+    X(VAR_BATTERY_VOLTAGE_HIGH,          "battery.voltage.high") \
+    X(VAR_BATTERY_CAPACITY,              "battery.capacity") \
+    X(VAR_BATTERY_CAPACITY_NOMINAL,      "battery.capacity.nominal") \
+    X(VAR_BATTERY_CURRENT,               "battery.current") \
+    X(VAR_BATTERY_CURRENT_TOTAL,         "battery.current.total") \
+    X(VAR_BATTERY_STATUS,                "battery.status") \
+    X(VAR_BATTERY_TEMPERATURE,           "battery.temperature") \
+    X(VAR_BATTERY_TEMPERATURE_CELL_MAX,  "battery.temperature.cell.max") \
+    X(VAR_BATTERY_TEMPERATURE_CELL_MIN,  "battery.temperature.cell.min") \
+    X(VAR_BATTERY_RUNTIME,               "battery.runtime") \
+    X(VAR_BATTERY_RUNTIME_LOW,           "battery.runtime.low") \
+    X(VAR_BATTERY_RUNTIME_RESTART,       "battery.runtime.restart") \
+    X(VAR_BATTERY_ALARM_THRESHOLD,       "battery.alarm.threshold") \
+    X(VAR_BATTERY_DATE,                  "battery.date") \
+    X(VAR_BATTERY_DATE_MAINTENANCE,      "battery.date.maintenance") \
+    X(VAR_BATTERY_MFR_DATE,              "battery.mfr.date") \
+    X(VAR_BATTERY_PACKS,                 "battery.packs") \
+    X(VAR_BATTERY_PACKS_BAD,             "battery.packs.bad") \
+    X(VAR_BATTERY_PACKS_EXTERNAL,        "battery.packs.external") \
+    X(VAR_BATTERY_TYPE,                  "battery.type") \
+    X(VAR_BATTERY_PROTECTION,            "battery.protection") \
+    X(VAR_BATTERY_ENERGYSAVE,            "battery.energysave") \
+    X(VAR_BATTERY_ENERGYSAVE_LOAD,       "battery.energysave.load") \
+    X(VAR_BATTERY_ENERGYSAVE_DELAY,      "battery.energysave.delay") \
+    X(VAR_BATTERY_ENERGYSAVE_REALPOWER,  "battery.energysave.realpower") \
+    X(VAR_AMBIENT_TEMPERATURE,           "ambient.temperature") \
+    X(VAR_AMBIENT_TEMPERATURE_ALARM,     "ambient.temperature.alarm") \
+    X(VAR_AMBIENT_TEMPERATURE_HIGH,      "ambient.temperature.high") \
+    X(VAR_AMBIENT_TEMPERATURE_LOW,       "ambient.temperature.low") \
+    X(VAR_AMBIENT_TEMPERATURE_MAXIMUM,   "ambient.temperature.maximum") \
+    X(VAR_AMBIENT_TEMPERATURE_MINIMUM,   "ambient.temperature.minimum") \
+    X(VAR_AMBIENT_HUMIDITY,              "ambient.humidity") \
+    X(VAR_AMBIENT_HUMIDITY_ALARM,        "ambient.humidity.alarm") \
+    X(VAR_AMBIENT_HUMIDITY_HIGH,         "ambient.humidity.high") \
+    X(VAR_AMBIENT_HUMIDITY_LOW,          "ambient.humidity.low") \
+    X(VAR_AMBIENT_HUMIDITY_MAXIMUM,      "ambient.humidity.maximum") \
+    X(VAR_AMBIENT_HUMIDITY_MINIMUM,      "ambient.humidity.minimum") \
+    X(VAR_AMBIENT_PRESENT,               "ambient.present") \
+    X(VAR_OUTLET_ID,                     "outlet.id") \
+    X(VAR_OUTLET_DESC,                   "outlet.desc") \
+    X(VAR_OUTLET_SWITCHABLE,             "outlet.switchable") \
+    X(VAR_OUTLET_CURRENT,                "outlet.current") \
+    X(VAR_OUTLET_POWER,                  "outlet.power") \
+    X(VAR_OUTLET_REALPOWER,              "outlet.realpower") \
+    X(VAR_OUTLET_VOLTAGE,                "outlet.voltage") \
+    X(VAR_DRIVER_NAME,                   "driver.name") \
+    X(VAR_DRIVER_VERSION,                "driver.version") \
+    X(VAR_DRIVER_VERSION_INTERNAL,       "driver.version.internal") \
+    X(VAR_DRIVER_VERSION_DATA,           "driver.version.data") \
+    X(VAR_DRIVER_VERSION_USB,            "driver.version.usb") \
+    X(VAR_DRIVER_PARAMETER_POLLINTERVAL, "driver.parameter.pollinterval") \
+    X(VAR_DRIVER_PARAMETER_POLLFREQ,     "driver.parameter.pollfreq") \
+    X(VAR_DRIVER_PARAMETER_PORT,         "driver.parameter.port") \
+    X(VAR_DRIVER_PARAMETER_SYNCHRONOUS,  "driver.parameter.synchronous") \
+    X(VAR_DRIVER_PARAMETER_VENDORID,     "driver.parameter.vendorid") \
+    X(VAR_DRIVER_PARAMETER_PRODUCTID,    "driver.parameter.productid") \
+    X(VAR_DRIVER_FLAG_IGNORELB,          "driver.flag.ignorelb") \
+    X(VAR_DRIVER_STATE,                  "driver.state") \
+    X(VAR_SERVER_INFO,                   "server.info") \
+    X(VAR_SERVER_VERSION,                "server.version")
+
+#define NUTCLIENT_STANDARD_COMMANDS(X) \
+    X(CMD_LOAD_OFF,                 "load.off") \
+    X(CMD_LOAD_ON,                  "load.on") \
+    X(CMD_LOAD_OFF_DELAY,           "load.off.delay") \
+    X(CMD_LOAD_ON_DELAY,            "load.on.delay") \
+    X(CMD_SHUTDOWN_RETURN,          "shutdown.return") \
+    X(CMD_SHUTDOWN_STAYOFF,         "shutdown.stayoff") \
+    X(CMD_SHUTDOWN_STOP,            "shutdown.stop") \
+    X(CMD_SHUTDOWN_REBOOT,          "shutdown.reboot") \
+    X(CMD_SHUTDOWN_REBOOT_GRACEFUL, "shutdown.reboot.graceful") \
+    X(CMD_TEST_PANEL_START,         "test.panel.start") \
+    X(CMD_TEST_PANEL_STOP,          "test.panel.stop") \
+    X(CMD_TEST_FAILURE_START,       "test.failure.start") \
+    X(CMD_TEST_FAILURE_STOP,        "test.failure.stop") \
+    X(CMD_TEST_BATTERY_START,       "test.battery.start") \
+    X(CMD_TEST_BATTERY_START_QUICK, "test.battery.start.quick") \
+    X(CMD_TEST_BATTERY_START_DEEP,  "test.battery.start.deep") \
+    X(CMD_TEST_BATTERY_STOP,        "test.battery.stop") \
+    X(CMD_TEST_SYSTEM_START,        "test.system.start") \
+    X(CMD_CALIBRATE_START,          "calibrate.start") \
+    X(CMD_CALIBRATE_STOP,           "calibrate.stop") \
+    X(CMD_BYPASS_START,             "bypass.start") \
+    X(CMD_BYPASS_STOP,              "bypass.stop") \
+    X(CMD_RESET_INPUT_MINMAX,       "reset.input.minmax") \
+    X(CMD_RESET_WATCHDOG,           "reset.watchdog") \
+    X(CMD_BEEPER_ENABLE,            "beeper.enable") \
+    X(CMD_BEEPER_DISABLE,           "beeper.disable") \
+    X(CMD_BEEPER_MUTE,              "beeper.mute") \
+    X(CMD_BEEPER_TOGGLE,            "beeper.toggle") \
+    X(CMD_BEEPER_ON,                "beeper.on") \
+    X(CMD_BEEPER_OFF,               "beeper.off")
+
+namespace nut {
+
+    class LIB_API StandardNames;
+
+    /*
+     * Ids of the standard variable and command names.
+     * They are also their NameTable ids: a NameId below STANDARD_NAME_COUNT is a standard name, so the ids of
+     * DeviceSnapshot and DevicePoller can be switched on directly.
+     */
+    enum StandardName : uint16_t {
+#define NUTCLIENT_STANDARD_NAME_ID(id, name) id,
+        NUTCLIENT_STANDARD_VARIABLES(NUTCLIENT_STANDARD_NAME_ID)
+        NUTCLIENT_STANDARD_COMMANDS(NUTCLIENT_STANDARD_NAME_ID)
+#undef NUTCLIENT_STANDARD_NAME_ID
+        STANDARD_NAME_COUNT,
+        UNKNOWN_NAME = STANDARD_NAME_COUNT
+    };
+
+    /*
+     * Lookup of the standard names. The table is built at compile time and is collision free: a lookup costs
+     * one hash of the name and one comparison, without any lock or allocation.
+     */
+    class StandardNames {
+    public:
+        /*
+         * Returns the id of a standard name, UNKNOWN_NAME if it is not one.
+         */
+        static StandardName lookup(const LineView & name);
+        /*
+         * Returns the standard name of an interned name id, UNKNOWN_NAME if it is not one.
+         */
+        static StandardName fromId(NameId id) {
+            return id < STANDARD_NAME_COUNT ? static_cast<StandardName>(id) : UNKNOWN_NAME;
+        }
+        /*
+         * Returns the name of a standard name id, empty for UNKNOWN_NAME.
+         */
+        static LineView name(StandardName id);
+        static bool isVariable(StandardName id);
+        static bool isCommand(StandardName id);
+    };
+
+}
+
+#endif //NUTCLIENT_STANDARDNAMES_H
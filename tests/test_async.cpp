@@ -0,0 +1,154 @@
+//
+// Tests of the asynchronous queries of TcpClient without multiplexing: sent at call time, replies matched in
+// order with the blocking queries in between, and the idempotent ones retried in resilient mode.
+//
+
+#include "../nutclient.h"
+#include "testing.h"
+#include <chrono>
+
+using namespace nut;
+
+static std::mutex linesMutex;
+static std::vector<std::string> lines;   /* Query lines received, in order */
+
+static std::string reply(const std::string & line) {
+    {
+        std::lock_guard<std::mutex> lock(linesMutex);
+        lines.push_back(line);
+    }
+    if (line.compare(0, 12, "GET VAR ups ") == 0) {
+        std::string name = line.substr(12);
+        if (name == "missing") {
+            return "ERR VAR-NOT-SUPPORTED\n";
+        }
+        return "VAR ups " + name + " \"" + name + "-value\"\n";
+    }
+    if (line == "LIST VAR ups") {
+        return "BEGIN LIST VAR ups\n"
+               "VAR ups battery.charge \"100\"\n"
+               "VAR ups ups.status \"OL\"\n"
+               "END LIST VAR ups\n";
+    }
+    if (line.compare(0, 9, "LIST VAR ") == 0) {
+        return "ERR UNKNOWN-UPS\n";
+    }
+    if (line.compare(0, 8, "SET VAR ") == 0) {
+        return "OK\n";
+    }
+    return "OK\n";
+}
+
+static std::vector<std::string> received() {
+    std::lock_guard<std::mutex> lock(linesMutex);
+    std::vector<std::string> res;
+    res.swap(lines);
+    return res;
+}
+
+/* Waits until the server received count lines, false after 5 seconds. */
+static bool waitReceived(size_t count) {
+    for (int n = 0; n < 500; ++n) {
+        {
+            std::lock_guard<std::mutex> lock(linesMutex);
+            if (lines.size() >= count) {
+                return true;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static std::string var(int n) {
+    return "var" + std::to_string(n);
+}
+
+/* The queries reach the server before any future is waited for, and each future gets its own reply. */
+static void testSentAtOnce(const test::TestServer & server) {
+    received();
+    TcpClient client("127.0.0.1", server.port());
+    std::vector<std::future<std::vector<std::string> > > futures;
+    for (int n = 0; n < 500; ++n) {
+        futures.push_back(client.getDeviceVariableValueAsync("ups", var(n)));
+    }
+    CHECK(waitReceived(500));
+    std::vector<std::string> res = received();
+    for (int n = 0; n < 500; ++n) {
+        CHECK(res[n] == "GET VAR ups " + var(n));
+    }
+    // Waited for out of order.
+    for (int n = 499; n >= 0; --n) {
+        CHECK(futures[n].get() == std::vector<std::string>(1, var(n) + "-value"));
+    }
+}
+
+/* Blocking queries between asynchronous ones read past the replies owed to them, which are kept. */
+static void testMixed(const test::TestServer & server) {
+    TcpClient client("127.0.0.1", server.port());
+    std::future<std::vector<std::string> > first = client.getDeviceVariableValueAsync("ups", "first");
+    std::future<std::map<std::string, std::vector<std::string> > > list = client.getDeviceVariableValuesAsync("ups");
+    std::future<std::map<std::string, std::vector<std::string> > > unknown = client.getDeviceVariableValuesAsync("other");
+    std::future<std::vector<std::string> > missing = client.getDeviceVariableValueAsync("ups", "missing");
+    std::future<TrackingID> set = client.setDeviceVariableAsync("ups", "ups.id", "new id");
+    CHECK(client.getDeviceVariableValue("ups", "blocking")[0] == "blocking-value");
+    std::future<std::vector<std::string> > last = client.getDeviceVariableValueAsync("ups", "last");
+    CHECK(client.getDeviceVariableValues("ups").size() == 2);
+
+    CHECK(last.get()[0] == "last-value");
+    CHECK(set.get().empty());
+    CHECK_THROWS(missing.get(), NutException);
+    CHECK_THROWS(unknown.get(), NutException);
+    std::map<std::string, std::vector<std::string> > vars = list.get();
+    CHECK(vars.size() == 2 && vars["ups.status"][0] == "OL");
+    CHECK(first.get()[0] == "first-value");
+    CHECK(client.getDeviceVariableValue("ups", "after")[0] == "after-value");
+
+    // A disconnection reads the replies owed first.
+    std::future<std::vector<std::string> > pending = client.getDeviceVariableValueAsync("ups", "pending");
+    client.disconnect();
+    CHECK(pending.get()[0] == "pending-value");
+}
+
+/*
+ * After the server dropped the connection, in resilient mode the reads are sent again once reconnected and
+ * the session replayed, the SET throws; without the resilient mode the reads throw too.
+ */
+static void testResilient() {
+    test::TestServer server(reply);
+    TcpClient client("127.0.0.1", server.port());
+    ReconnectPolicy policy;
+    policy.initialDelay = 10;
+    client.setResilient(true, policy);
+    client.authenticate("monitor", "secret");
+    CHECK(client.getDeviceVariableValueAsync("ups", "before").get()[0] == "before-value");
+    received();
+
+    server.drop();
+    std::future<std::vector<std::string> > get = client.getDeviceVariableValueAsync("ups", "lost");
+    std::future<TrackingID> set = client.setDeviceVariableAsync("ups", "ups.id", "lost");
+    std::future<std::map<std::string, std::vector<std::string> > > list = client.getDeviceVariableValuesAsync("ups");
+    CHECK(get.get()[0] == "lost-value");
+    CHECK_THROWS(set.get(), IOException);
+    CHECK(list.get().size() == 2);
+    // Sent again after the replay, the SET never: the LIST may be sent first, if the connection was found
+    // lost when it was issued.
+    std::vector<std::string> res = received();
+    CHECK(res.size() == 4);
+    CHECK(res[0] == "USERNAME monitor" && res[1] == "PASSWORD secret");
+    CHECK(std::set<std::string>(res.begin() + 2, res.end()) == std::set<std::string>({"GET VAR ups lost", "LIST VAR ups"}));
+    CHECK(client.getDeviceVariableValueAsync("ups", "after").get()[0] == "after-value");
+
+    client.setResilient(false);
+    server.drop();
+    std::future<std::vector<std::string> > failed = client.getDeviceVariableValueAsync("ups", "lost");
+    CHECK_THROWS(failed.get(), IOException);
+}
+
+int main() {
+    test::TestServer server(reply);
+    testSentAtOnce(server);
+    testMixed(server);
+    testResilient();
+    return 0;
+}
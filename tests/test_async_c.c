@@ -0,0 +1,50 @@
+/*
+ * C side of test_reactor: drives the non-blocking C API (see nutclient_async.h) from a poll() loop.
+ * Compiled as C, so that the header is checked to be usable from C.
+ */
+
+#include "../nutclient_async.h"
+#include <poll.h>
+
+struct logins_result {
+	int done;
+	int error;
+	int value;
+};
+
+static void on_logins(void* userdata, int error, const char* message, int value)
+{
+	struct logins_result* res = (struct logins_result*)userdata;
+	(void)message;
+	res->done = 1;
+	res->error = error;
+	res->value = value;
+}
+
+/*
+ * Connects to the server on the loopback port, and returns the number of logins on dev, -1 on error.
+ */
+int c_num_logins(unsigned short port, const char* dev)
+{
+	struct logins_result res = {0, 0, -1};
+	int turns;
+	NUTCLIENT_ASYNC_t client = nutclient_async_create_client("127.0.0.1", port, NULL, NULL);
+	if (client == NULL) {
+		return -1;
+	}
+	nutclient_async_set_timeout(client, 5);
+	nutclient_get_device_num_logins_async(client, dev, on_logins, &res);
+	for (turns = 0; !res.done && turns < 1000; ++turns) {
+		struct pollfd pfd;
+		pfd.fd = nutclient_tcp_get_fd(client);
+		pfd.events = POLLIN | (nutclient_tcp_wants_write(client) ? POLLOUT : 0);
+		pfd.revents = 0;
+		if (pfd.fd < 0 || poll(&pfd, 1, 10) <= 0) {
+			nutclient_process_events(client, 0, 0);
+			continue;
+		}
+		nutclient_process_events(client, (pfd.revents & (POLLIN | POLLERR | POLLHUP)) != 0, (pfd.revents & POLLOUT) != 0);
+	}
+	nutclient_async_destroy(client);
+	return res.done && res.error == NUTCLIENT_OK ? res.value : -1;
+}
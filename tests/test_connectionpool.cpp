@@ -0,0 +1,204 @@
+//
+// Tests of ConnectionPool (see connectionpool.h): the handshakes reaching the stand-in server on checkout,
+// reuse, prewarming, eviction and health checks, and the maxSize bound.
+//
+
+#include "../connectionpool.h"
+#include "testing.h"
+#include <chrono>
+#include <map>
+
+using namespace nut;
+
+static std::mutex queriesMutex;
+static std::map<std::string, int> queries;   /* First word of the query lines received, and how many times */
+
+static std::string reply(const std::string & line) {
+    std::string command = line.substr(0, line.find(' '));
+    {
+        std::lock_guard<std::mutex> lock(queriesMutex);
+        ++queries[command];
+    }
+    if (command == "USERNAME" || command == "PASSWORD" || line == "LOGIN ups") {
+        return "OK\n";
+    }
+    if (command == "VER") {
+        return "Network UPS Tools upsd 2.8.0\n";
+    }
+    if (line == "GET VAR ups ups.status") {
+        return "VAR ups ups.status \"OL\"\n";
+    }
+    return "ERR UNKNOWN-UPS\n";
+}
+
+static int count(const std::string & command) {
+    std::lock_guard<std::mutex> lock(queriesMutex);
+    return queries[command];
+}
+
+static void reset() {
+    std::lock_guard<std::mutex> lock(queriesMutex);
+    queries.clear();
+}
+
+/* Three handshake lines per connection opened: USERNAME, PASSWORD and LOGIN ups. */
+static void checkHandshakes(int connections) {
+    CHECK(count("USERNAME") == connections);
+    CHECK(count("PASSWORD") == connections);
+    CHECK(count("LOGIN") == connections);
+}
+
+static ConnectionPoolOptions options() {
+    ConnectionPoolOptions options;
+    options.user = "monitor";
+    options.password = "secret";
+    options.devices.push_back("ups");
+    options.timeout = 5;
+    return options;
+}
+
+/* A session returned to the pool is handed out again without a new handshake. */
+static void testReuse(const test::TestServer & server) {
+    reset();
+    ConnectionPool pool(options());
+    for (int n = 0; n < 10; ++n) {
+        ConnectionPool::Session session = pool.checkout("127.0.0.1", server.port());
+        CHECK(session && session->isConnected());
+        CHECK(session->getDeviceVariableValue("ups", "ups.status")[0] == "OL");
+        CHECK(pool.size("127.0.0.1", server.port()) == 1);
+        CHECK(pool.idle("127.0.0.1", server.port()) == 0);
+    }
+    CHECK(pool.idle("127.0.0.1", server.port()) == 1);
+    checkHandshakes(1);
+    CHECK(count("GET") == 10);
+    // Not idle long enough to be checked.
+    CHECK(count("VER") == 0);
+
+    // Two sessions at once need two connections; both are reused afterwards.
+    {
+        ConnectionPool::Session first = pool.checkout("127.0.0.1", server.port());
+        ConnectionPool::Session second = pool.checkout("127.0.0.1", server.port());
+        CHECK(first.get() != second.get());
+    }
+    CHECK(pool.size("127.0.0.1", server.port()) == 2);
+    CHECK(pool.idle("127.0.0.1", server.port()) == 2);
+    checkHandshakes(2);
+
+    // A discarded session is closed, not returned.
+    pool.checkout("127.0.0.1", server.port()).discard();
+    CHECK(pool.size("127.0.0.1", server.port()) == 1);
+    pool.clear();
+    CHECK(pool.size("127.0.0.1", server.port()) == 0);
+}
+
+/* Beyond maxSize, checkout() waits for a session to be returned, or times out. */
+static void testMaxSize(const test::TestServer & server) {
+    reset();
+    ConnectionPoolOptions opts = options();
+    opts.maxSize = 2;
+    opts.checkoutTimeout = 1;
+    ConnectionPool pool(opts);
+    ConnectionPool::Session first = pool.checkout("127.0.0.1", server.port());
+    ConnectionPool::Session second = pool.checkout("127.0.0.1", server.port());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CHECK_THROWS(pool.checkout("127.0.0.1", server.port()), TimeoutException);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsed >= 0.9 && elapsed < 3);
+
+    // A session released by another thread goes to the waiting checkout.
+    std::thread releaser([&first]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        first.release();
+    });
+    start = std::chrono::steady_clock::now();
+    ConnectionPool::Session third = pool.checkout("127.0.0.1", server.port());
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    releaser.join();
+    CHECK(third && elapsed >= 0.1 && elapsed < 1);
+    checkHandshakes(2);
+
+    // Many threads sharing two connections.
+    third.release();
+    second.release();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&pool, &server]() {
+            for (int n = 0; n < 50; ++n) {
+                ConnectionPool::Session session = pool.checkout("127.0.0.1", server.port());
+                CHECK(session->getDeviceVariableValue("ups", "ups.status")[0] == "OL");
+            }
+        });
+    }
+    for (std::thread & t : threads) {
+        t.join();
+    }
+    CHECK(pool.size("127.0.0.1", server.port()) == 2);
+    checkHandshakes(2);
+}
+
+/* prewarm() opens minSize connections, handed out without a handshake; evictIdle() keeps minSize of them. */
+static void testPrewarmAndEviction(const test::TestServer & server) {
+    reset();
+    ConnectionPoolOptions opts = options();
+    opts.minSize = 2;
+    opts.maxSize = 4;
+    opts.idleTimeout = 1;
+    ConnectionPool pool(opts);
+    pool.prewarm("127.0.0.1", server.port());
+    CHECK(pool.size("127.0.0.1", server.port()) == 2);
+    CHECK(pool.idle("127.0.0.1", server.port()) == 2);
+    checkHandshakes(2);
+    pool.prewarm("127.0.0.1", server.port());
+    checkHandshakes(2);
+
+    {
+        std::vector<ConnectionPool::Session> sessions;
+        for (int n = 0; n < 4; ++n) {
+            sessions.push_back(pool.checkout("127.0.0.1", server.port()));
+        }
+        checkHandshakes(4);
+    }
+    CHECK(pool.idle("127.0.0.1", server.port()) == 4);
+    pool.evictIdle();
+    CHECK(pool.size("127.0.0.1", server.port()) == 4);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    pool.evictIdle();
+    CHECK(pool.size("127.0.0.1", server.port()) == 2);
+    CHECK(pool.idle("127.0.0.1", server.port()) == 2);
+    ConnectionPool::Session session = pool.checkout("127.0.0.1", server.port());
+    CHECK(session->getDeviceVariableValue("ups", "ups.status")[0] == "OL");
+    checkHandshakes(4);
+}
+
+/* An idle session whose connection was closed by the server fails its check and is replaced. */
+static void testHealthCheck() {
+    reset();
+    test::TestServer server(reply);
+    ConnectionPoolOptions opts = options();
+    opts.healthCheckInterval = 0;
+    ConnectionPool pool(opts);
+    pool.checkout("127.0.0.1", server.port()).release();
+    checkHandshakes(1);
+
+    // Checked, alive: reused.
+    pool.checkout("127.0.0.1", server.port()).release();
+    CHECK(count("VER") == 1);
+    checkHandshakes(1);
+
+    server.drop();
+    ConnectionPool::Session session = pool.checkout("127.0.0.1", server.port());
+    CHECK(session->getDeviceVariableValue("ups", "ups.status")[0] == "OL");
+    CHECK(pool.size("127.0.0.1", server.port()) == 1);
+    checkHandshakes(2);
+}
+
+int main() {
+    test::TestServer server(reply);
+    testReuse(server);
+    testMaxSize(server);
+    testPrewarmAndEviction(server);
+    testHealthCheck();
+    return 0;
+}
@@ -0,0 +1,85 @@
+//
+// Tests of the coroutine interface (see coroutine.h) against a local stand-in server.
+//
+
+#include "../coroutine.h"
+#include "testing.h"
+
+using namespace nut;
+
+static std::string reply(const std::string & line) {
+    if (line == "LIST UPS") {
+        return "BEGIN LIST UPS\nUPS ups \"Test UPS\"\nEND LIST UPS\n";
+    }
+    if (line == "GET VAR ups battery.charge") {
+        return "VAR ups battery.charge \"100\"\n";
+    }
+    if (line == "GET VAR ups stalled") {
+        return "";
+    }
+    return "ERR VAR-NOT-SUPPORTED\n";
+}
+
+static Task<std::string> charge(CoClient & client) {
+    std::vector<std::string> values = co_await client.getDeviceVariableValue("ups", "battery.charge");
+    co_return values[0];
+}
+
+static Task<std::string> poll(CoClient & client, int port) {
+    co_await client.connect("127.0.0.1", port);
+    std::set<std::string> devs = co_await client.getDeviceNames();
+    CHECK(devs.size() == 1 && *devs.begin() == "ups");
+    co_return co_await charge(client);
+}
+
+static Task<void> missing(CoClient & client, int port) {
+    co_await client.connect("127.0.0.1", port);
+    co_await client.getDeviceVariableValue("ups", "missing");
+}
+
+static Task<void> stalled(CoClient & client, int port, bool & resumed) {
+    co_await client.connect("127.0.0.1", port);
+    co_await client.getDeviceVariableValue("ups", "stalled");
+    resumed = true;
+}
+
+/* run() returns the result of the task, nested tasks included. */
+static void testRun(const test::TestServer & server) {
+    Reactor reactor;
+    CoClient client(reactor);
+    CHECK(run(reactor, poll(client, server.port())) == "100");
+}
+
+/* An error reply is thrown by co_await, and then by run(). */
+static void testError(const test::TestServer & server) {
+    Reactor reactor;
+    CoClient client(reactor);
+    CHECK_THROWS(run(reactor, missing(client, server.port())), NutException);
+}
+
+/*
+ * A task left suspended by a stopped reactor is destroyed by run(): failing its query afterwards, as the
+ * destruction of the client does, must not resume it.
+ */
+static void testStopped(const test::TestServer & server) {
+    bool resumed = false;
+    Reactor reactor;
+    {
+        CoClient client(reactor);
+        std::thread stopper([&reactor]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            reactor.stop();
+        });
+        CHECK_THROWS(run(reactor, stalled(client, server.port(), resumed)), NutException);
+        stopper.join();
+    }
+    CHECK(!resumed);
+}
+
+int main() {
+    test::TestServer server(reply);
+    testRun(server);
+    testError(server);
+    testStopped(server);
+    return 0;
+}
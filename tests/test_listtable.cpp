@@ -0,0 +1,110 @@
+//
+// Tests of ListTable: the arena of a LIST reply, its reuse from query to query, and the heap allocations
+// of steady polling.
+//
+
+#include "../nutclient.h"
+#include "testing.h"
+#include <cstdlib>
+#include <new>
+
+using namespace nut;
+
+/* Allocations of the calling thread: the stand-in server allocates on its own threads. */
+static thread_local size_t allocations = 0;
+
+void * operator new(size_t size) {
+    ++allocations;
+    void * ptr = std::malloc(size > 0 ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void * ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+static std::string reply(const std::string & line) {
+    if (line == "LIST VAR ups") {
+        return "BEGIN LIST VAR ups\n"
+               "VAR ups battery.charge \"100\"\n"
+               "VAR ups ups.status \"OL CHRG\"\n"
+               "VAR ups ups.mfr \"APC \\\"Smart\\\" UPS\"\n"
+               "END LIST VAR ups\n";
+    }
+    if (line == "LIST VAR small") {
+        return "BEGIN LIST VAR small\n"
+               "VAR small ups.status \"OB\"\n"
+               "END LIST VAR small\n";
+    }
+    return "ERR UNKNOWN-UPS\n";
+}
+
+static void checkRow(const ListTable & table, size_t row, const char * name, const char * value) {
+    CHECK(table.columns(row) == 2);
+    CHECK(table.cell(row, 0).str() == name);
+    CHECK(table.cell(row, 1).str() == value);
+}
+
+/* The cells hold the tokens after the device name, escapes decoded, and match the rows of list(). */
+static void testContents(TcpClient & client) {
+    ListTable table;
+    client.getDeviceVariableTable("ups", table);
+    CHECK(table.rows() == 3);
+    checkRow(table, 0, "battery.charge", "100");
+    checkRow(table, 1, "ups.status", "OL CHRG");
+    checkRow(table, 2, "ups.mfr", "APC \"Smart\" UPS");
+
+    std::vector<std::vector<std::string> > rows = table.toRows();
+    std::map<std::string, std::vector<std::string> > values = client.getDeviceVariableValues("ups");
+    CHECK(rows.size() == values.size());
+    for (const std::vector<std::string> & row : rows) {
+        CHECK(values[row[0]] == std::vector<std::string>(row.begin() + 1, row.end()));
+    }
+}
+
+/* A table reused for a smaller reply holds only its rows, and keeps the memory of the larger one. */
+static void testReuse(TcpClient & client) {
+    ListTable table;
+    client.getDeviceVariableTable("ups", table);
+    size_t memory = table.memoryUsage();
+    client.getDeviceVariableTable("small", table);
+    CHECK(table.rows() == 1);
+    checkRow(table, 0, "ups.status", "OB");
+    CHECK(table.memoryUsage() == memory);
+    client.getDeviceVariableTable("ups", table);
+    CHECK(table.rows() == 3);
+    checkRow(table, 2, "ups.mfr", "APC \"Smart\" UPS");
+    CHECK(table.memoryUsage() == memory);
+    table.clear();
+    CHECK(table.rows() == 0);
+}
+
+/* Once the table has grown, polling over a direct connection does no heap allocation. */
+static void testNoAllocation(TcpClient & client) {
+    ListTable table;
+    client.getDeviceVariableTable("ups", table);
+    client.getDeviceVariableTable("ups", table);
+    size_t before = allocations;
+    for (int n = 0; n < 100; ++n) {
+        client.getDeviceVariableTable("ups", table);
+        client.getDeviceVariableTable("small", table);
+    }
+    CHECK(allocations == before);
+    CHECK(table.rows() == 1);
+}
+
+int main() {
+    test::TestServer server(reply);
+    TcpClient client("127.0.0.1", server.port());
+    testContents(client);
+    testReuse(client);
+    testNoAllocation(client);
+    return 0;
+}
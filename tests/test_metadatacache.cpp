@@ -0,0 +1,202 @@
+//
+// Tests of the metadata cache of TcpClient (see metadatacache.h): the queries reaching the stand-in server
+// on hits, misses, expiry, eviction and invalidation, and the local rejection of unknown names.
+//
+
+#include "../nutclient.h"
+#include "testing.h"
+#include <chrono>
+#include <map>
+
+using namespace nut;
+
+static std::mutex queriesMutex;
+static std::map<std::string, int> queries;   /* Query lines received, and how many times */
+
+static std::string reply(const std::string & line) {
+    {
+        std::lock_guard<std::mutex> lock(queriesMutex);
+        ++queries[line];
+    }
+    for (const char * dev : {"ups", "other"}) {
+        std::string name(dev);
+        if (line == "LIST VAR " + name) {
+            return "BEGIN LIST VAR " + name + "\n"
+                   "VAR " + name + " battery.charge \"100\"\n"
+                   "VAR " + name + " ups.status \"OL\"\n"
+                   "END LIST VAR " + name + "\n";
+        }
+        if (line == "LIST CMD " + name) {
+            return "BEGIN LIST CMD " + name + "\n"
+                   "CMD " + name + " beeper.off\n"
+                   "END LIST CMD " + name + "\n";
+        }
+        if (line.compare(0, 10 + name.size(), "GET DESC " + name + " ") == 0) {
+            return line.substr(4) + " \"Description\"\n";
+        }
+        if (line == "GET CMDDESC " + name + " beeper.off") {
+            return "CMDDESC " + name + " beeper.off \"Turn off the beeper\"\n";
+        }
+        if (line == "GET VAR " + name + " ups.status") {
+            return "VAR " + name + " ups.status \"OL\"\n";
+        }
+    }
+    return "ERR VAR-NOT-SUPPORTED\n";
+}
+
+static int count(const std::string & line) {
+    std::lock_guard<std::mutex> lock(queriesMutex);
+    return queries[line];
+}
+
+static void reset() {
+    std::lock_guard<std::mutex> lock(queriesMutex);
+    queries.clear();
+}
+
+/* Names and descriptions are fetched once, then served from the cache; values are always fetched. */
+static void testHits(const test::TestServer & server) {
+    reset();
+    TcpClient client("127.0.0.1", server.port());
+    client.setMetadataCache(true);
+    for (int n = 0; n < 3; ++n) {
+        CHECK(client.getDeviceVariableNames("ups").size() == 2);
+        CHECK(client.getDeviceCommandNames("ups").size() == 1);
+        CHECK(client.getDeviceVariableDescription("ups", "ups.status") == "Description");
+        CHECK(client.getDeviceCommandDescription("ups", "beeper.off") == "Turn off the beeper");
+        CHECK(client.getDeviceVariableValue("ups", "ups.status")[0] == "OL");
+    }
+    CHECK(count("LIST VAR ups") == 1);
+    CHECK(count("LIST CMD ups") == 1);
+    CHECK(count("GET DESC ups ups.status") == 1);
+    CHECK(count("GET CMDDESC ups beeper.off") == 1);
+    CHECK(count("GET VAR ups ups.status") == 3);
+    MetadataCacheStats stats = client.getMetadataCacheStats();
+    CHECK(stats.misses == 4);
+    CHECK(stats.hits == 8);
+    CHECK(stats.entries == 4);
+    CHECK(stats.bytes > 0);
+    CHECK(stats.rejected == 0);
+}
+
+/* Once the names of a device are cached, unknown names are rejected as upsd would, without a query. */
+static void testRejection(const test::TestServer & server) {
+    reset();
+    TcpClient client("127.0.0.1", server.port());
+    client.setMetadataCache(true);
+    // Not cached yet: the typo goes to the server.
+    CHECK_THROWS(client.getDeviceVariableValue("ups", "ups.statsu"), NutException);
+    CHECK(count("GET VAR ups ups.statsu") == 1);
+    client.getDeviceVariableNames("ups");
+    client.getDeviceCommandNames("ups");
+    CHECK_THROWS(client.getDeviceVariableValue("ups", "ups.statsu"), NutException);
+    CHECK_THROWS(client.getDeviceVariableDescription("ups", "ups.statsu"), NutException);
+    CHECK_THROWS(client.executeDeviceCommand("ups", "beeper.of"), NutException);
+    CHECK_THROWS(client.getDeviceCommandDescription("ups", "beeper.of"), NutException);
+    CHECK(count("GET VAR ups ups.statsu") == 1);
+    CHECK(count("GET DESC ups ups.statsu") == 0);
+    CHECK(count("INSTCMD ups beeper.of ") == 0);
+    CHECK(count("GET CMDDESC ups beeper.of") == 0);
+    CHECK(client.getMetadataCacheStats().rejected == 4);
+    try {
+        client.getDeviceVariableValue("ups", "ups.statsu");
+        CHECK(false);
+    } catch (const NutException & ex) {
+        CHECK(std::string(ex.what()).find("VAR-NOT-SUPPORTED") != std::string::npos);
+    }
+    // Known names still reach the server.
+    CHECK(client.getDeviceVariableValue("ups", "ups.status")[0] == "OL");
+    CHECK(count("GET VAR ups ups.status") == 1);
+}
+
+/* An entry past its TTL is dropped and fetched again. */
+static void testExpiry(const test::TestServer & server) {
+    reset();
+    TcpClient client("127.0.0.1", server.port());
+    MetadataCacheOptions options;
+    options.ttl = 1;
+    client.setMetadataCache(true, options);
+    client.getDeviceVariableNames("ups");
+    client.getDeviceVariableNames("ups");
+    CHECK(count("LIST VAR ups") == 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    client.getDeviceVariableNames("ups");
+    CHECK(count("LIST VAR ups") == 2);
+    MetadataCacheStats stats = client.getMetadataCacheStats();
+    CHECK(stats.expirations == 1);
+    CHECK(stats.hits == 1);
+    CHECK(stats.misses == 2);
+    CHECK(stats.entries == 1);
+}
+
+/* Beyond maxBytes, the least recently used entry is evicted. */
+static void testEviction(const test::TestServer & server) {
+    reset();
+    TcpClient client("127.0.0.1", server.port());
+    MetadataCacheOptions options;
+    // Room for two descriptions of about 160 bytes each.
+    options.maxBytes = 400;
+    client.setMetadataCache(true, options);
+    client.getDeviceVariableDescription("ups", "var.a");
+    client.getDeviceVariableDescription("ups", "var.b");
+    // var.a becomes the most recently used, var.b is evicted for var.c.
+    client.getDeviceVariableDescription("ups", "var.a");
+    client.getDeviceVariableDescription("ups", "var.c");
+    MetadataCacheStats stats = client.getMetadataCacheStats();
+    CHECK(stats.evictions == 1);
+    CHECK(stats.entries == 2);
+    CHECK(stats.bytes <= options.maxBytes);
+    client.getDeviceVariableDescription("ups", "var.a");
+    client.getDeviceVariableDescription("ups", "var.c");
+    CHECK(count("GET DESC ups var.a") == 1);
+    CHECK(count("GET DESC ups var.c") == 1);
+    client.getDeviceVariableDescription("ups", "var.b");
+    CHECK(count("GET DESC ups var.b") == 2);
+}
+
+/* Invalidating a device drops its entries only; invalidating all drops everything. */
+static void testInvalidate(const test::TestServer & server) {
+    reset();
+    TcpClient client("127.0.0.1", server.port());
+    client.setMetadataCache(true);
+    client.getDeviceVariableNames("ups");
+    client.getDeviceVariableDescription("ups", "ups.status");
+    client.getDeviceVariableNames("other");
+    CHECK(client.getMetadataCacheStats().entries == 3);
+    client.invalidateMetadata("ups");
+    CHECK(client.getMetadataCacheStats().entries == 1);
+    client.getDeviceVariableNames("ups");
+    client.getDeviceVariableDescription("ups", "ups.status");
+    client.getDeviceVariableNames("other");
+    CHECK(count("LIST VAR ups") == 2);
+    CHECK(count("GET DESC ups ups.status") == 2);
+    CHECK(count("LIST VAR other") == 1);
+    client.invalidateMetadata();
+    CHECK(client.getMetadataCacheStats().entries == 0);
+    CHECK(client.getMetadataCacheStats().bytes == 0);
+    client.getDeviceVariableNames("other");
+    CHECK(count("LIST VAR other") == 2);
+}
+
+/* Without the cache, every query reaches the server and nothing is rejected locally. */
+static void testDisabled(const test::TestServer & server) {
+    reset();
+    TcpClient client("127.0.0.1", server.port());
+    client.getDeviceVariableNames("ups");
+    client.getDeviceVariableNames("ups");
+    CHECK_THROWS(client.getDeviceVariableValue("ups", "ups.statsu"), NutException);
+    CHECK(count("LIST VAR ups") == 2);
+    CHECK(count("GET VAR ups ups.statsu") == 1);
+    CHECK(client.getMetadataCacheStats().hits == 0);
+}
+
+int main() {
+    test::TestServer server(reply);
+    testHits(server);
+    testRejection(server);
+    testExpiry(server);
+    testEviction(server);
+    testInvalidate(server);
+    testDisabled(server);
+    return 0;
+}
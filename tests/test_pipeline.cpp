@@ -0,0 +1,140 @@
+//
+// Tests of the multiplexed mode of TcpClient (see pipeline.h): threads interleaving GET and LIST queries on one
+// connection, some answered with a single line ERR, each receiving its own reply.
+//
+
+#include "../nutclient.h"
+#include "testing.h"
+#include <random>
+
+using namespace nut;
+
+/*
+ * Devices dev0 to dev9: dev<n> has n + 1 variables, var0 to var<n>, whose value names the device and the
+ * variable. LIST on a device multiple of 3, and GET of an unknown variable, reply a single ERR line.
+ */
+static std::string reply(const std::string & line) {
+    if (line.compare(0, 12, "LIST VAR dev") == 0) {
+        int dev = std::stoi(line.substr(12));
+        if (dev % 3 == 0) {
+            return "ERR DATA-STALE\n";
+        }
+        std::string name = "dev" + std::to_string(dev);
+        std::string res = "BEGIN LIST VAR " + name + "\n";
+        for (int n = 0; n <= dev; ++n) {
+            res += "VAR " + name + " var" + std::to_string(n) + " \"" + name + "/var" + std::to_string(n) + "\"\n";
+        }
+        return res + "END LIST VAR " + name + "\n";
+    }
+    if (line.compare(0, 11, "GET VAR dev") == 0) {
+        std::string params = line.substr(8);
+        size_t space = params.find(' ');
+        std::string name = params.substr(0, space);
+        std::string var = params.substr(space + 1);
+        if (var == "missing") {
+            return "ERR VAR-NOT-SUPPORTED\n";
+        }
+        return "VAR " + name + " " + var + " \"" + name + "/" + var + "\"\n";
+    }
+    return "ERR UNKNOWN-COMMAND\n";
+}
+
+static bool failsWith(const std::function<void()> & query, const std::string & error) {
+    try {
+        query();
+    } catch (const NutException & ex) {
+        return std::string(ex.what()).find(error) != std::string::npos;
+    }
+    return false;
+}
+
+/* A GET answering with its own device and variable. */
+static void checkGet(TcpClient & client, int dev, int var) {
+    std::string name = "dev" + std::to_string(dev);
+    std::string varName = "var" + std::to_string(var);
+    std::vector<std::string> value = client.getDeviceVariableValue(name, varName);
+    CHECK(value.size() == 1 && value[0] == name + "/" + varName);
+}
+
+/* A LIST answering with the variables of its own device, or its ERR. */
+static void checkList(TcpClient & client, int dev, bool table) {
+    std::string name = "dev" + std::to_string(dev);
+    if (dev % 3 == 0) {
+        CHECK(failsWith([&client, &name, table]() {
+            if (table) {
+                ListTable rows;
+                client.getDeviceVariableTable(name, rows);
+            } else {
+                client.getDeviceVariableValues(name);
+            }
+        }, "DATA-STALE"));
+        return;
+    }
+    if (table) {
+        ListTable rows;
+        client.getDeviceVariableTable(name, rows);
+        CHECK(rows.rows() == static_cast<size_t>(dev + 1));
+        for (size_t n = 0; n < rows.rows(); ++n) {
+            CHECK(rows.cell(n, 1).str() == name + "/" + rows.cell(n, 0).str());
+        }
+    } else {
+        std::map<std::string, std::vector<std::string> > vars = client.getDeviceVariableValues(name);
+        CHECK(vars.size() == static_cast<size_t>(dev + 1));
+        for (const auto & var : vars) {
+            CHECK(var.second.size() == 1 && var.second[0] == name + "/" + var.first);
+        }
+    }
+}
+
+static void testInterleaved(const test::TestServer & server) {
+    TcpClient client("127.0.0.1", server.port());
+    client.setMultiplexed(true);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&client, &errors, t]() {
+            std::mt19937 random(t);
+            for (int n = 0; n < 400; ++n) {
+                int dev = static_cast<int>(random() % 10);
+                bool error = false;
+                switch (random() % 4) {
+                case 0:
+                    checkList(client, dev, false);
+                    error = dev % 3 == 0;
+                    break;
+                case 1:
+                    checkList(client, dev, true);
+                    error = dev % 3 == 0;
+                    break;
+                case 2:
+                    CHECK(failsWith([&client, dev]() {
+                        client.getDeviceVariableValue("dev" + std::to_string(dev), "missing");
+                    }, "VAR-NOT-SUPPORTED"));
+                    error = true;
+                    break;
+                default:
+                    checkGet(client, dev, static_cast<int>(random() % 20));
+                    break;
+                }
+                if (error) {
+                    // The query following an error is answered with its own reply.
+                    ++errors;
+                    checkGet(client, dev, n);
+                }
+            }
+        });
+    }
+    for (std::thread & t : threads) {
+        t.join();
+    }
+    CHECK(errors > 0);
+    CHECK(client.isConnected());
+    checkGet(client, 1, 0);
+    checkList(client, 9, false);
+}
+
+int main() {
+    test::TestServer server(reply);
+    testInterleaved(server);
+    return 0;
+}
@@ -0,0 +1,273 @@
+//
+// Tests of DevicePoller (see poller.h): the deltas delivered as the variables of the stand-in server change,
+// unsubscribing during a poll, the error handler, and the polling thread stopped by a handler.
+//
+
+#include "../poller.h"
+#include "testing.h"
+#include <chrono>
+#include <condition_variable>
+
+using namespace nut;
+
+static std::mutex varsMutex;
+static std::map<std::string, std::string> vars;   /* Variables of device ups */
+
+/*
+ * Device ups lists vars, device slow lists nothing after 300 ms, the other devices are unknown.
+ */
+static std::string reply(const std::string & line) {
+    if (line == "LIST VAR ups") {
+        std::lock_guard<std::mutex> lock(varsMutex);
+        std::string res = "BEGIN LIST VAR ups\n";
+        for (const auto & var : vars) {
+            res += "VAR ups " + var.first + " \"" + var.second + "\"\n";
+        }
+        return res + "END LIST VAR ups\n";
+    }
+    if (line == "LIST VAR slow") {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        return "BEGIN LIST VAR slow\nEND LIST VAR slow\n";
+    }
+    return "ERR UNKNOWN-UPS\n";
+}
+
+static void setVar(const std::string & name, const std::string & value) {
+    std::lock_guard<std::mutex> lock(varsMutex);
+    vars[name] = value;
+}
+
+static void removeVar(const std::string & name) {
+    std::lock_guard<std::mutex> lock(varsMutex);
+    vars.erase(name);
+}
+
+/* Deltas received by a handler, from any thread. */
+struct Deltas {
+    std::mutex mutex;
+    std::condition_variable received;
+    std::vector<DeviceDelta> deltas;
+
+    DevicePoller::DeltaHandler handler() {
+        return [this](const DeviceDelta & delta) {
+            std::lock_guard<std::mutex> lock(mutex);
+            deltas.push_back(delta);
+            received.notify_all();
+        };
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return deltas.size();
+    }
+
+    DeviceDelta last() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return deltas.back();
+    }
+
+    bool waitFor(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return received.wait_for(lock, std::chrono::seconds(5), [this, count]() { return deltas.size() >= count; });
+    }
+};
+
+static const VariableChange * find(const DeviceDelta & delta, const std::string & name) {
+    for (const VariableChange & change : delta.changes) {
+        if (change.name == name) {
+            return &change;
+        }
+    }
+    return nullptr;
+}
+
+static bool has(const DeviceDelta & delta, const std::string & name, VariableChange::Kind kind, const std::string & value) {
+    const VariableChange * change = find(delta, name);
+    return change != nullptr && change->kind == kind && change->id == NameTable::find(name) &&
+           (kind == VariableChange::REMOVED ? change->value.empty() : change->value == std::vector<std::string>(1, value));
+}
+
+/* A full first delta, then only the variables added, changed and removed, and nothing when nothing changed. */
+static void testDeltas(const test::TestServer & server) {
+    setVar("battery.charge", "100");
+    setVar("ups.status", "OL");
+    setVar("ups.load", "23");
+    TcpClient client("127.0.0.1", server.port());
+    DevicePoller poller(client);
+    Deltas first;
+    poller.subscribe("ups", std::chrono::milliseconds(0), first.handler());
+    poller.poll();
+    CHECK(first.size() == 1);
+    DeviceDelta delta = first.last();
+    CHECK(delta.device == "ups");
+    CHECK(delta.changes.size() == 3);
+    CHECK(has(delta, "battery.charge", VariableChange::ADDED, "100"));
+    CHECK(has(delta, "ups.status", VariableChange::ADDED, "OL"));
+    CHECK(has(delta, "ups.load", VariableChange::ADDED, "23"));
+    CHECK(poller.snapshot("ups").size() == 3);
+
+    poller.poll();
+    CHECK(first.size() == 1);
+
+    setVar("ups.status", "OB");
+    setVar("battery.runtime", "2370");
+    removeVar("ups.load");
+    poller.poll();
+    CHECK(first.size() == 2);
+    delta = first.last();
+    CHECK(delta.changes.size() == 3);
+    CHECK(has(delta, "ups.status", VariableChange::CHANGED, "OB"));
+    CHECK(has(delta, "battery.runtime", VariableChange::ADDED, "2370"));
+    CHECK(has(delta, "ups.load", VariableChange::REMOVED, ""));
+
+    // A later subscriber receives the full delta, the earlier one nothing as nothing changed.
+    Deltas second;
+    poller.subscribe("ups", std::chrono::milliseconds(0), second.handler());
+    poller.poll();
+    CHECK(first.size() == 2);
+    CHECK(second.size() == 1);
+    CHECK(second.last().changes.size() == 3);
+    CHECK(has(second.last(), "ups.status", VariableChange::ADDED, "OB"));
+
+    // Not due yet: not polled.
+    Deltas slow;
+    DevicePoller other(client);
+    other.subscribe("ups", std::chrono::hours(1), slow.handler());
+    other.poll();
+    setVar("ups.status", "OL");
+    CHECK(other.poll() > std::chrono::minutes(59));
+    CHECK(slow.size() == 1);
+}
+
+/* A subscription cancelled while its device is being fetched is not delivered, and the device is dropped. */
+static void testUnsubscribeDuringPoll(const test::TestServer & server) {
+    TcpClient client("127.0.0.1", server.port());
+    DevicePoller poller(client);
+    Deltas deltas;
+    DevicePoller::SubscriptionId id = poller.subscribe("slow", std::chrono::milliseconds(0), deltas.handler());
+    std::thread polling([&poller]() { poller.poll(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    poller.unsubscribe(id);
+    polling.join();
+    CHECK(deltas.size() == 0);
+    CHECK(poller.snapshot("slow").size() == 0);
+    CHECK(poller.poll() == std::chrono::milliseconds::max());
+
+    // A handler unsubscribing another subscriber: called at most once more, during the same poll.
+    Deltas first, second;
+    DevicePoller::SubscriptionId secondId = 0;
+    poller.subscribe("ups", std::chrono::milliseconds(0), [&](const DeviceDelta & delta) {
+        first.handler()(delta);
+        poller.unsubscribe(secondId);
+    });
+    secondId = poller.subscribe("ups", std::chrono::milliseconds(0), second.handler());
+    poller.poll();
+    CHECK(first.size() == 1);
+    size_t calls = second.size();
+    CHECK(calls <= 1);
+    setVar("ups.status", "OB");
+    poller.poll();
+    setVar("ups.status", "OL");
+    CHECK(first.size() == 2);
+    CHECK(second.size() == calls);
+}
+
+/* Devices replying ERR are reported by name, the others still delivered; a lost connection is reported once. */
+static void testErrors() {
+    test::TestServer server(reply);
+    TcpClient client("127.0.0.1", server.port());
+    DevicePoller poller(client);
+    std::vector<std::string> errors;
+    poller.setErrorHandler([&errors](std::exception_ptr error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const IOException &) {
+            errors.push_back("io");
+        } catch (const NutException & ex) {
+            errors.push_back(ex.what());
+        }
+    });
+    Deltas ups, missing;
+    poller.subscribe("ups", std::chrono::milliseconds(0), ups.handler());
+    poller.subscribe("missing", std::chrono::milliseconds(0), missing.handler());
+    poller.poll();
+    CHECK(ups.size() == 1);
+    CHECK(missing.size() == 0);
+    CHECK(errors.size() == 1 && errors[0].find("missing") != std::string::npos);
+
+    // Every device failing.
+    DevicePoller only(client);
+    std::vector<std::string> onlyErrors;
+    only.setErrorHandler([&onlyErrors](std::exception_ptr error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const NutException & ex) {
+            onlyErrors.push_back(ex.what());
+        }
+    });
+    only.subscribe("missing", std::chrono::milliseconds(0), missing.handler());
+    only.subscribe("gone", std::chrono::milliseconds(0), missing.handler());
+    only.poll();
+    CHECK(onlyErrors.size() == 2);
+    CHECK(onlyErrors[0].find("gone") != std::string::npos && onlyErrors[1].find("missing") != std::string::npos);
+
+    errors.clear();
+    server.drop();
+    poller.poll();
+    CHECK(errors.size() == 1 && errors[0] == "io");
+    CHECK(ups.size() == 1);
+    CHECK(poller.snapshot("ups").size() > 0);
+}
+
+/* The polling thread stopped by one of its handlers is joined by the next start() and by the destructor. */
+static void testStopFromHandler(const test::TestServer & server) {
+    TcpClient client("127.0.0.1", server.port());
+    Deltas deltas;
+    {
+        DevicePoller poller(client);
+        poller.subscribe("ups", std::chrono::milliseconds(10), [&](const DeviceDelta & delta) {
+            deltas.handler()(delta);
+            poller.stop();
+        });
+        poller.start();
+        CHECK(deltas.waitFor(1));
+        // Stopped: changes are no longer polled.
+        setVar("ups.status", "OB");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK(deltas.size() == 1);
+
+        poller.start();
+        CHECK(deltas.waitFor(2));
+        CHECK(has(deltas.last(), "ups.status", VariableChange::CHANGED, "OB"));
+        setVar("ups.status", "OL");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK(deltas.size() == 2);
+        poller.start();
+        CHECK(deltas.waitFor(3));
+        // Destroyed while its thread, stopped by the handler, is ending.
+    }
+
+    // A handler stopping then starting the poller again: it keeps polling.
+    DevicePoller poller(client);
+    Deltas resumed;
+    poller.subscribe("ups", std::chrono::milliseconds(10), [&](const DeviceDelta & delta) {
+        resumed.handler()(delta);
+        poller.stop();
+        poller.start();
+    });
+    poller.start();
+    CHECK(resumed.waitFor(1));
+    setVar("ups.status", "OB");
+    CHECK(resumed.waitFor(2));
+    poller.stop();
+    setVar("ups.status", "OL");
+}
+
+int main() {
+    test::TestServer server(reply);
+    testDeltas(server);
+    testUnsubscribeDuringPoll(server);
+    testErrors();
+    testStopFromHandler(server);
+    return 0;
+}
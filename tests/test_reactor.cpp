@@ -0,0 +1,96 @@
+//
+// Tests of the event driven transport and of its C API (see reactor.h, nutclient_async.h).
+//
+
+#include "../reactor.h"
+#include "../nutclient_async.h"
+#include "testing.h"
+
+using namespace nut;
+
+extern "C" int c_num_logins(unsigned short port, const char * dev);
+
+static std::mutex receivedMutex;
+static std::vector<std::string> received;
+
+static std::string reply(const std::string & line) {
+    {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        received.push_back(line);
+    }
+    if (line == "GET NUMLOGINS ups") {
+        return "NUMLOGINS ups 3\n";
+    }
+    if (line == "FSD ups") {
+        return "OK FSD-SET\n";
+    }
+    if (line.compare(0, 8, "SET VAR ") == 0) {
+        return "OK\n";
+    }
+    return "ERR UNKNOWN-UPS\n";
+}
+
+/* A query on a socket neither connected nor connecting fails before query() returns. */
+static void testNotConnected() {
+    AsyncClient client;
+    bool failed = false;
+    client.getDeviceNames([&failed](const std::set<std::string> &, std::exception_ptr error) {
+        CHECK_THROWS(std::rethrow_exception(error), NotConnectedException);
+        failed = true;
+    });
+    CHECK(failed);
+    CHECK(client.socket()->pending() == 0);
+}
+
+/* Forced shutdown, number of logins and multi-value SET. */
+static void testQueries(const test::TestServer & server) {
+    Reactor reactor;
+    AsyncClient client(reactor);
+    client.setTimeout(5);
+    int done = 0;
+    int logins = -1;
+    client.connect("127.0.0.1", server.port(), [](std::exception_ptr error) {
+        CHECK(!error);
+    });
+    client.deviceForcedShutdown("ups", [&done](std::exception_ptr error) {
+        CHECK(!error);
+        ++done;
+    });
+    client.deviceGetNumLogins("ups", [&done, &logins](int value, std::exception_ptr error) {
+        CHECK(!error);
+        logins = value;
+        ++done;
+    });
+    client.deviceGetNumLogins("other", [&done](int value, std::exception_ptr error) {
+        CHECK(error && value == -1);
+        ++done;
+    });
+    std::vector<std::string> values = {"a b", "c\"d"};
+    client.setDeviceVariable("ups", "x", values, [&done](const TrackingID & id, std::exception_ptr error) {
+        CHECK(!error && id.empty());
+        ++done;
+    });
+    while (done < 4 && reactor.runOnce(1000)) {
+    }
+    CHECK(done == 4);
+    CHECK(logins == 3);
+
+    std::lock_guard<std::mutex> lock(receivedMutex);
+    CHECK(received.size() == 4);
+    CHECK(received[0] == "FSD ups");
+    CHECK(received[3] == "SET VAR ups x \"a b\" \"c\\\"d\"");
+}
+
+/* The C API, driven by a C event loop. */
+static void testC(const test::TestServer & server) {
+    CHECK(c_num_logins(static_cast<unsigned short>(server.port()), "ups") == 3);
+    CHECK(c_num_logins(static_cast<unsigned short>(server.port()), "other") == -1);
+}
+
+int main() {
+    test::TestServer server(reply);
+    testNotConnected();
+    testQueries(server);
+    testC(server);
+    return 0;
+}
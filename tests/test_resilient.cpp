@@ -0,0 +1,149 @@
+//
+// Tests of the resilient mode of TcpClient: the session replayed after the server drops the connection, the
+// retry of idempotent queries only, and the jittered delays between reconnection attempts.
+//
+
+#include "../nutclient.h"
+#include "testing.h"
+#include <chrono>
+#include <memory>
+
+using namespace nut;
+
+static std::mutex linesMutex;
+static std::vector<std::string> lines;   /* Query lines received, in order */
+
+static std::string reply(const std::string & line) {
+    {
+        std::lock_guard<std::mutex> lock(linesMutex);
+        lines.push_back(line);
+    }
+    if (line == "GET VAR ups ups.status") {
+        return "VAR ups ups.status \"OL\"\n";
+    }
+    if (line.compare(0, 8, "SET VAR ") == 0) {
+        return "OK TRACKING 1234\n";
+    }
+    return "OK\n";
+}
+
+static std::vector<std::string> received() {
+    std::lock_guard<std::mutex> lock(linesMutex);
+    std::vector<std::string> res;
+    res.swap(lines);
+    return res;
+}
+
+/* Reaches the delay computation of reconnect(), to draw it with chosen values. */
+struct DelayClient : public TcpClient {
+    using TcpClient::reconnectDelay;
+};
+
+static const char * const REPLAY[] = {"USERNAME monitor", "PASSWORD secret", "LOGIN ups", "SET TRACKING ON"};
+
+static void checkReplay(const std::vector<std::string> & res, size_t size) {
+    CHECK(res.size() == size);
+    for (size_t n = 0; n < 4; ++n) {
+        CHECK(res[n] == REPLAY[n]);
+    }
+}
+
+/*
+ * After the server drops the connection, a GET reconnects, replays the credentials, the device login and the
+ * features in order, then is sent again. A SET, which may have been executed, throws instead; the next query
+ * reconnects.
+ */
+static void testReplay() {
+    test::TestServer server(reply);
+    TcpClient client;
+    client.connect("127.0.0.1", server.port());
+    ReconnectPolicy policy;
+    policy.initialDelay = 10;
+    client.setResilient(true, policy);
+    client.authenticate("monitor", "secret");
+    client.deviceLogin("ups");
+    client.setFeature(TcpClient::TRACKING, true);
+    CHECK(client.getDeviceVariableValue("ups", "ups.status")[0] == "OL");
+    received();
+
+    server.drop();
+    CHECK(client.getDeviceVariableValue("ups", "ups.status")[0] == "OL");
+    std::vector<std::string> res = received();
+    checkReplay(res, 5);
+    CHECK(res[4] == "GET VAR ups ups.status");
+
+    server.drop();
+    CHECK_THROWS(client.setDeviceVariable("ups", "ups.id", "new id"), IOException);
+    CHECK(!client.isConnected());
+    CHECK(received().empty());
+    CHECK(client.setDeviceVariable("ups", "ups.id", "new id") == "1234");
+    res = received();
+    checkReplay(res, 5);
+    CHECK(res[4] == "SET VAR ups ups.id \"new id\"");
+
+    // A connection dropped again right after the replay is still recovered by the next query.
+    server.drop();
+    CHECK(client.getDeviceVariableValue("ups", "ups.status")[0] == "OL");
+    checkReplay(received(), 5);
+}
+
+/* The delay after n failed attempts is the draw times min(maxDelay, initialDelay * multiplier^(n-1)). */
+static void testDelays() {
+    ReconnectPolicy policy;
+    policy.initialDelay = 100;
+    policy.maxDelay = 30000;
+    policy.multiplier = 2;
+    double bound = 100;
+    for (int failures = 1; failures <= 20; ++failures) {
+        CHECK(DelayClient::reconnectDelay(policy, failures, 0) == 0);
+        CHECK(DelayClient::reconnectDelay(policy, failures, 0.5) == static_cast<long>(bound / 2));
+        long top = DelayClient::reconnectDelay(policy, failures, 0.999999);
+        CHECK(top <= bound && top >= bound * 0.99);
+        bound = std::min(bound * 2, 30000.0);
+    }
+    // No overflow after many failures, nor beyond maxDelay from the first one.
+    CHECK(DelayClient::reconnectDelay(policy, 100000, 0.999999) == 29999);
+    policy.initialDelay = 60000;
+    CHECK(DelayClient::reconnectDelay(policy, 1, 0.999999) == 29999);
+    policy.multiplier = 1;
+    policy.initialDelay = 250;
+    CHECK(DelayClient::reconnectDelay(policy, 50, 0.5) == 125);
+}
+
+/*
+ * A server gone for good: reconnect() makes maxAttempts attempts, the first at once, the others after delays
+ * within their bounds, then throws the last error.
+ */
+static void testGiveUp() {
+    std::unique_ptr<test::TestServer> server(new test::TestServer(reply));
+    TcpClient client;
+    client.connect("127.0.0.1", server->port());
+    ReconnectPolicy policy;
+    policy.maxAttempts = 4;
+    policy.initialDelay = 100;
+    policy.maxDelay = 150;
+    policy.multiplier = 2;
+    client.setResilient(true, policy);
+    server.reset();
+
+    // At most 100 + 150 + 150 ms of delays.
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CHECK_THROWS(client.getDeviceVariableValue("ups", "ups.status"), IOException);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsed < 0.4 + 0.3);
+
+    policy.maxAttempts = 1;
+    policy.initialDelay = 10000;
+    client.setResilient(true, policy);
+    start = std::chrono::steady_clock::now();
+    CHECK_THROWS(client.getDeviceVariableValue("ups", "ups.status"), IOException);
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsed < 0.3);
+}
+
+int main() {
+    testReplay();
+    testDelays();
+    testGiveUp();
+    return 0;
+}
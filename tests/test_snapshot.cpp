@@ -0,0 +1,43 @@
+//
+// Tests of DeviceSnapshot and of the decoding of LIST VAR replies into it.
+//
+
+#include "../nutclient.h"
+#include "testing.h"
+
+using namespace nut;
+
+static std::string reply(const std::string & line) {
+    if (line == "LIST VAR ups") {
+        return "BEGIN LIST VAR ups\n"
+               "VAR ups battery.charge \"100\"\n"
+               "VAR ups ups.status \"OL CHRG\"\n"
+               "VAR ups \"odd name\" \"a\" \"b\"\n"
+               "VAR ups na\\\"me \"va\\\\lue\"\n"
+               "VAR ups \"esc\\\"aped name\" plain\n"
+               "END LIST VAR ups\n";
+    }
+    return "ERR UNKNOWN-UPS\n";
+}
+
+/* Names and values are decoded as explode() does, quotes and escapes included. */
+static void testDecoding(const test::TestServer & server) {
+    TcpClient client("127.0.0.1", server.port());
+    DeviceSnapshot snapshot = client.getDeviceVariableSnapshot("ups");
+    CHECK(snapshot.size() == 5);
+    CHECK(snapshot.values("battery.charge") == std::vector<std::string>(1, "100"));
+    CHECK(snapshot.values("ups.status") == std::vector<std::string>(1, "OL CHRG"));
+    std::vector<std::string> odd;
+    odd.push_back("a");
+    odd.push_back("b");
+    CHECK(snapshot.values("odd name") == odd);
+    CHECK(snapshot.values("na\"me") == std::vector<std::string>(1, "va\\lue"));
+    CHECK(snapshot.values("esc\"aped name") == std::vector<std::string>(1, "plain"));
+    CHECK(snapshot.toMap() == client.getDeviceVariableValues("ups"));
+}
+
+int main() {
+    test::TestServer server(reply);
+    testDecoding(server);
+    return 0;
+}
@@ -0,0 +1,115 @@
+//
+// Tests of the standard name table (see standardnames.h) and of its agreement with the NameTable ids.
+//
+
+#include "../nutclient.h"
+#include "../standardnames.h"
+#include "testing.h"
+#include <random>
+
+using namespace nut;
+
+struct Name {
+    StandardName id;
+    const char * name;
+};
+
+static const Name NAMES[] = {
+#define NUTCLIENT_STANDARD_NAME_ENTRY(id, name) { id, name },
+    NUTCLIENT_STANDARD_VARIABLES(NUTCLIENT_STANDARD_NAME_ENTRY)
+    NUTCLIENT_STANDARD_COMMANDS(NUTCLIENT_STANDARD_NAME_ENTRY)
+#undef NUTCLIENT_STANDARD_NAME_ENTRY
+};
+
+/* The FNV-1a hash spreading the names over the buckets of the table, as in standardnames.cpp. */
+static uint32_t fnv(const std::string & str) {
+    uint32_t h = 2166136261u;
+    for (char c : str) {
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return h;
+}
+
+/* Every name of the X-macros is found, under its id, and its id gives it back. */
+static void testRoundTrip() {
+    CHECK(sizeof(NAMES) / sizeof(NAMES[0]) == STANDARD_NAME_COUNT);
+    bool commands = false;
+    for (const Name & name : NAMES) {
+        CHECK(StandardNames::lookup(name.name) == name.id);
+        CHECK(StandardNames::name(name.id).str() == name.name);
+        // The variables come first, then the commands.
+        commands = commands || StandardNames::isCommand(name.id);
+        CHECK(StandardNames::isCommand(name.id) == commands);
+        CHECK(StandardNames::isVariable(name.id) == !commands);
+    }
+    CHECK(StandardNames::lookup("ups.status") == VAR_UPS_STATUS);
+    CHECK(StandardNames::name(UNKNOWN_NAME).empty());
+    CHECK(!StandardNames::isVariable(UNKNOWN_NAME) && !StandardNames::isCommand(UNKNOWN_NAME));
+}
+
+/* Names differing by one character, by case or by length, and the empty name, are not standard names. */
+static void testNearMisses() {
+    CHECK(StandardNames::lookup("") == UNKNOWN_NAME);
+    CHECK(StandardNames::lookup(".") == UNKNOWN_NAME);
+    for (const Name & name : NAMES) {
+        std::string str(name.name);
+        CHECK(StandardNames::lookup(str.substr(0, str.size() - 1)) == UNKNOWN_NAME);
+        CHECK(StandardNames::lookup(str + ".") == UNKNOWN_NAME);
+        CHECK(StandardNames::lookup(str + '\0') == UNKNOWN_NAME);
+        CHECK(StandardNames::lookup(" " + str) == UNKNOWN_NAME);
+        std::string upper(str);
+        upper[0] = static_cast<char>(upper[0] - 'a' + 'A');
+        CHECK(StandardNames::lookup(upper) == UNKNOWN_NAME);
+        std::string changed(str);
+        changed.back() = changed.back() == 'x' ? 'y' : 'x';
+        CHECK(StandardNames::lookup(changed) == UNKNOWN_NAME);
+    }
+}
+
+/* Strings hashed to the bucket of a standard name, so that they reach its slots, are still misses. */
+static void testSameBucket() {
+    std::mt19937 random(7);
+    size_t found = 0;
+    for (int n = 0; n < 2000000 && found < 2000; ++n) {
+        std::string str = "ups.";
+        for (size_t k = random() % 12 + 1; k > 0; --k) {
+            str += static_cast<char>('a' + random() % 26);
+        }
+        if (StandardNames::lookup(str) != UNKNOWN_NAME) {
+            // One of the standard names, drawn at random.
+            CHECK(StandardNames::name(StandardNames::lookup(str)).str() == str);
+            continue;
+        }
+        uint32_t bucket = fnv(str) % STANDARD_NAME_COUNT;
+        for (const Name & name : NAMES) {
+            if (fnv(name.name) % STANDARD_NAME_COUNT == bucket) {
+                ++found;
+                break;
+            }
+        }
+    }
+    // Most buckets hold a name: the misses above went through the slots of the table.
+    CHECK(found == 2000);
+}
+
+/* The NameTable ids of the standard names are their StandardName values, other names come after them. */
+static void testNameTable() {
+    for (const Name & name : NAMES) {
+        CHECK(NameTable::find(name.name) == name.id);
+        CHECK(NameTable::intern(name.name) == name.id);
+        CHECK(NameTable::name(name.id).str() == name.name);
+        CHECK(StandardNames::fromId(name.id) == name.id);
+    }
+    NameId other = NameTable::intern("test.not.standard");
+    CHECK(other >= STANDARD_NAME_COUNT);
+    CHECK(StandardNames::fromId(other) == UNKNOWN_NAME);
+    CHECK(NameTable::intern("test.not.standard") == other);
+}
+
+int main() {
+    testRoundTrip();
+    testNearMisses();
+    testSameBucket();
+    testNameTable();
+    return 0;
+}
@@ -0,0 +1,159 @@
+//
+// Tests of the deadlines of DefaultSocket against stalled local servers, and of its readiness waits with
+// descriptors above FD_SETSIZE.
+//
+
+#include "../nutclient.h"
+#include "testing.h"
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <fcntl.h>
+#include <chrono>
+
+using namespace nut;
+
+static std::string reply(const std::string & line) {
+    if (line == "GET VAR ups battery.charge") {
+        return "VAR ups battery.charge \"100\"\n";
+    }
+    return "";
+}
+
+static double since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* A server that never replies: the read times out after the timeout, and the connection is closed. */
+static void testReadTimeout() {
+    test::TestServer server(reply, false);
+    TcpClient client;
+    client.setTimeout(1);
+    client.connect("127.0.0.1", server.port());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CHECK_THROWS(client.getDeviceVariableValue("ups", "battery.charge"), TimeoutException);
+    double elapsed = since(start);
+    CHECK(elapsed >= 0.9 && elapsed < 3);
+    CHECK(!client.isConnected());
+}
+
+/* A server that never reads: the write times out once the socket buffers are full. */
+static void testWriteTimeout() {
+    test::TestServer server(reply, false);
+    TcpClient client;
+    client.setTimeout(1);
+    client.connect("127.0.0.1", server.port());
+    const std::string value(16 * 1024 * 1024, 'x');
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CHECK_THROWS(client.setDeviceVariable("ups", "ups.id", value), TimeoutException);
+    double elapsed = since(start);
+    CHECK(elapsed >= 0.9 && elapsed < 5);
+    CHECK(!client.isConnected());
+}
+
+/*
+ * A server whose listen backlog is full drops the handshakes: the connect times out. The backlog is filled
+ * with connections of its own first.
+ */
+static void testConnectTimeout() {
+    test::TestServer server(reply, false, 0);
+    std::vector<int> fillers;
+    for (int n = 0; n < 8; ++n) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ::fcntl(fd, F_SETFL, O_NONBLOCK);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<uint16_t>(server.port()));
+        ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+        fillers.push_back(fd);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    TcpClient client;
+    client.setTimeout(1);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CHECK_THROWS(client.connect("127.0.0.1", server.port()), TimeoutException);
+    double elapsed = since(start);
+    CHECK(elapsed >= 0.9 && elapsed < 3);
+    CHECK(!client.isConnected());
+    for (int fd : fillers) {
+        ::close(fd);
+    }
+}
+
+/*
+ * Connections to a unix domain socket whose backlog is full fail at once with EAGAIN: they are tried again
+ * until the deadline passes.
+ */
+static void testUnixConnectTimeout() {
+    const std::string path = "/tmp/test_timeout." + std::to_string(::getpid());
+    test::TestServer server(reply, path, false, 0);
+    std::vector<int> fillers;
+    while (fillers.size() < 64) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ::fcntl(fd, F_SETFL, O_NONBLOCK);
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+        int res = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+        if (res != 0) {
+            CHECK(errno == EAGAIN);
+            ::close(fd);
+            break;
+        }
+        fillers.push_back(fd);
+    }
+    TcpClient client;
+    client.setTimeout(1);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CHECK_THROWS(client.connect("unix:" + path), TimeoutException);
+    double elapsed = since(start);
+    CHECK(elapsed >= 0.9 && elapsed < 3);
+    for (int fd : fillers) {
+        ::close(fd);
+    }
+}
+
+/*
+ * Clients whose descriptors are numbered above FD_SETSIZE connect, query and time out like the others: the
+ * descriptors below are taken first, then several thousand clients connect at once.
+ */
+static void testManyDescriptors() {
+    const int clients = 2500;
+    struct rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < static_cast<rlim_t>(FD_SETSIZE + 2 * clients + 64)) {
+        std::cout << "skipping the descriptor test, the limit of open files is " << limit.rlim_cur << std::endl;
+        return;
+    }
+    std::vector<int> fillers;
+    while (fillers.empty() || fillers.back() < FD_SETSIZE) {
+        fillers.push_back(::open("/dev/null", O_RDONLY));
+    }
+
+    test::TestServer server(reply);
+    std::vector<std::unique_ptr<TcpClient> > all;
+    for (int n = 0; n < clients; ++n) {
+        all.emplace_back(new TcpClient("127.0.0.1", server.port()));
+        all.back()->setTimeout(5);
+    }
+    for (std::unique_ptr<TcpClient> & client : all) {
+        CHECK(client->getDeviceVariableValue("ups", "battery.charge") == std::vector<std::string>(1, "100"));
+    }
+    all.back()->setTimeout(1);
+    CHECK_THROWS(all.back()->getDeviceVariableValue("ups", "stalled"), TimeoutException);
+    all.clear();
+    for (int fd : fillers) {
+        ::close(fd);
+    }
+}
+
+int main() {
+    testReadTimeout();
+    testWriteTimeout();
+    testConnectTimeout();
+    testUnixConnectTimeout();
+    testManyDescriptors();
+    return 0;
+}
@@ -0,0 +1,81 @@
+//
+// Differential test of the tokenizer: the block scan of explode() must give the same tokens as the
+// character by character explodeEscaped() on any input.
+//
+
+#include "../nutclient.h"
+#include "testing.h"
+#include <random>
+
+using namespace nut;
+
+/* Reaches the protected tokenizers. */
+struct Tokenizer : public TcpClient {
+    using TcpClient::explode;
+
+    static std::vector<std::string> reference(const std::string & str, size_t begin) {
+        std::vector<std::string> res;
+        explodeEscaped(str, begin, res);
+        return res;
+    }
+};
+
+static void check(const std::string & str, size_t begin) {
+    if (Tokenizer::explode(str, begin) != Tokenizer::reference(str, begin)) {
+        std::cerr << "tokens differ from position " << begin << " of [" << str << "]" << std::endl;
+        std::exit(1);
+    }
+}
+
+/* Hand picked lines: quotes, escapes, and delimiters on both sides of a 16 byte block. */
+static void testLines() {
+    const char * lines[] = {
+        "",
+        "VAR ups battery.charge \"100\"",
+        "VAR ups ups.mfr \"APC \\\"Smart\\\" UPS\"",
+        "VAR ups \"quoted name\" value",
+        "VAR ups na\\ me \"a\"\"b\"",
+        "0123456789abcde \"0123456789abcdef\" x",
+        "0123456789abcdef\\ 0123456789abcde\"",
+        "\"unterminated 0123456789abcdef",
+        "trailing backslash\\",
+        "   leading and trailing spaces   ",
+    };
+    for (const char * line : lines) {
+        std::string str(line);
+        for (size_t begin = 0; begin <= str.size(); ++begin) {
+            check(str, begin);
+        }
+    }
+}
+
+/*
+ * Random lines up to four blocks long. Half of them mostly hold letters with a few delimiters, the shape of
+ * the replies; the others are drawn from the delimiters and a few other bytes only.
+ */
+static void testRandom() {
+    std::mt19937 random(42);
+    const char delimiters[] = {' ', '"', '\\'};
+    const char bytes[] = {' ', '"', '\\', 'a', '.', '\t', '\xe9', '0'};
+    for (int n = 0; n < 200000; ++n) {
+        std::string str;
+        size_t size = random() % 64;
+        bool letters = random() % 2 == 0;
+        for (size_t k = 0; k < size; ++k) {
+            if (!letters) {
+                str += bytes[random() % sizeof(bytes)];
+            } else if (random() % 10 < 8) {
+                str += static_cast<char>('a' + random() % 26);
+            } else {
+                str += delimiters[random() % sizeof(delimiters)];
+            }
+        }
+        check(str, random() % (str.size() + 1));
+    }
+}
+
+int main() {
+    testLines();
+    testRandom();
+    return 0;
+}
@@ -0,0 +1,118 @@
+//
+// Tests of the io_uring transport (see uringsocket.h): queries and deadlines, as for DefaultSocket.
+// Skipped on kernels without io_uring.
+//
+
+#include "../uringsocket.h"
+#include "testing.h"
+#include <chrono>
+
+using namespace nut;
+
+static std::mutex setsMutex;
+static std::vector<std::string> sets;
+
+static std::string reply(const std::string & line) {
+    if (line == "GET VAR ups battery.charge") {
+        return "VAR ups battery.charge \"100\"\n";
+    }
+    if (line == "LIST VAR ups") {
+        std::string res = "BEGIN LIST VAR ups\n";
+        for (int n = 0; n < 500; ++n) {
+            res += "VAR ups var" + std::to_string(n) + " \"" + std::to_string(n) + "\"\n";
+        }
+        return res + "END LIST VAR ups\n";
+    }
+    if (line.compare(0, 8, "SET VAR ") == 0) {
+        std::lock_guard<std::mutex> lock(setsMutex);
+        sets.push_back(line);
+        return "OK\n";
+    }
+    if (line == "GET VAR ups stalled") {
+        return "";
+    }
+    return "ERR VAR-NOT-SUPPORTED\n";
+}
+
+/* GET, LIST larger than the receive buffer of a connection, SET and an error reply. */
+static void testQueries(const test::TestServer & server) {
+    TcpClient client("127.0.0.1", server.port());
+    for (int n = 0; n < 100; ++n) {
+        CHECK(client.getDeviceVariableValue("ups", "battery.charge") == std::vector<std::string>(1, "100"));
+    }
+    std::map<std::string, std::vector<std::string> > vars = client.getDeviceVariableValues("ups");
+    CHECK(vars.size() == 500);
+    CHECK(vars["var499"] == std::vector<std::string>(1, "499"));
+    client.setDeviceVariable("ups", "ups.id", "new id");
+    {
+        std::lock_guard<std::mutex> lock(setsMutex);
+        CHECK(sets.size() == 1 && sets[0] == "SET VAR ups ups.id \"new id\"");
+    }
+    CHECK_THROWS(client.getDeviceVariableValue("ups", "missing"), NutException);
+    CHECK(client.getDeviceVariableValue("ups", "battery.charge") == std::vector<std::string>(1, "100"));
+}
+
+/* Several threads, each with its own connection, share the ring. */
+static void testThreads(const test::TestServer & server) {
+    std::vector<std::thread> threads;
+    std::atomic<int> done(0);
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&server, &done]() {
+            TcpClient client("127.0.0.1", server.port());
+            for (int n = 0; n < 200; ++n) {
+                if (n % 20 == 0) {
+                    CHECK(client.getDeviceVariableValues("ups").size() == 500);
+                } else {
+                    CHECK(client.getDeviceVariableValue("ups", "battery.charge")[0] == "100");
+                }
+            }
+            ++done;
+        });
+    }
+    for (std::thread & t : threads) {
+        t.join();
+    }
+    CHECK(done == 8);
+}
+
+/*
+ * A read without reply is cancelled by its linked timeout: TimeoutException after the timeout, and the
+ * connection is closed. The next query on a new connection works.
+ */
+static void testTimeout(const test::TestServer & server) {
+    TcpClient client;
+    client.setTimeout(1);
+    client.connect("127.0.0.1", server.port());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CHECK_THROWS(client.getDeviceVariableValue("ups", "stalled"), TimeoutException);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsed >= 0.9 && elapsed < 3);
+    CHECK(!client.isConnected());
+    client.connect();
+    CHECK(client.getDeviceVariableValue("ups", "battery.charge")[0] == "100");
+}
+
+/* A server that never reads: the write is cancelled by its timeout once the socket buffers are full. */
+static void testWriteTimeout() {
+    test::TestServer server(reply, false);
+    TcpClient client;
+    client.setTimeout(1);
+    client.connect("127.0.0.1", server.port());
+    const std::string value(16 * 1024 * 1024, 'x');
+    CHECK_THROWS(client.setDeviceVariable("ups", "ups.id", value), TimeoutException);
+    CHECK(!client.isConnected());
+}
+
+int main() {
+    if (!uringAvailable()) {
+        std::cout << "io_uring is not available, skipped" << std::endl;
+        return 0;
+    }
+    registerSocketFactory(uringSocketFactory);
+    test::TestServer server(reply);
+    testQueries(server);
+    testThreads(server);
+    testTimeout(server);
+    testWriteTimeout();
+    return 0;
+}
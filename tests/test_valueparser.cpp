@@ -0,0 +1,171 @@
+//
+// Tests of ValueParser: edge cases, and agreement with strtod() and strtoll() on random values.
+//
+
+#include "../nutclient.h"
+#include "testing.h"
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace nut;
+
+static bool parsesInt(const char * value, int64_t expected) {
+    int64_t res = 0;
+    return ValueParser::parseInt(value, res) && res == expected;
+}
+
+static bool rejectsInt(const char * value) {
+    int64_t res = 0;
+    return !ValueParser::parseInt(value, res);
+}
+
+/* Compares the bits, so that -0 differs from 0. */
+static bool parsesDouble(const std::string & value, double expected) {
+    double res = 1;
+    return ValueParser::parseDouble(value, res) && std::memcmp(&res, &expected, sizeof(res)) == 0;
+}
+
+static bool rejectsDouble(const char * value) {
+    double res = 0;
+    return !ValueParser::parseDouble(value, res);
+}
+
+static void testIntEdges() {
+    CHECK(parsesInt("0", 0));
+    CHECK(parsesInt("-0", 0));
+    CHECK(parsesInt("230", 230));
+    CHECK(parsesInt("-12", -12));
+    CHECK(parsesInt("9223372036854775807", INT64_MAX));
+    CHECK(parsesInt("-9223372036854775808", INT64_MIN));
+    CHECK(parsesInt("00000000000000000000000042", 42));
+    CHECK(rejectsInt("9223372036854775808"));
+    CHECK(rejectsInt("-9223372036854775809"));
+    CHECK(rejectsInt("99999999999999999999"));
+    CHECK(rejectsInt(""));
+    CHECK(rejectsInt("-"));
+    CHECK(rejectsInt("+1"));
+    CHECK(rejectsInt(" 1"));
+    CHECK(rejectsInt("1 "));
+    CHECK(rejectsInt("12a"));
+    CHECK(rejectsInt("1.0"));
+    CHECK(rejectsInt("0x10"));
+}
+
+static void testDoubleEdges() {
+    CHECK(parsesDouble("230", 230));
+    CHECK(parsesDouble("-12.5", -12.5));
+    CHECK(parsesDouble("1.5e3", 1500));
+    CHECK(parsesDouble("1.5E-3", 1.5e-3));
+    CHECK(parsesDouble("1e+2", 100));
+    CHECK(parsesDouble(".5", 0.5));
+    CHECK(parsesDouble("5.", 5));
+    CHECK(parsesDouble("0", 0.0));
+    CHECK(parsesDouble("-0", -0.0));
+    CHECK(parsesDouble("-0.0e10", -0.0));
+    CHECK(rejectsDouble(""));
+    CHECK(rejectsDouble("."));
+    CHECK(rejectsDouble("-"));
+    CHECK(rejectsDouble("-."));
+    CHECK(rejectsDouble("1e"));
+    CHECK(rejectsDouble("1e+"));
+    CHECK(rejectsDouble("1e-"));
+    CHECK(rejectsDouble("e5"));
+    CHECK(rejectsDouble(".e5"));
+    CHECK(rejectsDouble("+1"));
+    CHECK(rejectsDouble("1.2.3"));
+    CHECK(rejectsDouble("1e5x"));
+    CHECK(rejectsDouble(" 1"));
+    CHECK(rejectsDouble("1,5"));
+    CHECK(rejectsDouble("inf"));
+    CHECK(rejectsDouble("nan"));
+    CHECK(rejectsDouble("0x1p3"));
+    CHECK(rejectsDouble("OL"));
+}
+
+/* Values out of the fast path go through the istringstream fallback. */
+static void testDoubleFallback() {
+    // Over 19 significant digits.
+    CHECK(parsesDouble("123456789012345678901234567890", 123456789012345678901234567890.0));
+    CHECK(parsesDouble("0.1234567890123456789012345", 0.1234567890123456789012345));
+    CHECK(parsesDouble("1234567890123456789.5", 1234567890123456789.5));
+    // Exponents out of the exact powers of ten.
+    CHECK(parsesDouble("1e23", 1e23));
+    CHECK(parsesDouble("1e-23", 1e-23));
+    CHECK(parsesDouble("1.7976931348623157e308", 1.7976931348623157e308));
+    CHECK(parsesDouble("4.9e-324", 4.9e-324));
+    // Overflow is rejected, underflow gives zero.
+    CHECK(rejectsDouble("1e400"));
+    CHECK(rejectsDouble("-1e400"));
+    CHECK(rejectsDouble("1e99999999999"));
+    CHECK(parsesDouble("1e-400", 0.0));
+}
+
+/* Random decimals, long and short, agree with strtod() to the bit. */
+static void testDoubleRandom() {
+    std::mt19937 random(11);
+    char value[64];
+    for (int n = 0; n < 500000; ++n) {
+        int len = 0;
+        if (random() % 4 == 0) {
+            value[len++] = '-';
+        }
+        int digits = static_cast<int>(random() % (random() % 8 == 0 ? 25 : 9)) + 1;
+        int point = static_cast<int>(random() % (digits + 2)) - 1;
+        for (int d = 0; d < digits; ++d) {
+            if (d == point) {
+                value[len++] = '.';
+            }
+            value[len++] = static_cast<char>('0' + random() % 10);
+        }
+        if (random() % 4 == 0) {
+            len += std::sprintf(value + len, "e%d", static_cast<int>(random() % 80) - 40);
+        }
+        value[len] = '\0';
+        errno = 0;
+        char * end;
+        double expected = std::strtod(value, &end);
+        if (*end != '\0' || errno == ERANGE) {
+            continue;
+        }
+        if (!parsesDouble(value, expected)) {
+            std::cerr << "parseDouble(" << value << ") differs from strtod" << std::endl;
+            std::exit(1);
+        }
+    }
+}
+
+/* Random integers around the bounds agree with strtoll(). */
+static void testIntRandom() {
+    std::mt19937_64 random(13);
+    char value[32];
+    for (int n = 0; n < 200000; ++n) {
+        int64_t num = static_cast<int64_t>(random() >> (random() % 64));
+        if (random() % 2 == 0) {
+            num = -num;
+        }
+        std::sprintf(value, "%lld", static_cast<long long>(num));
+        if (n % 3 == 0) {
+            // One more digit, mostly out of range.
+            std::strcat(value, "7");
+        }
+        errno = 0;
+        char * end;
+        long long expected = std::strtoll(value, &end, 10);
+        if (errno == ERANGE) {
+            CHECK(rejectsInt(value));
+        } else {
+            CHECK(parsesInt(value, expected));
+        }
+    }
+}
+
+int main() {
+    testIntEdges();
+    testDoubleEdges();
+    testDoubleFallback();
+    testDoubleRandom();
+    testIntRandom();
+    return 0;
+}
@@ -0,0 +1,191 @@
+//
+// Helpers shared by the tests: a check macro and an in-process stand-in for upsd.
+// POSIX only.
+//
+
+#ifndef NUTCLIENT_TESTING_H
+#define NUTCLIENT_TESTING_H
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Fails the test, unlike assert() it is kept in release builds.
+ */
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            std::exit(1); \
+        } \
+    } while (0)
+
+/*
+ * Checks that expr throws an exception of the given type.
+ */
+#define CHECK_THROWS(expr, type) \
+    do { \
+        bool thrown = false; \
+        try { \
+            expr; \
+        } \
+        catch (const type &) { \
+            thrown = true; \
+        } \
+        CHECK(thrown); \
+    } while (0)
+
+namespace nut {
+    namespace test {
+
+        /*
+         * TestServer listens on a loopback port and answers each query line with reply(line). The text returned
+         * is written as is, so it holds whole lines with their \n; an empty text leaves the query unanswered.
+         * With serve false, connections are never accepted: they complete in the listen backlog, then stall.
+         * Each connection is served by its own thread, until the server is destroyed. A server given a path
+         * listens on a unix domain socket there instead.
+         */
+        class TestServer {
+        public:
+            typedef std::function<std::string(const std::string & line)> Reply;
+
+            explicit TestServer(Reply reply, bool serve = true, int backlog = 128) :
+                    _reply(std::move(reply)),
+                    _stopped(false) {
+                _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                int one = 1;
+                ::setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                struct sockaddr_in addr = {};
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                socklen_t len = sizeof(addr);
+                if (::bind(_fd, reinterpret_cast<struct sockaddr *>(&addr), len) != 0 ||
+                    ::listen(_fd, backlog) != 0 ||
+                    ::getsockname(_fd, reinterpret_cast<struct sockaddr *>(&addr), &len) != 0) {
+                    std::cerr << "cannot listen on the loopback interface" << std::endl;
+                    std::exit(1);
+                }
+                _port = ntohs(addr.sin_port);
+                if (serve) {
+                    _acceptor = std::thread([this]() { acceptLoop(); });
+                }
+            }
+
+            TestServer(Reply reply, const std::string & path, bool serve = true, int backlog = 128) :
+                    _reply(std::move(reply)),
+                    _port(0),
+                    _path(path),
+                    _stopped(false) {
+                _fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                struct sockaddr_un addr = {};
+                addr.sun_family = AF_UNIX;
+                path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+                ::unlink(path.c_str());
+                if (::bind(_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+                    ::listen(_fd, backlog) != 0) {
+                    std::cerr << "cannot listen on " << path << std::endl;
+                    std::exit(1);
+                }
+                if (serve) {
+                    _acceptor = std::thread([this]() { acceptLoop(); });
+                }
+            }
+
+            ~TestServer() {
+                _stopped = true;
+                if (_acceptor.joinable()) {
+                    _acceptor.join();
+                }
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    for (int fd : _clients) {
+                        ::shutdown(fd, SHUT_RDWR);
+                    }
+                }
+                for (std::thread & t : _threads) {
+                    t.join();
+                }
+                for (int fd : _clients) {
+                    ::close(fd);
+                }
+                ::close(_fd);
+                if (!_path.empty()) {
+                    ::unlink(_path.c_str());
+                }
+            }
+
+            /* The loopback port, 0 for a unix domain socket. */
+            int port() const {
+                return _port;
+            }
+
+            /* Closes the connections accepted so far, as a restarted upsd would; new ones are still served. */
+            void drop() {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (int fd : _clients) {
+                    ::shutdown(fd, SHUT_RDWR);
+                }
+            }
+
+        private:
+            void acceptLoop() {
+                while (!_stopped) {
+                    struct pollfd pfd = {_fd, POLLIN, 0};
+                    if (::poll(&pfd, 1, 50) <= 0) {
+                        continue;
+                    }
+                    int fd = ::accept(_fd, nullptr, nullptr);
+                    if (fd < 0) {
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _clients.push_back(fd);
+                    _threads.emplace_back([this, fd]() { serve(fd); });
+                }
+            }
+
+            void serve(int fd) {
+                std::string in;
+                char buf[4096];
+                while (true) {
+                    ssize_t n = ::read(fd, buf, sizeof(buf));
+                    if (n <= 0) {
+                        return;
+                    }
+                    in.append(buf, static_cast<size_t>(n));
+                    size_t eol;
+                    while ((eol = in.find('\n')) != std::string::npos) {
+                        std::string out = _reply(in.substr(0, eol));
+                        in.erase(0, eol + 1);
+                        if (!out.empty() && ::send(fd, out.data(), out.size(), MSG_NOSIGNAL) < 0) {
+                            return;
+                        }
+                    }
+                }
+            }
+
+            Reply _reply;
+            int _fd;
+            int _port;
+            std::string _path;
+            std::atomic<bool> _stopped;
+            std::thread _acceptor;
+            std::mutex _mutex;               /* Guards the fields below */
+            std::vector<int> _clients;
+            std::vector<std::thread> _threads;
+        };
+
+    }
+}
+
+#endif //NUTCLIENT_TESTING_H
@@ -0,0 +1,553 @@
+//
+// io_uring transport for the nut client.
+// The ring is driven with the raw system calls, so no liburing is needed.
+//
+
+#include "uringsocket.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <memory>
+
+namespace nut {
+
+    /* Size of the gather list given to one IORING_OP_SENDMSG */
+    static const size_t MAX_IOVEC = 1024;
+    /* user_data of the linked timeouts, their completions are ignored */
+    static const uint64_t TIMEOUT_USER_DATA = 0;
+
+    static int uringSetup(unsigned entries, struct io_uring_params * p) {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+    }
+
+    static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    static int uringRegister(int fd, unsigned opcode, void * arg, unsigned count) {
+        return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+    }
+
+    std::shared_ptr<AbstractSocket> uringSocketFactory() {
+        internal::UringEngine * engine = internal::UringEngine::instance();
+        if (engine == nullptr) {
+            return internal::defaultFactory();
+        }
+        return std::make_shared<UringSocket>(*engine);
+    }
+
+    bool uringAvailable() {
+        return internal::UringEngine::instance() != nullptr;
+    }
+
+    namespace internal {
+
+        /*
+         * Completion of an operation, written by the thread that reaps it.
+         */
+        struct UringCompletion {
+            int res;
+            bool done;
+            std::condition_variable wake;
+        };
+
+        UringEngine * UringEngine::instance() {
+            // Thread safe initialization, the setup is attempted once.
+            static std::unique_ptr<UringEngine> engine([]() {
+                std::unique_ptr<UringEngine> e(new UringEngine());
+                if (!e->setup()) {
+                    e.reset();
+                }
+                return e;
+            }());
+            return engine.get();
+        }
+
+        UringEngine::UringEngine() :
+                _fd(-1),
+                _sqEntries(0),
+                _sqHead(nullptr),
+                _sqTail(nullptr),
+                _sqMask(nullptr),
+                _sqArray(nullptr),
+                _sqes(nullptr),
+                _cqHead(nullptr),
+                _cqTail(nullptr),
+                _cqMask(nullptr),
+                _cqes(nullptr),
+                _sqRing(MAP_FAILED),
+                _sqRingSize(0),
+                _cqRing(MAP_FAILED),
+                _cqRingSize(0),
+                _sqesSize(0),
+                _toSubmit(0),
+                _submitting(false),
+                _reaping(false) {
+        }
+
+        UringEngine::~UringEngine() {
+            if (_sqes != nullptr) {
+                ::munmap(_sqes, _sqesSize);
+            }
+            if (_cqRing != MAP_FAILED && _cqRing != _sqRing) {
+                ::munmap(_cqRing, _cqRingSize);
+            }
+            if (_sqRing != MAP_FAILED) {
+                ::munmap(_sqRing, _sqRingSize);
+            }
+            if (_fd >= 0) {
+                ::close(_fd);
+            }
+        }
+
+        bool UringEngine::setup() {
+            struct io_uring_params p;
+            memset(&p, 0, sizeof(p));
+            _fd = uringSetup(QUEUE_DEPTH, &p);
+            if (_fd < 0) {
+                return false;  // ENOSYS, or disabled by the administrator
+            }
+
+            // Check the operations used are all supported, they appeared along kernel 5.1 to 5.6.
+            std::vector<char> probeData(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op), 0);
+            struct io_uring_probe * probe = reinterpret_cast<struct io_uring_probe *>(&probeData[0]);
+            if (uringRegister(_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+                return false;
+            }
+            const int required[] = {IORING_OP_RECV, IORING_OP_SEND, IORING_OP_SENDMSG, IORING_OP_READ_FIXED,
+                                    IORING_OP_LINK_TIMEOUT};
+            for (int op : required) {
+                if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                    return false;
+                }
+            }
+
+            _sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            _cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+            bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single) {
+                _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+            }
+            _sqRing = ::mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                             IORING_OFF_SQ_RING);
+            if (_sqRing == MAP_FAILED) {
+                return false;
+            }
+            if (single) {
+                _cqRing = _sqRing;
+            } else {
+                _cqRing = ::mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                                 IORING_OFF_CQ_RING);
+                if (_cqRing == MAP_FAILED) {
+                    return false;
+                }
+            }
+            _sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+            void * sqes = ::mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                                 IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) {
+                return false;
+            }
+            _sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+            char * sq = static_cast<char *>(_sqRing);
+            char * cq = static_cast<char *>(_cqRing);
+            _sqEntries = p.sq_entries;
+            _sqHead = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+            _sqTail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+            _sqMask = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+            _sqArray = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+            _cqHead = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+            _cqTail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+            _cqMask = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+            _cqes = reinterpret_cast<struct io_uring_cqe *>(cq + p.cq_off.cqes);
+
+            // Registered buffers are pinned once instead of at each read. Without them (RLIMIT_MEMLOCK too low)
+            // sockets receive with IORING_OP_RECV.
+            _buffers.resize(BUFFER_COUNT * BUFFER_SIZE);
+            std::vector<struct iovec> iov(BUFFER_COUNT);
+            for (int n = 0; n < BUFFER_COUNT; ++n) {
+                iov[n].iov_base = &_buffers[n * BUFFER_SIZE];
+                iov[n].iov_len = BUFFER_SIZE;
+            }
+            if (uringRegister(_fd, IORING_REGISTER_BUFFERS, &iov[0], BUFFER_COUNT) == 0) {
+                for (int n = BUFFER_COUNT - 1; n >= 0; --n) {
+                    _freeBuffers.push_back(n);
+                }
+            } else {
+                std::vector<char>().swap(_buffers);
+            }
+            return true;
+        }
+
+        int UringEngine::acquireBuffer() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_freeBuffers.empty()) {
+                return -1;
+            }
+            int index = _freeBuffers.back();
+            _freeBuffers.pop_back();
+            return index;
+        }
+
+        void UringEngine::releaseBuffer(int index) {
+            if (index >= 0) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _freeBuffers.push_back(index);
+            }
+        }
+
+        char * UringEngine::buffer(int index) {
+            return &_buffers[index * BUFFER_SIZE];
+        }
+
+        /*
+         * Queues a submission entry. The caller holds _mutex and made sure the queue has room.
+         */
+        void UringEngine::push(const struct io_uring_sqe & sqe) {
+            unsigned tail = *_sqTail;
+            unsigned index = tail & *_sqMask;
+            _sqes[index] = sqe;
+            _sqArray[index] = index;
+            __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+            ++_toSubmit;
+        }
+
+        /*
+         * Takes every queued entry, whichever thread queued it, and submits them with one io_uring_enter()
+         * which also waits for minComplete completions. The mutex is released during the call, the entries
+         * queued meanwhile go with the next one. Returns the result of io_uring_enter(), with its errno.
+         */
+        int UringEngine::enter(std::unique_lock<std::mutex> & lock, unsigned minComplete) {
+            unsigned count = _toSubmit;
+            _toSubmit = 0;
+            lock.unlock();
+            int res = uringEnter(_fd, count, minComplete, minComplete > 0 ? IORING_ENTER_GETEVENTS : 0);
+            int err = errno;
+            lock.lock();
+            // The entries the kernel did not take (completion queue full) go with the next call.
+            _toSubmit += count - (res > 0 ? std::min(count, static_cast<unsigned>(res)) : 0);
+            errno = err;
+            return res;
+        }
+
+        /*
+         * Delivers the available completions to their operations. The caller holds _mutex.
+         */
+        void UringEngine::reapLocked() {
+            unsigned head = *_cqHead;
+            unsigned tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const struct io_uring_cqe & cqe = _cqes[head & *_cqMask];
+                if (cqe.user_data != TIMEOUT_USER_DATA) {
+                    UringCompletion * completion = reinterpret_cast<UringCompletion *>(cqe.user_data);
+                    completion->res = cqe.res;
+                    completion->done = true;
+                    completion->wake.notify_one();
+                }
+            }
+            __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+        }
+
+        int UringEngine::execute(struct io_uring_sqe sqe, const Deadline & deadline) {
+            UringCompletion completion;
+            completion.res = 0;
+            completion.done = false;
+            sqe.user_data = reinterpret_cast<uint64_t>(&completion);
+
+            struct __kernel_timespec ts;
+            struct io_uring_sqe timeout;
+            if (deadline.isSet()) {
+                long ms = deadline.remainingMs();
+                if (ms == 0) {
+                    return -ECANCELED;
+                }
+                ts.tv_sec = ms / 1000;
+                ts.tv_nsec = (ms % 1000) * 1000000;
+                memset(&timeout, 0, sizeof(timeout));
+                timeout.opcode = IORING_OP_LINK_TIMEOUT;
+                timeout.fd = -1;
+                timeout.addr = reinterpret_cast<uint64_t>(&ts);
+                timeout.len = 1;
+                timeout.user_data = TIMEOUT_USER_DATA;
+                sqe.flags |= IOSQE_IO_LINK;
+            }
+            unsigned needed = deadline.isSet() ? 2 : 1;
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (_sqEntries - (*_sqTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE)) < needed) {
+                // Full of entries queued by the other threads: submit them, or let their submitter do it.
+                if (_submitting) {
+                    _room.wait(lock);
+                    continue;
+                }
+                _submitting = true;
+                int res = enter(lock, 0);
+                _submitting = false;
+                _room.notify_all();
+                if (res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    throw nut::SystemException();
+                }
+            }
+            push(sqe);
+            if (deadline.isSet()) {
+                push(timeout);
+            }
+
+            _waiting.push_back(&completion);
+            while (!completion.done) {
+                int res = 0;
+                if (!_reaping) {
+                    // Submit the queue, our entry included, and wait for a completion in the same call.
+                    _reaping = true;
+                    res = enter(lock, 1);
+                    _reaping = false;
+                    reapLocked();
+                } else if (_toSubmit > 0 && !_submitting) {
+                    // The reaper sleeps in the kernel: submit what was queued since, including what the other
+                    // threads queue during the call.
+                    _submitting = true;
+                    while (_toSubmit > 0 && res >= 0) {
+                        res = enter(lock, 0);
+                    }
+                    _submitting = false;
+                    _room.notify_all();
+                } else {
+                    completion.wake.wait(lock);
+                    continue;
+                }
+                if (res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    _waiting.erase(std::find(_waiting.begin(), _waiting.end(), &completion));
+                    throw nut::SystemException();
+                }
+            }
+            _waiting.erase(std::find(_waiting.begin(), _waiting.end(), &completion));
+            if (!_reaping && !_waiting.empty()) {
+                // Hand the reaping over to a thread still waiting.
+                _waiting.front()->wake.notify_one();
+            }
+            return completion.res;
+        }
+
+    }
+
+    /*
+     *
+     * UringSocket implementation
+     *
+     */
+
+    static const char NEWLINE = '\n';
+
+    UringSocket::UringSocket(internal::UringEngine & engine) :
+            _engine(engine),
+            _sock(INVALID_SOCKET),
+            _bufferIndex(engine.acquireBuffer()),
+            _buffer(_bufferIndex >= 0 ? engine.buffer(_bufferIndex) : nullptr,
+                    _bufferIndex >= 0 ? static_cast<size_t>(internal::UringEngine::BUFFER_SIZE)
+                                      : static_cast<size_t>(internal::LineBuffer::DEFAULT_CAPACITY)) {
+    }
+
+    UringSocket::~UringSocket() {
+        disconnect();
+        _engine.releaseBuffer(_bufferIndex);
+    }
+
+    void UringSocket::connect(const std::string & host, int port) {
+        internal::Deadline deadline(getTimeout());
+        disconnect();
+        _sock = internal::openConnection(host, port, deadline, getOptions());
+
+        // Operations on a non blocking socket would complete with EAGAIN instead of waiting in the ring.
+        int flags = ::fcntl(_sock, F_GETFL, 0);
+        ::fcntl(_sock, F_SETFL, flags & ~O_NONBLOCK);
+    }
+
+    void UringSocket::disconnect() {
+        if (_sock != INVALID_SOCKET) {
+            ::close(_sock);
+            _sock = INVALID_SOCKET;
+        }
+        _buffer.clear();
+    }
+
+    bool UringSocket::isConnected() const {
+        return _sock != INVALID_SOCKET;
+    }
+
+    void UringSocket::shutdown() {
+        if (_sock != INVALID_SOCKET) {
+            ::shutdown(_sock, SHUT_RDWR);
+        }
+    }
+
+    /*
+     * Closes the connection after an error, unless the user of the socket closes it itself.
+     */
+    void UringSocket::failed() {
+        if (disconnectsOnError()) {
+            disconnect();
+        }
+    }
+
+    /*
+     * Executes an operation on the socket, retrying interrupted ones.
+     * Returns the byte count, disconnects and throws at error or timeout.
+     */
+    int UringSocket::execute(struct io_uring_sqe & sqe, const internal::Deadline & deadline, const char * error) {
+        while (true) {
+            int res = _engine.execute(sqe, deadline);
+            if (res >= 0) {
+                return res;
+            }
+            if (res == -ECANCELED) {
+                // Whatever answer comes later would be taken for the reply of the next query.
+                failed();
+                throw nut::TimeoutException();
+            }
+            if (res != -EINTR && res != -EAGAIN) {
+                failed();
+                throw nut::IOException(error);
+            }
+        }
+    }
+
+    size_t UringSocket::read(void * buf, size_t sz) {
+        if (!isConnected()) {
+            throw nut::NotConnectedException();
+        }
+
+        struct io_uring_sqe sqe;
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_RECV;
+        sqe.fd = _sock;
+        sqe.addr = reinterpret_cast<uint64_t>(buf);
+        sqe.len = static_cast<unsigned>(std::min(sz, static_cast<size_t>(UINT_MAX)));
+        return static_cast<size_t>(execute(sqe, internal::Deadline(getTimeout()), "Error while reading from socket"));
+    }
+
+    size_t UringSocket::write(const void * buf, size_t sz) {
+        if (!isConnected()) {
+            throw nut::NotConnectedException();
+        }
+
+        struct io_uring_sqe sqe;
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_SEND;
+        sqe.fd = _sock;
+        sqe.addr = reinterpret_cast<uint64_t>(buf);
+        sqe.len = static_cast<unsigned>(std::min(sz, static_cast<size_t>(UINT_MAX)));
+        sqe.msg_flags = MSG_NOSIGNAL;
+        return static_cast<size_t>(execute(sqe, internal::Deadline(getTimeout()), "Error while writing on socket"));
+    }
+
+    /*
+     * Receives the next chunk into the line buffer, returns its size (0 when the server closed the connection).
+     */
+    size_t UringSocket::receive(const internal::Deadline & deadline) {
+        if (!isConnected()) {
+            throw nut::NotConnectedException();
+        }
+
+        size_t room;
+        char * dst = _buffer.prepare(room);
+        struct io_uring_sqe sqe;
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.fd = _sock;
+        sqe.addr = reinterpret_cast<uint64_t>(dst);
+        const char * registered = _bufferIndex >= 0 ? _engine.buffer(_bufferIndex) : nullptr;
+        if (registered != nullptr && dst >= registered && dst + room <= registered + internal::UringEngine::BUFFER_SIZE) {
+            // The line buffer lives in the pinned buffer: the kernel fills it in place.
+            sqe.opcode = IORING_OP_READ_FIXED;
+            sqe.len = static_cast<unsigned>(room);
+            sqe.buf_index = static_cast<uint16_t>(_bufferIndex);
+        } else {
+            sqe.opcode = IORING_OP_RECV;
+            sqe.len = static_cast<unsigned>(std::min(room, static_cast<size_t>(UINT_MAX)));
+        }
+        int res = execute(sqe, deadline, "Error while reading from socket");
+        _buffer.commit(static_cast<size_t>(res));
+        return static_cast<size_t>(res);
+    }
+
+    std::string UringSocket::read() {
+        return readLine().str();
+    }
+
+    LineView UringSocket::readLine() {
+        const char * line;
+        size_t len;
+        internal::Deadline deadline(getTimeout());
+
+        while (!_buffer.nextLine(line, len)) {
+            if (receive(deadline) == 0) {
+                failed();
+                throw nut::IOException("Server closed connection unexpectedly");
+            }
+        }
+        return LineView(line, len);
+    }
+
+    void UringSocket::write(const std::string & s) {
+        struct iovec iov[2];
+        iov[0].iov_base = const_cast<char *>(s.data());
+        iov[0].iov_len = s.size();
+        iov[1].iov_base = const_cast<char *>(&NEWLINE);
+        iov[1].iov_len = 1;
+        writeAll(iov, 2, internal::Deadline(getTimeout()));
+    }
+
+    void UringSocket::writeLines(const std::vector<std::string> & lines) {
+        _iov.resize(lines.size() * 2);
+        for (size_t n = 0; n < lines.size(); ++n) {
+            _iov[2 * n].iov_base = const_cast<char *>(lines[n].data());
+            _iov[2 * n].iov_len = lines[n].size();
+            _iov[2 * n + 1].iov_base = const_cast<char *>(&NEWLINE);
+            _iov[2 * n + 1].iov_len = 1;
+        }
+        if (!_iov.empty()) {
+            writeAll(&_iov[0], _iov.size(), internal::Deadline(getTimeout()));
+        }
+    }
+
+    /*
+     * Writes the whole gather list with IORING_OP_SENDMSG, resuming after partial writes.
+     */
+    void UringSocket::writeAll(struct iovec * iov, size_t count, const internal::Deadline & deadline) {
+        if (!isConnected()) {
+            throw nut::NotConnectedException();
+        }
+
+        while (count > 0) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = std::min(count, MAX_IOVEC);
+            struct io_uring_sqe sqe;
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_SENDMSG;
+            sqe.fd = _sock;
+            sqe.addr = reinterpret_cast<uint64_t>(&msg);
+            sqe.len = 1;
+            sqe.msg_flags = MSG_NOSIGNAL;
+            int res = execute(sqe, deadline, "Error while writing on socket");
+            if (res == 0) {
+                failed();
+                throw nut::IOException("Writing string failed");
+            }
+
+            // Skip what has been sent, a partial write may stop in the middle of a buffer.
+            size_t sent = static_cast<size_t>(res);
+            while (count > 0 && sent >= iov->iov_len) {
+                sent -= iov->iov_len;
+                ++iov;
+                --count;
+            }
+            if (sent > 0) {
+                iov->iov_base = static_cast<char *>(iov->iov_base) + sent;
+                iov->iov_len -= sent;
+            }
+        }
+    }
+
+}
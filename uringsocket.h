@@ -0,0 +1,156 @@
+//
+// io_uring transport for the nut client. Linux only.
+//
+
+#ifndef NUTCLIENT_URINGSOCKET_H
+#define NUTCLIENT_URINGSOCKET_H
+#include "nutclient.h"
+#include "defaultsocket.h"
+#include <mutex>
+#include <condition_variable>
+#include <linux/io_uring.h>
+
+namespace nut {
+
+    /*
+     * Socket factory creating io_uring backed sockets. Register it to select this transport:
+     *     nut::registerSocketFactory(nut::uringSocketFactory);
+     * All the sockets share one ring, so reads and writes issued by many connections are submitted and
+     * reaped together, and receive into buffers registered once with the kernel.
+     * If the kernel does not support io_uring (or the operations needed), it returns default sockets.
+     * Experimental: it halves the system calls of a query but is not faster than the default sockets yet.
+     */
+    LIB_API std::shared_ptr<AbstractSocket> uringSocketFactory();
+
+    /*
+     * Returns true if the io_uring transport is usable on this kernel.
+     */
+    LIB_API bool uringAvailable();
+
+    namespace internal {
+
+        struct UringCompletion;
+
+        /*
+         * Ring shared by all the io_uring sockets of the process.
+         * Any thread may execute an operation: it queues its submission entry, and one io_uring_enter() call
+         * submits every entry queued so far, whichever connection they belong to. The thread making the call
+         * waits in it for completions and reaps them for all, waking only the threads whose operation completed;
+         * the entries queued while it sleeps in the kernel are submitted together by one of their threads.
+         */
+        class UringEngine {
+        public:
+            enum {
+                QUEUE_DEPTH = 256,
+                BUFFER_COUNT = 64,      /* Receive buffers registered with the kernel */
+                BUFFER_SIZE = 16384
+            };
+
+            /*
+             * Returns the process wide engine, or nullptr if io_uring is not usable.
+             */
+            static UringEngine * instance();
+
+            ~UringEngine();
+
+            /*
+             * Executes an operation and waits for its completion.
+             *     sqe - the submission entry, user_data is overwritten
+             *     deadline - the operation is cancelled when it passes
+             *     Returns the completion result: a byte count, or a negative errno
+             *     (-ECANCELED if the deadline passed).
+             */
+            int execute(struct io_uring_sqe sqe, const Deadline & deadline);
+
+            /*
+             * Reserves a registered receive buffer, returns its index or -1 if none is left.
+             * A socket receives straight into it: it is the storage of the line buffer.
+             */
+            int acquireBuffer();
+            void releaseBuffer(int index);
+            char * buffer(int index);
+
+        private:
+            UringEngine();
+            bool setup();
+            void push(const struct io_uring_sqe & sqe);
+            int enter(std::unique_lock<std::mutex> & lock, unsigned minComplete);
+            void reapLocked();
+
+            int _fd;
+            unsigned _sqEntries;
+            unsigned * _sqHead;
+            unsigned * _sqTail;
+            unsigned * _sqMask;
+            unsigned * _sqArray;
+            struct io_uring_sqe * _sqes;
+            unsigned * _cqHead;
+            unsigned * _cqTail;
+            unsigned * _cqMask;
+            struct io_uring_cqe * _cqes;
+            void * _sqRing;
+            size_t _sqRingSize;
+            void * _cqRing;
+            size_t _cqRingSize;
+            size_t _sqesSize;
+
+            unsigned _toSubmit;         /* Entries queued, not taken by a submitting thread yet */
+            bool _submitting;           /* A thread submits entries without waiting */
+            bool _reaping;              /* A thread submits entries and waits for completions in the kernel */
+            std::mutex _mutex;
+            std::condition_variable _room;      /* Signaled when queued entries are submitted */
+            std::vector<UringCompletion *> _waiting; /* Operations whose threads sleep, the next reaper among them */
+
+            std::vector<char> _buffers;
+            std::vector<int> _freeBuffers;
+        };
+
+    }
+
+    /*
+     * UringSocket is an AbstractSocket whose reads and writes are io_uring operations executed by the
+     * shared UringEngine. It connects like the default socket, then lines are received into a line buffer
+     * stored in a registered buffer (or in plain memory if none is left, or once a long line made it grow)
+     * and queries are written with vectored sends. Timeouts are enforced by the kernel with linked timeouts.
+     */
+    class UringSocket : public AbstractSocket {
+    public:
+        explicit UringSocket(internal::UringEngine & engine);
+
+        ~UringSocket();
+
+        void connect(const std::string & host, int port) override;
+
+        void disconnect() override;
+
+        bool isConnected() const override;
+
+        size_t read(void * buf, size_t sz) override;
+
+        size_t write(const void * buf, size_t sz) override;
+
+        std::string read() override;
+
+        LineView readLine() override;
+
+        void write(const std::string & s) override;
+
+        void writeLines(const std::vector<std::string> & lines) override;
+
+        void shutdown() override;
+
+    private:
+        void failed();
+        int execute(struct io_uring_sqe & sqe, const internal::Deadline & deadline, const char * error);
+        size_t receive(const internal::Deadline & deadline);
+        void writeAll(struct iovec * iov, size_t count, const internal::Deadline & deadline);
+
+        internal::UringEngine & _engine;
+        SOCKET _sock;
+        int _bufferIndex;             /* Registered receive buffer, -1 if none */
+        internal::LineBuffer _buffer;
+        std::vector<struct iovec> _iov;
+    };
+}
+
+#endif //NUTCLIENT_URINGSOCKET_H